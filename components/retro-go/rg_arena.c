@@ -0,0 +1,226 @@
+#include "rg_system.h"
+#include "rg_arena.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN(x) (((x) + 7) & ~7)
+
+struct rg_arena_block_s
+{
+    rg_arena_block_t *next;
+    size_t size;
+    size_t used;
+    uint8_t data[] __attribute__((aligned(8)));
+};
+
+static rg_arena_block_t *new_block(rg_arena_t *arena, size_t size)
+{
+    rg_arena_block_t *block = rg_alloc(sizeof(rg_arena_block_t) + size, arena->caps);
+    block->size = size;
+    block->used = 0;
+    arena->reserved += size;
+    return block;
+}
+
+rg_arena_t *rg_arena_create(size_t block_size, uint32_t caps)
+{
+    rg_arena_t *arena = calloc(1, sizeof(rg_arena_t));
+    RG_ASSERT(arena && block_size, "Bad param");
+    arena->block_size = ARENA_ALIGN(block_size);
+    arena->caps = caps;
+    return arena;
+}
+
+void rg_arena_free(rg_arena_t *arena)
+{
+    if (!arena)
+        return;
+
+    for (rg_arena_block_t *block = arena->blocks, *next; block; block = next)
+    {
+        next = block->next;
+        free(block);
+    }
+    free(arena);
+}
+
+void rg_arena_reset(rg_arena_t *arena)
+{
+    RG_ASSERT(arena, "Bad param");
+
+    rg_arena_block_t *keep = NULL;
+
+    // Keep one regular block around, whatever we needed more than that goes back to the heap
+    for (rg_arena_block_t *block = arena->blocks, *next; block; block = next)
+    {
+        next = block->next;
+        if (!keep && block->size == arena->block_size)
+        {
+            keep = block;
+            continue;
+        }
+        arena->reserved -= block->size;
+        free(block);
+    }
+
+    if (keep)
+    {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+
+    arena->blocks = keep;
+    arena->used = 0;
+}
+
+void *rg_arena_alloc(rg_arena_t *arena, size_t size)
+{
+    RG_ASSERT(arena, "Bad param");
+
+    rg_arena_block_t *block = arena->blocks;
+
+    size = ARENA_ALIGN(RG_MAX(size, 1));
+
+    if (!block || block->used + size > block->size)
+    {
+        if (size > arena->block_size / 2)
+        {
+            // Big allocations get their own block, the current one keeps being filled
+            block = new_block(arena, size);
+            if (arena->blocks)
+            {
+                block->next = arena->blocks->next;
+                arena->blocks->next = block;
+            }
+            else
+            {
+                block->next = NULL;
+                arena->blocks = block;
+            }
+        }
+        else
+        {
+            block = new_block(arena, arena->block_size);
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    arena->used += size;
+    return ptr;
+}
+
+char *rg_arena_strdup(rg_arena_t *arena, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    return memcpy(rg_arena_alloc(arena, len), str, len);
+}
+
+char *rg_arena_printf(rg_arena_t *arena, const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    char *str = rg_arena_alloc(arena, RG_MAX(len, 0) + 1);
+    *str = 0;
+
+    va_start(args, format);
+    vsnprintf(str, RG_MAX(len, 0) + 1, format, args);
+    va_end(args);
+
+    return str;
+}
+
+static uint32_t hash_string(const char *str)
+{
+    uint32_t hash = 0x811C9DC5; // FNV-1a
+    while (*str)
+        hash = (hash ^ (uint8_t)*str++) * 0x01000193;
+    return hash;
+}
+
+static void strpool_rehash(rg_strpool_t *pool, size_t capacity)
+{
+    const char **slots = calloc(capacity, sizeof(char *));
+    RG_ASSERT(slots, "alloc failed");
+
+    for (size_t i = 0; i < pool->capacity; i++)
+    {
+        if (!pool->slots[i])
+            continue;
+        size_t index = hash_string(pool->slots[i]) & (capacity - 1);
+        while (slots[index])
+            index = (index + 1) & (capacity - 1);
+        slots[index] = pool->slots[i];
+    }
+
+    free(pool->slots);
+    pool->slots = slots;
+    pool->capacity = capacity;
+}
+
+rg_strpool_t *rg_strpool_create(size_t block_size, uint32_t caps)
+{
+    rg_strpool_t *pool = calloc(1, sizeof(rg_strpool_t));
+    RG_ASSERT(pool, "alloc failed");
+    pool->arena = rg_arena_create(block_size, caps);
+    strpool_rehash(pool, 64);
+    return pool;
+}
+
+void rg_strpool_free(rg_strpool_t *pool)
+{
+    if (!pool)
+        return;
+
+    rg_arena_free(pool->arena);
+    free(pool->slots);
+    free(pool);
+}
+
+void rg_strpool_reset(rg_strpool_t *pool)
+{
+    RG_ASSERT(pool, "Bad param");
+
+    rg_arena_reset(pool->arena);
+    memset(pool->slots, 0, pool->capacity * sizeof(char *));
+    pool->count = 0;
+}
+
+const char *rg_strpool_intern(rg_strpool_t *pool, const char *str)
+{
+    RG_ASSERT(pool, "Bad param");
+
+    if (!str)
+        return NULL;
+
+    size_t index = hash_string(str) & (pool->capacity - 1);
+
+    while (pool->slots[index])
+    {
+        if (strcmp(pool->slots[index], str) == 0)
+            return pool->slots[index];
+        index = (index + 1) & (pool->capacity - 1);
+    }
+
+    // Keep the load factor under 50%, the index has to be found again after a rehash
+    if ((pool->count + 1) * 2 > pool->capacity)
+    {
+        strpool_rehash(pool, pool->capacity * 2);
+        index = hash_string(str) & (pool->capacity - 1);
+        while (pool->slots[index])
+            index = (index + 1) & (pool->capacity - 1);
+    }
+
+    pool->slots[index] = rg_arena_strdup(pool->arena, str);
+    pool->count++;
+
+    return pool->slots[index];
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct rg_arena_block_s rg_arena_block_t;
+
+// Bump allocator: allocations are carved out of large blocks and are only released all at once
+// by rg_arena_reset() or rg_arena_free(). Not thread-safe.
+typedef struct
+{
+    rg_arena_block_t *blocks; // Current block first
+    size_t block_size;
+    uint32_t caps;            // rg_alloc() caps of the blocks
+    size_t used;              // Bytes handed out since the last reset
+    size_t reserved;          // Bytes held in blocks
+} rg_arena_t;
+
+// Interned strings: equal strings share a single copy, stored in an arena.
+typedef struct
+{
+    rg_arena_t *arena;
+    const char **slots;
+    size_t capacity; // Power of two
+    size_t count;
+} rg_strpool_t;
+
+rg_arena_t *rg_arena_create(size_t block_size, uint32_t caps);
+void rg_arena_free(rg_arena_t *arena);
+void rg_arena_reset(rg_arena_t *arena);
+void *rg_arena_alloc(rg_arena_t *arena, size_t size);
+char *rg_arena_strdup(rg_arena_t *arena, const char *str);
+char *rg_arena_printf(rg_arena_t *arena, const char *format, ...) __attribute__((format(printf,2,3)));
+
+rg_strpool_t *rg_strpool_create(size_t block_size, uint32_t caps);
+void rg_strpool_free(rg_strpool_t *pool);
+void rg_strpool_reset(rg_strpool_t *pool);
+const char *rg_strpool_intern(rg_strpool_t *pool, const char *str);
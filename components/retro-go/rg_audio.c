@@ -7,6 +7,7 @@
 
 #ifdef RG_TARGET_SDL2
 #include <SDL2/SDL.h>
+#include <stdatomic.h>
 #else
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
@@ -46,6 +47,31 @@ static rg_audio_counters_t counters;
 static SemaphoreHandle_t audioDevLock;
 static int64_t dummyBusyUntil = 0;
 
+// Estimate of when the device will run out of queued audio, and how much it can queue at most (us).
+// Written by whichever task submits audio, read by the main task's frame pacing.
+static _Atomic int64_t queuedUntil = 0;
+static _Atomic int64_t lastSubmit = 0;
+static int queueCapacity = 0;
+
+#define SUBMIT_IDLE_TIME 1000000 // After that long without audio the queue estimate is meaningless (us)
+
+#if RG_AUDIO_USE_SDL2
+#ifndef RG_AUDIO_SDL2_LATENCY
+#define RG_AUDIO_SDL2_LATENCY 50 // In ms, it must cover at least one emulated frame
+#endif
+// Single-producer (rg_audio_submit) single-consumer (SDL callback) ring buffer.
+// The capacity is a power of two so that head and tail can simply run freely.
+static struct
+{
+    SDL_AudioDeviceID device;
+    rg_audio_sample_t *buffer;
+    size_t capacity;
+    atomic_size_t head; // Only written by the producer
+    atomic_size_t tail; // Only written by the consumer
+    atomic_int underruns;
+} sdl2;
+#endif
+
 static const char *SETTING_OUTPUT = "AudioSink";
 static const char *SETTING_VOLUME = "Volume";
 static const char *SETTING_FILTER = "AudioFilter";
@@ -53,6 +79,118 @@ static const char *SETTING_FILTER = "AudioFilter";
 #define ACQUIRE_DEVICE(timeout) ({int x=xSemaphoreTake(audioDevLock, timeout);if(!x)RG_LOGE("Failed to acquire lock!\n");x;})
 #define RELEASE_DEVICE() xSemaphoreGive(audioDevLock);
 
+#if RG_AUDIO_USE_SDL2
+static void sdl2_audio_callback(void *arg, Uint8 *stream, int len)
+{
+    rg_audio_sample_t *out = (rg_audio_sample_t *)stream;
+    size_t count = len / sizeof(rg_audio_sample_t);
+    size_t tail = atomic_load_explicit(&sdl2.tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&sdl2.head, memory_order_acquire);
+    size_t available = RG_MIN(head - tail, count);
+    size_t mask = sdl2.capacity - 1;
+
+    for (size_t i = 0; i < available; ++i)
+        out[i] = sdl2.buffer[(tail + i) & mask];
+
+    if (available < count)
+    {
+        memset(&out[available], 0, (count - available) * sizeof(rg_audio_sample_t));
+        if (counters.samples > 0) // Don't count the startup period
+            atomic_fetch_add_explicit(&sdl2.underruns, 1, memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&sdl2.tail, tail + available, memory_order_release);
+}
+
+static int sdl2_open(int sampleRate)
+{
+    size_t capacity = 1024;
+    while (capacity < (size_t)sampleRate * RG_AUDIO_SDL2_LATENCY / 1000)
+        capacity <<= 1;
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+        return -1;
+
+    SDL_AudioSpec desired = {
+        .freq = sampleRate,
+        .format = AUDIO_S16SYS,
+        .channels = 2,
+        .samples = RG_MIN(capacity / 4, 1024), // The callback must never starve the ring
+        .callback = &sdl2_audio_callback,
+        .userdata = NULL,
+    };
+    SDL_AudioSpec obtained;
+
+    sdl2.buffer = calloc(capacity, sizeof(rg_audio_sample_t));
+    sdl2.capacity = capacity;
+    atomic_init(&sdl2.head, 0);
+    atomic_init(&sdl2.tail, 0);
+    atomic_init(&sdl2.underruns, 0);
+
+    if (!sdl2.buffer)
+        return -2;
+
+    sdl2.device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, 0);
+    if (!sdl2.device)
+    {
+        RG_LOGE("SDL_OpenAudioDevice failed: %s\n", SDL_GetError());
+        free(sdl2.buffer);
+        sdl2.buffer = NULL;
+        return -3;
+    }
+
+    RG_LOGI("SDL2 audio ready. freq=%d, period=%d, ring=%d samples (%dms)\n", obtained.freq,
+            obtained.samples, (int)capacity, (int)(capacity * 1000 / sampleRate));
+    SDL_PauseAudioDevice(sdl2.device, 0);
+    return 0;
+}
+
+static void sdl2_close(void)
+{
+    if (sdl2.device)
+    {
+        SDL_CloseAudioDevice(sdl2.device);
+        RG_LOGI("SDL2 audio closed. underruns=%d\n", atomic_load(&sdl2.underruns));
+    }
+    free(sdl2.buffer);
+    sdl2.device = 0;
+    sdl2.buffer = NULL;
+    sdl2.capacity = 0;
+}
+
+static void sdl2_submit(const rg_audio_sample_t *samples, size_t count, float volume)
+{
+    const size_t mask = sdl2.capacity - 1;
+    size_t head = atomic_load_explicit(&sdl2.head, memory_order_relaxed);
+
+    while (count > 0)
+    {
+        size_t tail = atomic_load_explicit(&sdl2.tail, memory_order_acquire);
+        size_t space = sdl2.capacity - (head - tail);
+
+        // The ring is full: block until the device drains it, this is what paces emulation.
+        if (space == 0)
+        {
+            usleep(500);
+            continue;
+        }
+
+        size_t chunk = RG_MIN(space, count);
+        for (size_t i = 0; i < chunk; ++i)
+        {
+            rg_audio_sample_t *out = &sdl2.buffer[(head + i) & mask];
+            out->left = samples[i].left * volume;
+            out->right = samples[i].right * volume;
+        }
+        head += chunk;
+        samples += chunk;
+        count -= chunk;
+
+        atomic_store_explicit(&sdl2.head, head, memory_order_release);
+    }
+}
+#endif
+
 
 void rg_audio_init(int sampleRate)
 {
@@ -69,6 +207,9 @@ void rg_audio_init(int sampleRate)
         if (!audio.sink || sinks[i].type == sinkType)
             audio.sink = &sinks[i];
     }
+    // The dummy sink doesn't pace, which is exactly what benchmark mode wants
+    if (rg_system_get_app()->benchmark)
+        audio.sink = &sinks[0];
     audio.filter = (int)rg_settings_get_number(NS_GLOBAL, SETTING_FILTER, 0);
     audio.volume = (int)rg_settings_get_number(NS_GLOBAL, SETTING_VOLUME, 50);
     audio.sampleRate = sampleRate;
@@ -97,6 +238,11 @@ void rg_audio_init(int sampleRate)
 
     int error_code = -1;
 
+    // The dummy sink never blocks, pretend it has a buffer similar to the real ones
+    queueCapacity = 50000;
+    atomic_store(&queuedUntil, 0);
+    atomic_store(&lastSubmit, 0);
+
     if (audio.sink->type == RG_AUDIO_SINK_DUMMY)
     {
         error_code = 0;
@@ -110,6 +256,7 @@ void rg_audio_init(int sampleRate)
         esp_err_t ret = i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL);
         if (ret == ESP_OK)
             ret = i2s_set_dac_mode(RG_AUDIO_USE_INT_DAC);
+        queueCapacity = (int64_t)i2s_config.dma_buf_count * i2s_config.dma_buf_len * 1000000 / sampleRate;
         error_code = ret;
     #else
         RG_LOGE("This device does not support internal DAC mode!\n");
@@ -128,6 +275,7 @@ void rg_audio_init(int sampleRate)
                 .data_in_num = GPIO_NUM_NC
             });
         }
+        queueCapacity = (int64_t)i2s_config.dma_buf_count * i2s_config.dma_buf_len * 1000000 / sampleRate;
         error_code = ret;
     #else
         RG_LOGE("This device does not support external DAC mode!\n");
@@ -136,8 +284,7 @@ void rg_audio_init(int sampleRate)
     else if (audio.sink->type == RG_AUDIO_SINK_SDL2)
     {
     #if RG_AUDIO_USE_SDL2
-        SDL_AudioSpec sdl2_config = {0};
-        error_code = 0;
+        error_code = sdl2_open(sampleRate);
     #else
         RG_LOGE("This device does not support SDL2!\n");
     #endif
@@ -202,7 +349,7 @@ void rg_audio_deinit(void)
 #if RG_AUDIO_USE_SDL2
     else if (audio.sink->type == RG_AUDIO_SINK_SDL2)
     {
-        // ...
+        sdl2_close();
     }
 #endif
 
@@ -284,16 +431,41 @@ void rg_audio_submit(const rg_audio_sample_t *samples, size_t count)
 #if RG_AUDIO_USE_SDL2
     else if (audio.sink->type == RG_AUDIO_SINK_SDL2)
     {
-        //
+        sdl2_submit(samples, count, audio.muted ? 0.f : (audio.volume * 0.01f));
     }
 #endif
 
+    // The device drains at a constant rate and blocks us when full, that's all we need to model it.
+    // It's updated before releasing the device so that concurrent submitters are serialized.
+    int64_t time_end = rg_system_timer();
+    int64_t until = RG_MAX(atomic_load(&queuedUntil), time_end) + (int64_t)count * 1000000 / audio.sampleRate;
+    atomic_store(&queuedUntil, RG_MIN(until, time_end + queueCapacity));
+    atomic_store(&lastSubmit, time_end);
+
     RELEASE_DEVICE();
 
-    counters.busyTime += rg_system_timer() - time_start;
+    counters.busyTime += time_end - time_start;
     counters.samples += count;
 }
 
+int rg_audio_get_queued_time(void)
+{
+    // Some apps don't submit anything at times (sound disabled), an empty queue means nothing then
+    int64_t now = rg_system_timer();
+    int64_t last = atomic_load(&lastSubmit);
+    if (!last || now - last > SUBMIT_IDLE_TIME)
+        return -1;
+
+#if RG_AUDIO_USE_SDL2
+    if (audio.sink && audio.sink->type == RG_AUDIO_SINK_SDL2)
+    {
+        size_t queued = atomic_load(&sdl2.head) - atomic_load(&sdl2.tail);
+        return (int64_t)queued * 1000000 / audio.sampleRate;
+    }
+#endif
+    return RG_MAX(atomic_load(&queuedUntil) - now, 0);
+}
+
 const rg_audio_t *rg_audio_get_info(void)
 {
     return &audio;
@@ -384,6 +556,18 @@ void rg_audio_set_sample_rate(int sampleRate)
         i2s_set_sample_rates(I2S_NUM_0, sampleRate);
     }
 #endif
+#if RG_AUDIO_USE_SDL2
+    if (audio.sink->type == RG_AUDIO_SINK_SDL2)
+    {
+        RG_LOGI("Reopening SDL2 device at %dHz\n", sampleRate);
+        sdl2_close();
+        if (sdl2_open(sampleRate) != 0)
+        {
+            RG_LOGE("Failed to reopen SDL2 device, falling back to dummy sink.\n");
+            audio.sink = &sinks[0];
+        }
+    }
+#endif
 
     audio.sampleRate = sampleRate;
     RELEASE_DEVICE();
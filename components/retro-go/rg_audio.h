@@ -50,6 +50,7 @@ void rg_audio_deinit(void);
 void rg_audio_submit(const rg_audio_sample_t *samples, size_t count);
 const rg_audio_t *rg_audio_get_info(void);
 rg_audio_counters_t rg_audio_get_counters(void);
+int rg_audio_get_queued_time(void); // Estimated audio queued ahead of playback (us), -1 if none submitted lately
 
 const rg_audio_sink_t *rg_audio_get_sinks(size_t *count);
 const rg_audio_sink_t *rg_audio_get_sink(void);
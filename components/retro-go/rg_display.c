@@ -10,6 +10,7 @@
 #else
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <driver/gpio.h>
 #include <driver/spi_master.h>
 #endif
@@ -22,14 +23,42 @@
 #define SPI_BUFFER_COUNT      (6)
 #define SPI_BUFFER_LENGTH     (4 * 320) // In pixels (uint16)
 
+#define DIFF_SAMPLE_STEP      (8) // Interlaced pre-pass of the frame diff
+#define TRANSPOSE_LINES       (8) // Source columns transposed per block by the software rotation
+
+#define SCREEN_MAX_SIZE ((RG_SCREEN_WIDTH > RG_SCREEN_HEIGHT) ? RG_SCREEN_WIDTH : RG_SCREEN_HEIGHT)
+#define LCD_MADCTL_MX 0x40
+#define LCD_MADCTL_MY 0x80
+#define LCD_MADCTL_MV 0x20
+
 static spi_device_handle_t spi_dev;
 static QueueHandle_t spi_transactions;
 static QueueHandle_t spi_buffers;
 static QueueHandle_t display_task_queue;
+static SemaphoreHandle_t display_done;
+static int display_pending; // Frames queued but not yet fully sent to the LCD
+static rg_video_update_t *last_drawn;
 
 static rg_display_counters_t counters;
 static rg_display_config_t config;
 static rg_display_t display;
+static bool headless = false; // Benchmark mode: frames are converted into a scratch buffer, never sent
+static uint16_t *headless_buffer; // Stands in for the SPI buffers in headless mode
+static int lcd_madctl = -1;   // Memory Access Control set by lcd_init, -1 if it didn't set one
+static int lcd_width = RG_SCREEN_WIDTH, lcd_height = RG_SCREEN_HEIGHT; // Current LCD addressing
+
+// Frames are rotated either by the LCD controller (MADCTL) while they're sent, or by transposing
+// the source in write_rect. Either way the application renders them upright.
+static struct {
+    display_rotation_t rotation; // OFF, LEFT (counter-clockwise) or RIGHT (clockwise)
+    bool madctl;                 // Rotated by the LCD controller
+    int screen_width;            // Screen as addressed by write_rect
+    int screen_height;
+    int source_width;            // Source as read by write_rect
+    int source_height;
+    uint8_t *lines;              // Software rotation: TRANSPOSE_LINES source columns
+    int first_line;              // First of them, -1 if lines must be refilled
+} view;
 
 static struct {
     uint8_t start  : 1; // Indicates this line or column is safe to start an update on
@@ -38,7 +67,29 @@ static struct {
 } filter_lines[320];
 static struct {
     uint8_t empty;
-} screen_lines[RG_SCREEN_HEIGHT];
+} screen_lines[SCREEN_MAX_SIZE];
+static struct {
+    uint16_t source;  // Source column displayed at this screen column (relative to the viewport)
+    uint16_t blend;   // Column is a repeat of the previous one and is smoothed by the horizontal filter
+} screen_columns[SCREEN_MAX_SIZE + 1];
+
+typedef struct
+{
+    rg_video_update_t update; // Must be first
+    rg_video_update_t *reference; // The frame this one was diffed against
+} swapchain_frame_t;
+
+static struct {
+    swapchain_frame_t *frames;
+    QueueHandle_t free;
+    rg_video_update_t *last_presented;
+    uint16_t palette[256]; // Palette of the last presented frame, inherited by acquired frames
+    rg_display_drop_t policy;
+    int count;
+} swapchain;
+
+typedef void (*scale_line_t)(uint16_t *, const void *, const uint16_t *, const void *, int);
+static scale_line_t scale_line;
 
 static const char *SETTING_BACKLIGHT = "DispBacklight";
 static const char *SETTING_SCALING = "DispScaling";
@@ -171,6 +222,9 @@ static void spi_deinit(void)
 
 static void ili9341_cmd(uint8_t cmd, const void *data, size_t data_len)
 {
+    // Remember the orientation set by the init sequence, frame rotation is relative to it
+    if (cmd == 0x36 && data && data_len == 1)
+        lcd_madctl = *(const uint8_t *)data;
     spi_queue_transaction(&cmd, 1, 0);
     if (data && data_len > 0)
         spi_queue_transaction(data, data_len, 1);
@@ -355,7 +409,7 @@ static void lcd_set_window(int left, int top, int width, int height)
     int right = left + width - 1;
     int bottom = top + height - 1;
 
-    if (left < 0 || top < 0 || right >= RG_SCREEN_WIDTH || bottom >= RG_SCREEN_HEIGHT)
+    if (left < 0 || top < 0 || right >= lcd_width || bottom >= lcd_height)
     {
         RG_LOGW("Bad lcd window (x0=%d, y0=%d, x1=%d, y1=%d)\n", left, top, right, bottom);
     }
@@ -367,6 +421,32 @@ static void lcd_set_window(int left, int top, int width, int height)
     //     ili9341_cmd(0x3C, NULL, 0); // Memory write continue
 }
 
+// Rotates the LCD addressing by 90 degrees (or back to normal), the panel then shows the source
+// rotated without us moving a single pixel. Only used when there are no margins.
+static void lcd_set_rotation(display_rotation_t rotation)
+{
+    uint8_t madctl = lcd_madctl;
+
+    if (rotation == RG_DISPLAY_ROTATION_LEFT || rotation == RG_DISPLAY_ROTATION_RIGHT)
+    {
+        // Composing the current orientation with a quarter turn swaps rows/columns and mirrors
+        // one axis. Which one depends on the direction and whether rows/columns are already swapped.
+        bool mv = lcd_madctl & LCD_MADCTL_MV;
+        bool left = rotation == RG_DISPLAY_ROTATION_LEFT;
+        madctl ^= LCD_MADCTL_MV | ((left == mv) ? LCD_MADCTL_MX : LCD_MADCTL_MY);
+        lcd_width = RG_SCREEN_HEIGHT;
+        lcd_height = RG_SCREEN_WIDTH;
+    }
+    else
+    {
+        lcd_width = RG_SCREEN_WIDTH;
+        lcd_height = RG_SCREEN_HEIGHT;
+    }
+
+    spi_queue_transaction((uint8_t[]){0x36}, 1, 0);
+    spi_queue_transaction(&madctl, 1, 1);
+}
+
 static inline unsigned blend_pixels(unsigned a, unsigned b)
 {
     // Fast path
@@ -377,30 +457,83 @@ static inline unsigned blend_pixels(unsigned a, unsigned b)
     a = (a << 8) | (a >> 8);
     b = (b << 8) | (b >> 8);
 
-    // Signed arithmetic is deliberate here
-    int r0 = (a >> 11) & 0x1F;
-    int g0 = (a >> 5) & 0x3F;
-    int b0 = (a) & 0x1F;
+    // Per-channel floor((a + b) / 2): the mask drops each channel's LSB so nothing leaks across
+    unsigned v = (a & b) + (((a ^ b) & 0xF7DE) >> 1);
 
-    int r1 = (b >> 11) & 0x1F;
-    int g1 = (b >> 5) & 0x3F;
-    int b1 = (b) & 0x1F;
+    // Back to Big-Endian
+    return (v << 8 | v >> 8) & 0xFFFF;
+}
 
-    int rv = (((r1 - r0) >> 1) + r0);
-    int gv = (((g1 - g0) >> 1) + g0);
-    int bv = (((b1 - b0) >> 1) + b0);
+// Scalers for each source format, with and without horizontal filtering. The column tables are
+// built by update_viewport_scaling() and already point to the first column of the rectangle.
+#define SCALE_LINE_FUNC(name, type, pixel, filter) \
+    IRAM_ATTR static void name(uint16_t *dst, const void *src, const uint16_t *palette, const void *cols, int count) \
+    { \
+        const typeof(*screen_columns) *col = cols; \
+        const type *in = src; \
+        for (int x = 0; x < count; ++x) \
+        { \
+            if (filter && col[x].blend && x > 0 && x + 1 < count) \
+                dst[x] = blend_pixels(dst[x - 1], pixel(in[col[x + 1].source])); \
+            else \
+                dst[x] = pixel(in[col[x].source]); \
+        } \
+    }
+#define PIXEL_PAL8(p) palette[p]
+#define PIXEL_565_LE(p) (uint16_t)((p) << 8 | (p) >> 8)
+#define PIXEL_565_BE(p) (p)
+SCALE_LINE_FUNC(scale_line_pal8, uint8_t, PIXEL_PAL8, 0)
+SCALE_LINE_FUNC(scale_line_pal8_filter, uint8_t, PIXEL_PAL8, 1)
+SCALE_LINE_FUNC(scale_line_565le, uint16_t, PIXEL_565_LE, 0)
+SCALE_LINE_FUNC(scale_line_565le_filter, uint16_t, PIXEL_565_LE, 1)
+SCALE_LINE_FUNC(scale_line_565be, uint16_t, PIXEL_565_BE, 0)
+SCALE_LINE_FUNC(scale_line_565be_filter, uint16_t, PIXEL_565_BE, 1)
+#undef PIXEL_PAL8
+#undef PIXEL_565_LE
+#undef PIXEL_565_BE
+#undef SCALE_LINE_FUNC
+
+// Returns line `line` of the rotated source, which is one of the source's columns. Columns are
+// transposed TRANSPOSE_LINES at a time so that the source is still read a row at a time.
+static const uint8_t *transpose_line(const uint8_t *framebuffer, int line)
+{
+    if (view.first_line < 0 || line < view.first_line || line >= view.first_line + TRANSPOSE_LINES)
+    {
+        const int pixlen = display.source.pixlen;
+        const int stride = display.source.stride;
+        const int rows = display.source.height; // The length of a rotated line
+        const bool left = view.rotation == RG_DISPLAY_ROTATION_LEFT;
+        const int first = line - (line % TRANSPOSE_LINES);
+        const int count = RG_MIN(TRANSPOSE_LINES, view.source_height - first);
+        // LEFT: line n is column (width - 1 - n), read right to left. RIGHT: line n is column n.
+        const int column = left ? display.source.width - first - count : first;
+        const uint8_t *src = framebuffer + display.source.offset + column * pixlen;
+
+        for (int row = 0; row < rows; ++row, src += stride)
+        {
+            // LEFT: source row n is rotated column n. RIGHT: it's column (rows - 1 - n).
+            int x = left ? row : rows - 1 - row;
+            for (int i = 0; i < count; ++i)
+            {
+                int n = left ? count - 1 - i : i;
+                if (pixlen == 1)
+                    view.lines[n * rows + x] = src[i];
+                else
+                    ((uint16_t *)view.lines)[n * rows + x] = ((const uint16_t *)src)[i];
+            }
+        }
 
-    unsigned v = (rv << 11) | (gv << 5) | (bv);
+        view.first_line = first;
+    }
 
-    // Back to Big-Endian
-    return (v << 8) | (v >> 8);
+    return view.lines + (line - view.first_line) * display.source.height * display.source.pixlen;
 }
 
 static inline void write_rect(int left, int top, int width, int height,
                               const void *framebuffer, const uint16_t *palette)
 {
-    const int screen_width = display.screen.width;
-    const int screen_height = display.screen.height;
+    const int screen_width = view.screen_width;
+    const int screen_height = view.screen_height;
     const int x_inc = display.viewport.x_inc;
     const int y_inc = display.viewport.y_inc;
     const int scaled_left = ((screen_width * left) + (x_inc - 1)) / x_inc;
@@ -413,27 +546,31 @@ static inline void write_rect(int left, int top, int width, int height,
     const int screen_left = display.viewport.x_pos + scaled_left;
     const int screen_bottom = RG_MIN(screen_top + scaled_height, screen_height);
     const int lines_per_buffer = SPI_BUFFER_LENGTH / scaled_width;
-    const int ix_acc = (x_inc * scaled_left) % screen_width;
     const int filter_mode = config.scaling ? config.filter : 0;
     const bool filter_y = filter_mode == RG_DISPLAY_FILTER_VERT || filter_mode == RG_DISPLAY_FILTER_BOTH;
-    const bool filter_x = filter_mode == RG_DISPLAY_FILTER_HORIZ || filter_mode == RG_DISPLAY_FILTER_BOTH;
-    const int format = display.source.format;
     const int stride = display.source.stride;
-    union { const uint8_t *u8; const uint16_t *u16; } buffer;
+    const bool transpose = view.lines != NULL;
+    const void *columns = &screen_columns[RG_MIN(scaled_left, screen_width)];
+    const uint8_t *buffer;
 
-    if (scaled_width < 1 || scaled_height < 1)
+    if (scaled_width < 1 || scaled_height < 1 || scaled_left + scaled_width > screen_width + 1)
     {
         return;
     }
 
-    buffer.u8 = framebuffer + display.source.offset + (top * stride) + (left * display.source.pixlen);
+    // The column table maps to absolute source columns, so the buffer starts at the line's beginning
+    buffer = framebuffer + display.source.offset + (top * stride);
+
+    // Each rectangle is another part of the frame, or another frame entirely
+    view.first_line = -1;
 
-    lcd_set_window(
-        screen_left + RG_SCREEN_MARGIN_LEFT,
-        screen_top + RG_SCREEN_MARGIN_TOP,
-        scaled_width,
-        scaled_height
-    );
+    if (!headless)
+        lcd_set_window(
+            screen_left + RG_SCREEN_MARGIN_LEFT,
+            screen_top + RG_SCREEN_MARGIN_TOP,
+            scaled_width,
+            scaled_height
+        );
 
     for (int y = 0, screen_y = screen_top; y < height;)
     {
@@ -452,7 +589,7 @@ static inline void write_rect(int left, int top, int width, int height,
             break;
         }
 
-        uint16_t *line_buffer = spi_get_buffer();
+        uint16_t *line_buffer = headless ? headless_buffer : spi_get_buffer();
         uint16_t *line_buffer_ptr = line_buffer;
 
         for (int i = 0; i < lines_to_copy; ++i)
@@ -464,66 +601,33 @@ static inline void write_rect(int left, int top, int width, int height,
             }
             else
             {
-                #define RENDER_LINE(pixel) { \
-                    for (int x = 0, x_acc = ix_acc; x < width;) { \
-                        *line_buffer_ptr++ = (pixel); \
-                        x_acc += x_inc; \
-                        while (x_acc >= screen_width) { \
-                            x_acc -= screen_width; \
-                            ++x; \
-                        } \
-                    } \
-                }
-                if (format & RG_PIXEL_PAL)
-                    RENDER_LINE(palette[buffer.u8[x]])
-                else if (format & RG_PIXEL_LE)
-                    RENDER_LINE((buffer.u16[x] << 8) | (buffer.u16[x] >> 8))
+                if (transpose)
+                    scale_line(line_buffer_ptr, transpose_line(framebuffer, top + y), palette, columns, scaled_width);
                 else
-                    RENDER_LINE(buffer.u16[x])
+                    scale_line(line_buffer_ptr, buffer, palette, columns, scaled_width);
+                line_buffer_ptr += scaled_width;
             }
 
             if (!screen_lines[++screen_y].empty)
             {
-                buffer.u8 += stride;
+                buffer += stride;
                 ++y;
             }
         }
 
-        if (filter_y || filter_x)
+        if (filter_y)
         {
             const int top = screen_y - lines_to_copy;
 
             for (int y = 0, fill_line = -1; y < lines_to_copy; y++)
             {
-                if (filter_y && y && screen_lines[top + y].empty)
+                if (y && screen_lines[top + y].empty)
                 {
                     fill_line = y;
                     continue;
                 }
 
-                // Filter X
-                if (filter_x)
-                {
-                    uint16_t *buffer = line_buffer + y * scaled_width;
-                    for (int x = 0, frame_x = 0, prev_frame_x = -1, x_acc = ix_acc; x < scaled_width; ++x)
-                    {
-                        if (frame_x == prev_frame_x && x > 0 && x + 1 < scaled_width)
-                        {
-                            buffer[x] = blend_pixels(buffer[x - 1], buffer[x + 1]);
-                        }
-                        prev_frame_x = frame_x;
-
-                        x_acc += x_inc;
-                        while (x_acc >= screen_width)
-                        {
-                            x_acc -= screen_width;
-                            ++frame_x;
-                        }
-                    }
-                }
-
-                // Filter Y
-                if (filter_y && fill_line > 0)
+                if (fill_line > 0)
                 {
                     uint16_t *lineA = line_buffer + (fill_line - 1) * scaled_width;
                     uint16_t *lineB = line_buffer + (fill_line + 0) * scaled_width;
@@ -537,21 +641,36 @@ static inline void write_rect(int left, int top, int width, int height,
             }
         }
 
-        lcd_send_data(line_buffer, scaled_width * lines_to_copy * 2);
+        if (!headless)
+            lcd_send_data(line_buffer, scaled_width * lines_to_copy * 2);
     }
 }
 
 static void update_viewport_scaling(void)
 {
-    int src_width = display.source.width;
-    int src_height = display.source.height;
+    bool rotated = view.rotation == RG_DISPLAY_ROTATION_LEFT || view.rotation == RG_DISPLAY_ROTATION_RIGHT;
+
+    // Rotating swaps either the screen's dimensions (LCD) or the source's (transpose)
+    view.screen_width = view.madctl ? display.screen.height : display.screen.width;
+    view.screen_height = view.madctl ? display.screen.width : display.screen.height;
+    view.source_width = (rotated && !view.madctl) ? display.source.height : display.source.width;
+    view.source_height = (rotated && !view.madctl) ? display.source.width : display.source.height;
+
+    free(view.lines);
+    view.lines = NULL;
+    view.first_line = -1;
+    if (rotated && !view.madctl)
+        view.lines = rg_alloc(TRANSPOSE_LINES * display.source.height * display.source.pixlen, MEM_FAST);
+
+    int src_width = view.source_width;
+    int src_height = view.source_height;
     int new_width = src_width;
     int new_height = src_height;
     double new_ratio = 0.0;
 
     if (config.scaling == RG_DISPLAY_SCALING_FILL)
     {
-        new_ratio = display.screen.width / (double)display.screen.height;
+        new_ratio = view.screen_width / (double)view.screen_height;
     }
     else if (config.scaling == RG_DISPLAY_SCALING_FIT)
     {
@@ -560,32 +679,53 @@ static void update_viewport_scaling(void)
 
     if (new_ratio > 0.0)
     {
-        new_width = display.screen.height * new_ratio;
-        new_height = display.screen.height;
+        new_width = view.screen_height * new_ratio;
+        new_height = view.screen_height;
 
-        if (new_width > display.screen.width)
+        if (new_width > view.screen_width)
         {
             RG_LOGW("new_width too large: %d, reducing new_height to maintain ratio.\n", new_width);
-            new_height = display.screen.height * (display.screen.width / (double)new_width);
-            new_width = display.screen.width;
+            new_height = view.screen_height * (view.screen_width / (double)new_width);
+            new_width = view.screen_width;
         }
     }
 
-    display.viewport.x_pos = (display.screen.width - new_width) / 2;
-    display.viewport.y_pos = (display.screen.height - new_height) / 2;
-    display.viewport.x_inc = display.screen.width / (new_width / (double)src_width);
-    display.viewport.y_inc = display.screen.height / (new_height / (double)src_height);
+    display.viewport.x_pos = (view.screen_width - new_width) / 2;
+    display.viewport.y_pos = (view.screen_height - new_height) / 2;
+    display.viewport.x_inc = view.screen_width / (new_width / (double)src_width);
+    display.viewport.y_inc = view.screen_height / (new_height / (double)src_height);
     display.viewport.width = new_width;
     display.viewport.height = new_height;
 
+    // Build the column table used by the scaler and horizontal filter
+
+    memset(screen_columns, 0, sizeof(screen_columns));
+
+    for (int x = 0; x <= view.screen_width; ++x)
+    {
+        int source = RG_MIN((x * display.viewport.x_inc) / view.screen_width, src_width - 1);
+        screen_columns[x].source = source;
+        screen_columns[x].blend = x > 0 && source == screen_columns[x - 1].source;
+    }
+
+    int filter_mode = config.scaling ? config.filter : 0;
+    bool filter_x = filter_mode == RG_DISPLAY_FILTER_HORIZ || filter_mode == RG_DISPLAY_FILTER_BOTH;
+
+    if (display.source.format & RG_PIXEL_PAL)
+        scale_line = filter_x ? scale_line_pal8_filter : scale_line_pal8;
+    else if (display.source.format & RG_PIXEL_LE)
+        scale_line = filter_x ? scale_line_565le_filter : scale_line_565le;
+    else
+        scale_line = filter_x ? scale_line_565be_filter : scale_line_565be;
+
     // Build boundary tables used by filtering
 
     memset(filter_lines, 1, sizeof(filter_lines));
     memset(screen_lines, 0, sizeof(screen_lines));
 
-    int y_acc = (display.viewport.y_inc * display.viewport.y_pos) % display.screen.height;
+    int y_acc = (display.viewport.y_inc * display.viewport.y_pos) % view.screen_height;
 
-    for (int y = 0, screen_y = display.viewport.y_pos; y < src_height && screen_y < display.screen.height; ++screen_y)
+    for (int y = 0, screen_y = display.viewport.y_pos; y < src_height && screen_y < view.screen_height; ++screen_y)
     {
         int repeat = ++filter_lines[y].repeat;
 
@@ -594,9 +734,9 @@ static void update_viewport_scaling(void)
         screen_lines[screen_y].empty = repeat > 1;
 
         y_acc += display.viewport.y_inc;
-        while (y_acc >= display.screen.height)
+        while (y_acc >= view.screen_height)
         {
-            y_acc -= display.screen.height;
+            y_acc -= view.screen_height;
             ++y;
         }
     }
@@ -606,44 +746,93 @@ static void update_viewport_scaling(void)
             display.viewport.y_pos, display.viewport.x_inc, display.viewport.y_inc);
 }
 
-static void display_task(void *arg)
+static inline swapchain_frame_t *swapchain_frame(const rg_video_update_t *update)
 {
-    display_task_queue = xQueueCreate(1, sizeof(rg_video_update_t *));
+    swapchain_frame_t *frame = (swapchain_frame_t *)update;
+    if (swapchain.frames && frame >= swapchain.frames && frame < swapchain.frames + swapchain.count)
+        return frame;
+    return NULL;
+}
 
-    while (1)
+static inline void swapchain_release(rg_video_update_t *update)
+{
+    if (swapchain_frame(update))
+        xQueueSend(swapchain.free, &update, 0);
+}
+
+// Converts and sends the changed parts of a frame. In headless mode the conversion still runs, into a
+// scratch buffer, so that benchmarks measure it.
+static void draw_update(rg_video_update_t *update)
+{
+    if (display.changed)
     {
-        rg_video_update_t *update;
+        if (config.scaling != RG_DISPLAY_SCALING_FILL)
+            rg_display_clear(C_BLACK);
+        update_viewport_scaling();
+        update->type = RG_UPDATE_FULL;
+        display.changed = false;
+    }
 
-        xQueuePeek(display_task_queue, &update, portMAX_DELAY);
-        // xQueueReceive(display_task_queue, &update, portMAX_DELAY);
+    if (update->type == RG_UPDATE_FULL)
+    {
+        // write_rect();
+        update->diff[0] = (rg_line_diff_t){
+            .left = 0,
+            .width = display.source.width,
+            .repeat = display.source.height,
+        };
+    }
 
-        // Received a shutdown request!
-        if (update == (void*)-1)
-            break;
+    // It's better to update the counters before we start the transfer, in case someone needs it
+    if (update->type == RG_UPDATE_FULL)
+        counters.fullFrames++;
+    counters.totalFrames++;
+
+    if (view.lines)
+    {
+        // Software rotation: send the bounding box of the changes, transposed
+        int left = display.source.width, top = display.source.height, right = 0, bottom = 0;
 
-        if (display.changed)
+        for (int y = 0; y < display.source.height;)
         {
-            if (config.scaling != RG_DISPLAY_SCALING_FILL)
-                rg_display_clear(C_BLACK);
-            update_viewport_scaling();
-            update->type = RG_UPDATE_FULL;
-            display.changed = false;
+            rg_line_diff_t *diff = &update->diff[y];
+
+            if (diff->width > 0)
+            {
+                left = RG_MIN(left, diff->left);
+                right = RG_MAX(right, diff->left + diff->width);
+                top = RG_MIN(top, y);
+                bottom = RG_MAX(bottom, y + diff->repeat);
+            }
+            y += diff->repeat;
         }
 
-        if (update->type == RG_UPDATE_FULL)
+        if (right > left)
         {
-            // write_rect();
-            update->diff[0] = (rg_line_diff_t){
-                .left = 0,
-                .width = display.source.width,
-                .repeat = display.source.height,
-            };
-        }
+            bool ccw = view.rotation == RG_DISPLAY_ROTATION_LEFT;
+            int rot_left = ccw ? top : display.source.height - bottom;
+            int rot_top = ccw ? display.source.width - right : left;
+            int rot_right = rot_left + (bottom - top);
+            int rot_bottom = rot_top + (right - left);
 
-        // It's better to update the counters before we start the transfer, in case someone needs it
-        if (update->type == RG_UPDATE_FULL)
-            counters.fullFrames++;
-        counters.totalFrames++;
+            // prepare_update can't align transposed changes on the filter boundaries, do it here
+            if (config.filter && config.scaling)
+            {
+                while (rot_top > 0 && !filter_lines[rot_top].start)
+                    rot_top--;
+                while (rot_bottom < view.source_height && !filter_lines[rot_bottom - 1].stop)
+                    rot_bottom++;
+                rot_left = RG_MAX(rot_left - 1, 0);
+                rot_right = RG_MIN(rot_right + 1, view.source_width);
+            }
+
+            write_rect(rot_left, rot_top, rot_right - rot_left, rot_bottom - rot_top, update->buffer, update->palette);
+        }
+    }
+    else
+    {
+        if (view.madctl && !headless)
+            lcd_set_rotation(view.rotation);
 
         for (int y = 0; y < display.source.height;)
         {
@@ -656,11 +845,44 @@ static void display_task(void *arg)
             y += diff->repeat;
         }
 
+        // Everything else (GUI, clear) draws in the LCD's normal orientation
+        if (view.madctl && !headless)
+            lcd_set_rotation(RG_DISPLAY_ROTATION_OFF);
+    }
+}
+
+static void display_task(void *arg)
+{
+    while (1)
+    {
+        rg_video_update_t *update;
+
         xQueueReceive(display_task_queue, &update, portMAX_DELAY);
 
+        // Received a shutdown request!
+        if (update == (void*)-1)
+            break;
+
+        swapchain_frame_t *frame = swapchain_frame(update);
+
+        // A swapchain frame's diff is only valid if the frame it was diffed against is what's
+        // currently on screen. It won't be if that frame was dropped.
+        if (frame && frame->reference != last_drawn)
+            update->type = RG_UPDATE_FULL;
+
+        // We no longer read from the previous frame, the application can have it back
+        swapchain_release(last_drawn);
+        last_drawn = update;
+
+        draw_update(update);
+
         lcd_vsync();
+
+        __atomic_sub_fetch(&display_pending, 1, __ATOMIC_ACQ_REL);
+        xSemaphoreGive(display_done);
     }
 
+    vSemaphoreDelete(display_done);
     vQueueDelete(display_task_queue);
     display_task_queue = NULL;
 
@@ -726,7 +948,7 @@ display_filter_t rg_display_get_filter(void)
 void rg_display_set_rotation(display_rotation_t rotation)
 {
     config.rotation = RG_MIN(RG_MAX(0, rotation), RG_DISPLAY_ROTATION_COUNT - 1);
-    rg_settings_set_number(NS_APP, SETTING_SCALING, config.rotation);
+    rg_settings_set_number(NS_APP, SETTING_ROTATION, config.rotation);
     display.changed = true;
 }
 
@@ -749,18 +971,26 @@ int rg_display_get_backlight(void)
 
 bool rg_display_save_frame(const char *filename, const rg_video_update_t *frame, int width, int height)
 {
-    rg_image_t *original = rg_image_alloc(display.source.width, display.source.height);
+    if (!frame)
+        return false;
+
+    const int src_width = display.source.width;
+    const int src_height = display.source.height;
+    const bool rotated = view.rotation == RG_DISPLAY_ROTATION_LEFT || view.rotation == RG_DISPLAY_ROTATION_RIGHT;
+
+    // The screenshot is saved the way it's displayed
+    rg_image_t *original = rotated ? rg_image_alloc(src_height, src_width) : rg_image_alloc(src_width, src_height);
     if (!original)
         return false;
 
     uint16_t *dst_ptr = original->data;
 
-    for (int y = 0; y < original->height; y++)
+    for (int y = 0; y < src_height; y++)
     {
         const uint8_t *src_ptr8 = frame->buffer + display.source.offset + (y * display.source.stride);
         const uint16_t *src_ptr16 = (const uint16_t *)src_ptr8;
 
-        for (int x = 0; x < original->width; x++)
+        for (int x = 0; x < src_width; x++)
         {
             uint16_t pixel;
 
@@ -772,7 +1002,12 @@ bool rg_display_save_frame(const char *filename, const rg_video_update_t *frame,
             if (!(display.source.format & RG_PIXEL_LE))
                 pixel = (pixel << 8) | (pixel >> 8);
 
-            *(dst_ptr++) = pixel;
+            if (view.rotation == RG_DISPLAY_ROTATION_LEFT)
+                original->data[(src_width - 1 - x) * src_height + y] = pixel;
+            else if (view.rotation == RG_DISPLAY_ROTATION_RIGHT)
+                original->data[x * src_height + (src_height - 1 - y)] = pixel;
+            else
+                *(dst_ptr++) = pixel;
         }
     }
 
@@ -785,10 +1020,29 @@ bool rg_display_save_frame(const char *filename, const rg_video_update_t *frame,
     return success;
 }
 
+// Both functions return the width of the changed area (in words) and store its start in *left.
+// The left edge is found scanning forward and the right edge scanning backward from the end of
+// the line, so that each word is compared at most once.
+#define DIFF_LINE_FUNC(name, type) \
+    IRAM_ATTR static int name(const type *a, const type *b, int words, int *left) \
+    { \
+        int x = 0, xr = words - 1; \
+        while (x < words && a[x] == b[x]) \
+            ++x; \
+        if (x == words) \
+            return (*left = 0); \
+        while (xr > x && a[xr] == b[xr]) \
+            --xr; \
+        *left = x; \
+        return xr + 1 - x; \
+    }
+DIFF_LINE_FUNC(diff_line_32, uint32_t)
+DIFF_LINE_FUNC(diff_line_64, uint64_t)
+#undef DIFF_LINE_FUNC
+
 IRAM_ATTR
-rg_update_t rg_display_queue_update(/*const*/ rg_video_update_t *update, const rg_video_update_t *previousUpdate)
+static rg_update_t prepare_update(rg_video_update_t *update, const rg_video_update_t *previousUpdate)
 {
-    const int64_t time_start = rg_system_timer();
     // RG_ASSERT(display.source.width && display.source.height, "Source format not set!");
     RG_ASSERT(update, "update is null!");
 
@@ -804,52 +1058,54 @@ rg_update_t rg_display_queue_update(/*const*/ rg_video_update_t *update, const r
     }
     else // RG_UPDATE_PARTIAL
     {
-        const uint32_t *frame_buffer = update->buffer + display.source.offset; // uint64_t is 0.7% faster!
-        const uint32_t *prev_buffer = previousUpdate->buffer + display.source.offset;
+        const uint8_t *frame_buffer = update->buffer + display.source.offset;
+        const uint8_t *prev_buffer = previousUpdate->buffer + display.source.offset;
         const int frame_width = display.source.width;
         const int frame_height = display.source.height;
         const int stride = display.source.stride;
-        const int blocks = (frame_width * display.source.pixlen) / sizeof(*frame_buffer);
-        const int pixels_per_block = sizeof(*frame_buffer) / display.source.pixlen;
+        const int line_bytes = frame_width * display.source.pixlen;
         rg_line_diff_t *out_diff = update->diff;
 
+        // Use the widest word that the buffers' alignment and stride allow
+        const bool wide = ((line_bytes | stride | (intptr_t)frame_buffer | (intptr_t)prev_buffer) & 7) == 0;
+        const int word_size = wide ? 8 : 4;
+        const int words = line_bytes / word_size;
+        const int pixels_per_word = word_size / display.source.pixlen;
+
+        #define DIFF_LINE(y) { \
+            const void *a = frame_buffer + (y) * stride, *b = prev_buffer + (y) * stride; \
+            int span = wide ? diff_line_64(a, b, words, &left) : diff_line_32(a, b, words, &left); \
+            out_diff[y].left = left * pixels_per_word; \
+            out_diff[y].width = span * pixels_per_word; \
+            out_diff[y].repeat = 1; \
+            changed += out_diff[y].width; \
+        }
+
         // If more than 50% of the screen has changed then stop the comparison and assume that the
-        // rest also changed. This is true in 77% of the cases in Pokemon, resulting in a net
-        // benefit. The other 23% of cases would have benefited from finishing the diff, so a better
-        // heuristic might be preferable (interlaced compare perhaps?).
+        // rest also changed. To avoid diffing half the frame before finding out, we first sample
+        // one line out of DIFF_SAMPLE_STEP and extrapolate. Sampled lines are kept for the full pass.
         int threshold = (frame_width * frame_height) / 2;
         int changed = 0;
+        int left = 0;
 
-        for (int y = 0; y < frame_height; ++y)
-        {
-            int left = 0, width = 0;
+        for (int y = DIFF_SAMPLE_STEP / 2; y < frame_height; y += DIFF_SAMPLE_STEP)
+            DIFF_LINE(y);
 
-            for (int x = 0; x < blocks && changed < threshold; ++x)
+        if (changed * DIFF_SAMPLE_STEP < threshold)
+        {
+            for (int y = 0; y < frame_height && changed < threshold; ++y)
             {
-                if (frame_buffer[x] != prev_buffer[x])
-                {
-                    for (int xl = blocks - 1; xl >= x; --xl)
-                    {
-                        if (frame_buffer[xl] != prev_buffer[xl])
-                        {
-                            left = x * pixels_per_block;
-                            width = ((xl + 1) - x) * pixels_per_block;
-                            changed += width;
-                            break;
-                        }
-                    }
-                    break;
-                }
+                if ((y % DIFF_SAMPLE_STEP) != DIFF_SAMPLE_STEP / 2)
+                    DIFF_LINE(y);
             }
-
-            out_diff[y].left = left;
-            out_diff[y].width = width;
-            out_diff[y].repeat = 1;
-
-            frame_buffer = (void *)frame_buffer + stride;
-            prev_buffer = (void *)prev_buffer + stride;
+        }
+        else
+        {
+            changed = threshold;
         }
 
+        #undef DIFF_LINE
+
         if (changed == 0)
         {
             update->type = RG_UPDATE_EMPTY;
@@ -863,7 +1119,8 @@ rg_update_t rg_display_queue_update(/*const*/ rg_video_update_t *update, const r
             update->type = RG_UPDATE_PARTIAL;
 
             // If filtering is enabled we must adjust our diff blocks to be on appropriate boundaries
-            if (config.filter && config.scaling)
+            // (Transposed frames are adjusted by the display task, filter_lines is in their space)
+            if (config.filter && config.scaling && !view.lines)
             {
                 for (int y = 0; y < frame_height; ++y)
                 {
@@ -923,13 +1180,160 @@ rg_update_t rg_display_queue_update(/*const*/ rg_video_update_t *update, const r
         }
     }
 
+    return update->type;
+}
+
+static void submit_update(rg_video_update_t *update)
+{
+    if (headless)
+    {
+        // Behave as if the frame was drawn instantly, the conversion is done right here
+        swapchain_release(last_drawn);
+        last_drawn = update;
+        draw_update(update);
+        return;
+    }
+
+    __atomic_add_fetch(&display_pending, 1, __ATOMIC_ACQ_REL);
     xQueueSend(display_task_queue, &update, portMAX_DELAY);
+}
+
+rg_update_t rg_display_queue_update(/*const*/ rg_video_update_t *update, const rg_video_update_t *previousUpdate)
+{
+    int64_t time_start = rg_system_timer();
+
+    prepare_update(update, previousUpdate);
+
+    // Callers own their buffers and expect previousUpdate to be free for reuse when we return
+    rg_display_sync();
+    submit_update(update);
+
+    counters.busyTime += rg_system_timer() - time_start;
+
+    return update->type;
+}
+
+void rg_display_swapchain_init(int count, size_t buffer_size, uint32_t caps, rg_display_drop_t policy)
+{
+    rg_display_swapchain_deinit();
+
+    count = RG_MIN(RG_MAX(2, count), RG_DISPLAY_SWAPCHAIN_MAX);
+
+    swapchain.frames = rg_alloc(count * sizeof(swapchain_frame_t), MEM_ANY);
+    swapchain.free = xQueueCreate(count, sizeof(rg_video_update_t *));
+    swapchain.last_presented = NULL;
+    swapchain.policy = policy;
+    swapchain.count = count;
+
+    for (int i = 0; i < count; ++i)
+    {
+        rg_video_update_t *update = &swapchain.frames[i].update;
+        update->buffer = rg_alloc(buffer_size, caps);
+        xQueueSend(swapchain.free, &update, 0);
+    }
+
+    RG_LOGI("Swapchain ready: %d frames of %d bytes, drop policy %d.\n", count, (int)buffer_size, policy);
+}
+
+void rg_display_swapchain_deinit(void)
+{
+    if (!swapchain.frames)
+        return;
+
+    rg_display_sync();
+    last_drawn = NULL; // The display task is idle
+
+    for (int i = 0; i < swapchain.count; ++i)
+        free(swapchain.frames[i].update.buffer);
+    free(swapchain.frames);
+    vQueueDelete(swapchain.free);
+
+    memset(&swapchain, 0, sizeof(swapchain));
+}
+
+rg_video_update_t *rg_display_acquire_frame(void)
+{
+    rg_video_update_t *update = NULL;
+
+    if (!swapchain.frames)
+        return NULL;
+
+    if (xQueueReceive(swapchain.free, &update, 0) != pdTRUE)
+    {
+        int64_t time_start = rg_system_timer();
+
+        // Every frame is in flight. Steal the oldest one that the display hasn't started yet, the
+        // display task will notice that the next frame's reference is gone and draw it in full.
+        if (swapchain.policy == RG_DISPLAY_DROP_OLDEST && !headless
+            && xQueueReceive(display_task_queue, &update, 0) == pdTRUE)
+        {
+            if (swapchain_frame(update))
+            {
+                if (update == swapchain.last_presented)
+                    swapchain.last_presented = NULL;
+                __atomic_sub_fetch(&display_pending, 1, __ATOMIC_ACQ_REL);
+                xSemaphoreGive(display_done);
+                counters.droppedFrames++;
+            }
+            else
+            {
+                // Not ours (shutdown request or legacy update), put it back
+                xQueueSendToFront(display_task_queue, &update, portMAX_DELAY);
+                update = NULL;
+            }
+        }
+
+        if (!update)
+            xQueueReceive(swapchain.free, &update, portMAX_DELAY);
+
+        counters.busyTime += rg_system_timer() - time_start;
+    }
+
+    if (display.source.format & RG_PIXEL_PAL)
+        memcpy(update->palette, swapchain.palette, sizeof(swapchain.palette));
+
+    return update;
+}
+
+rg_update_t rg_display_present_frame(rg_video_update_t *update)
+{
+    swapchain_frame_t *frame = swapchain_frame(update);
+    int64_t time_start = rg_system_timer();
+
+    RG_ASSERT(frame, "Frame doesn't belong to the swapchain");
+
+    // A palette change invalidates the diff, frames acquired from now on inherit the new palette
+    if ((display.source.format & RG_PIXEL_PAL) && memcmp(update->palette, swapchain.palette, sizeof(swapchain.palette)))
+    {
+        memcpy(swapchain.palette, update->palette, sizeof(swapchain.palette));
+        swapchain.last_presented = NULL;
+    }
+
+    // The display hasn't even started on the previous frame, this one would only add latency
+    if (swapchain.policy == RG_DISPLAY_DROP_NEWEST && !headless && uxQueueMessagesWaiting(display_task_queue) > 0)
+    {
+        xQueueSend(swapchain.free, &update, 0);
+        counters.droppedFrames++;
+        return update->type = RG_UPDATE_EMPTY;
+    }
+
+    rg_video_update_t *previous = swapchain.last_presented;
+
+    frame->reference = previous;
+    prepare_update(update, previous);
+    swapchain.last_presented = update;
+    submit_update(update);
 
     counters.busyTime += rg_system_timer() - time_start;
 
     return update->type;
 }
 
+rg_video_update_t *rg_display_last_frame(void)
+{
+    return swapchain.last_presented ?: last_drawn;
+}
+
 void rg_display_set_source_format(int width, int height, int crop_h, int crop_v, int stride, int format)
 {
     rg_display_sync();
@@ -950,10 +1354,32 @@ void rg_display_set_source_format(int width, int height, int crop_h, int crop_v,
     display.changed = true;
 }
 
+void rg_display_set_source_rotation(display_rotation_t rotation)
+{
+    rg_display_sync();
+
+    if (rotation != RG_DISPLAY_ROTATION_LEFT && rotation != RG_DISPLAY_ROTATION_RIGHT)
+        rotation = RG_DISPLAY_ROTATION_OFF;
+
+    // The LCD can only do it if the frame is free to use the whole panel
+    view.rotation = rotation;
+    view.madctl = rotation != RG_DISPLAY_ROTATION_OFF && lcd_madctl >= 0
+        && RG_SCREEN_MARGIN_LEFT == 0 && RG_SCREEN_MARGIN_RIGHT == 0
+        && RG_SCREEN_MARGIN_TOP == 0 && RG_SCREEN_MARGIN_BOTTOM == 0;
+    display.changed = true;
+
+    RG_LOGI("Source rotation: %d (%s)\n", rotation, view.madctl ? "lcd" : "transpose");
+}
+
 void rg_display_sync(void)
 {
-    while (uxQueueMessagesWaiting(display_task_queue))
-        continue; // Wait until display queue is done
+    if (headless)
+        return;
+
+    // The display task gives display_done after every frame, the timeout only guards against
+    // the task going away while we wait.
+    while (__atomic_load_n(&display_pending, __ATOMIC_ACQUIRE) > 0)
+        xSemaphoreTake(display_done, pdMS_TO_TICKS(100));
 }
 
 void rg_display_write(int left, int top, int width, int height, int stride, const uint16_t *buffer)
@@ -972,7 +1398,7 @@ void rg_display_write(int left, int top, int width, int height, int stride, cons
     height = RG_MIN(height, display.screen.height - top);
 
     // This can happen when left or top is out of bound
-    if (width < 0 || height < 0)
+    if (width < 0 || height < 0 || headless)
         return;
 
     // This will work for now because we rarely draw from different threads (so all we need is ensure
@@ -1020,6 +1446,9 @@ void rg_display_clear(uint16_t color_le)
     size_t pixels = RG_SCREEN_WIDTH * RG_SCREEN_HEIGHT;
     uint16_t color = (color_le << 8) | (color_le >> 8);
 
+    if (headless)
+        return;
+
     // We ignore margins here
     lcd_set_window(0, 0, RG_SCREEN_WIDTH, RG_SCREEN_HEIGHT);
 
@@ -1038,6 +1467,9 @@ void rg_display_clear(uint16_t color_le)
 
 void rg_display_deinit(void)
 {
+    if (headless)
+        return;
+
     void *stop = (void*)-1;
     xQueueSend(display_task_queue, &stop, portMAX_DELAY);
     while (display_task_queue)
@@ -1062,7 +1494,15 @@ void rg_display_init(void)
         .screen.height = RG_SCREEN_HEIGHT - RG_SCREEN_MARGIN_TOP - RG_SCREEN_MARGIN_BOTTOM,
         .changed = true,
     };
+    if ((headless = rg_system_get_app()->benchmark > 0))
+    {
+        headless_buffer = rg_alloc(SPI_BUFFER_LENGTH * 2, MEM_FAST);
+        RG_LOGI("Display is headless (benchmark mode).\n");
+        return;
+    }
     lcd_init();
+    display_task_queue = xQueueCreate(RG_DISPLAY_SWAPCHAIN_MAX, sizeof(rg_video_update_t *));
+    display_done = xSemaphoreCreateBinary();
     rg_task_create("rg_display", &display_task, NULL, 3 * 1024, 5, 1);
     RG_LOGI("Display ready.\n");
 }
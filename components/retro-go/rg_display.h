@@ -2,6 +2,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 typedef enum
 {
@@ -75,6 +76,7 @@ typedef struct
 {
     int32_t totalFrames;
     int32_t fullFrames;
+    int32_t droppedFrames;
     int64_t busyTime; // This is only time spent blocking the main task
 } rg_display_counters_t;
 
@@ -121,6 +123,15 @@ typedef struct
     rg_line_diff_t diff[256];
 } rg_video_update_t;
 
+typedef enum
+{
+    RG_DISPLAY_DROP_NONE = 0, // Block until the display releases a frame
+    RG_DISPLAY_DROP_OLDEST,   // Recycle the oldest frame still waiting to be displayed
+    RG_DISPLAY_DROP_NEWEST,   // Discard the frame being presented if the display is behind
+} rg_display_drop_t;
+
+#define RG_DISPLAY_SWAPCHAIN_MAX 4
+
 void rg_display_init(void);
 void rg_display_deinit(void);
 void rg_display_write(int left, int top, int width, int height, int stride,
@@ -130,8 +141,15 @@ void rg_display_sync(void);
 void rg_display_force_redraw(void);
 bool rg_display_save_frame(const char *filename, const rg_video_update_t *frame, int width, int height);
 void rg_display_set_source_format(int width, int height, int crop_h, int crop_v, int stride, int format);
+void rg_display_set_source_rotation(display_rotation_t rotation); // The source is drawn upright and rotated on screen
 rg_update_t rg_display_queue_update(/*const*/ rg_video_update_t *update, const rg_video_update_t *previousUpdate);
 
+void rg_display_swapchain_init(int count, size_t buffer_size, uint32_t caps, rg_display_drop_t policy);
+void rg_display_swapchain_deinit(void);
+rg_video_update_t *rg_display_acquire_frame(void);
+rg_update_t rg_display_present_frame(rg_video_update_t *update);
+rg_video_update_t *rg_display_last_frame(void);
+
 rg_display_counters_t rg_display_get_counters(void);
 rg_display_config_t rg_display_get_config(void);
 const rg_display_t *rg_display_get_info(void);
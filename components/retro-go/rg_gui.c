@@ -11,8 +11,29 @@
 #include "bitmaps/image_hourglass.h"
 #include "fonts/fonts.h"
 
+#define GLYPH_ATLAS_COUNT 4
+
+// Glyphs pre-rendered in RGB565 for one font, size and colour pair, filled as characters are used
+typedef struct {
+    const rg_font_t *font;
+    int points;
+    rg_color_t color_fg, color_bg;
+    uint32_t last_used;
+    rg_arena_t *arena;
+    uint16_t *pixels[256];
+    uint8_t widths[256]; // 0xFF when unknown
+} glyph_atlas_t;
+
+// Columns of a row that were drawn to since the last flush
+typedef struct {
+    int16_t left, right; // Empty when left > right
+    bool forced;         // The display doesn't show front_buffer, skip the comparison
+} row_damage_t;
+
 static struct {
     uint16_t *screen_buffer, *draw_buffer;
+    uint16_t *front_buffer; // What the display shows, when buffered
+    row_damage_t *damage;
     int screen_width, screen_height;
     struct {
         const rg_font_t *font;
@@ -26,6 +47,8 @@ static struct {
         rg_color_t scrollbar;
     } style;
     char theme[32];
+    glyph_atlas_t atlases[GLYPH_ATLAS_COUNT];
+    uint32_t atlas_clock;
     bool initialized;
 } gui;
 
@@ -96,18 +119,113 @@ bool rg_gui_set_theme(const char *theme_name)
     return true;
 }
 
+static void mark_damage(int left, int top, int width, int height, bool forced)
+{
+    if (!gui.damage)
+        return;
+
+    int right = RG_MIN(left + width, gui.screen_width) - 1;
+    int bottom = RG_MIN(top + height, gui.screen_height) - 1;
+
+    left = RG_MAX(left, 0);
+    top = RG_MAX(top, 0);
+
+    for (int y = top; y <= bottom && left <= right; ++y)
+    {
+        row_damage_t *row = &gui.damage[y];
+        if (row->left > row->right)
+        {
+            row->left = left;
+            row->right = right;
+        }
+        else
+        {
+            row->left = RG_MIN(row->left, left);
+            row->right = RG_MAX(row->right, right);
+        }
+        row->forced |= forced;
+    }
+}
+
 void rg_gui_set_buffered(bool buffered)
 {
     if (!buffered)
+    {
         free(gui.screen_buffer), gui.screen_buffer = NULL;
+        free(gui.front_buffer), gui.front_buffer = NULL;
+        free(gui.damage), gui.damage = NULL;
+    }
     else if (!gui.screen_buffer)
+    {
         gui.screen_buffer = rg_alloc(gui.screen_width * gui.screen_height * 2, MEM_SLOW);
+        gui.front_buffer = rg_alloc(gui.screen_width * gui.screen_height * 2, MEM_SLOW);
+        gui.damage = rg_alloc(gui.screen_height * sizeof(row_damage_t), MEM_ANY);
+        for (int y = 0; y < gui.screen_height; ++y)
+            gui.damage[y] = (row_damage_t){0, -1, false};
+        // We don't know what's on the screen yet
+        mark_damage(0, 0, gui.screen_width, gui.screen_height, true);
+    }
+}
+
+static void flush_band(int left, int top, int right, int bottom)
+{
+    int width = right - left + 1;
+    size_t offset = top * gui.screen_width + left;
+
+    rg_display_write(left, top, width, bottom - top + 1, gui.screen_width * 2, gui.screen_buffer + offset);
+
+    for (int y = top; y <= bottom; ++y, offset += gui.screen_width)
+        memcpy(gui.front_buffer + offset, gui.screen_buffer + offset, width * 2);
 }
 
 void rg_gui_flush(void)
 {
-    if (gui.screen_buffer)
-        rg_display_write(0, 0, gui.screen_width, gui.screen_height, 0, gui.screen_buffer);
+    if (!gui.screen_buffer)
+        return;
+
+    // Widgets are drawn over each other, so damaged areas are compared with what the display
+    // already shows. Consecutive rows that really changed are sent together as one rectangle.
+    int band_top = -1, band_left = 0, band_right = 0;
+
+    for (int y = 0; y <= gui.screen_height; ++y)
+    {
+        int left = 0, right = -1;
+
+        if (y < gui.screen_height && gui.damage[y].left <= gui.damage[y].right)
+        {
+            const uint16_t *back = gui.screen_buffer + y * gui.screen_width;
+            const uint16_t *front = gui.front_buffer + y * gui.screen_width;
+            row_damage_t *row = &gui.damage[y];
+
+            left = row->left;
+            right = row->right;
+            if (!row->forced)
+            {
+                while (left <= right && back[left] == front[left])
+                    left++;
+                while (right >= left && back[right] == front[right])
+                    right--;
+            }
+            *row = (row_damage_t){0, -1, false};
+        }
+
+        if (left <= right)
+        {
+            if (band_top < 0)
+            {
+                band_top = y;
+                band_left = left;
+                band_right = right;
+            }
+            band_left = RG_MIN(band_left, left);
+            band_right = RG_MAX(band_right, right);
+        }
+        else if (band_top >= 0)
+        {
+            flush_band(band_left, band_top, band_right, y - 1);
+            band_top = -1;
+        }
+    }
 }
 
 void rg_gui_copy_buffer(int left, int top, int width, int height, int stride, const void *buffer)
@@ -121,6 +239,8 @@ void rg_gui_copy_buffer(int left, int top, int width, int height, int stride, co
         width = RG_MIN(width, gui.screen_width - left);
         height = RG_MIN(height, gui.screen_height - top);
 
+        mark_damage(left, top, width, height, false);
+
         for (int y = 0; y < height; ++y)
         {
             uint16_t *dst = gui.screen_buffer + (top + y) * gui.screen_width + left;
@@ -203,6 +323,61 @@ static size_t get_glyph(uint16_t *output, const rg_font_t *font, int points, uin
     return glyph_width;
 }
 
+static glyph_atlas_t *get_atlas(const rg_font_t *font, int points, rg_color_t color_fg, rg_color_t color_bg)
+{
+    glyph_atlas_t *atlas = &gui.atlases[0];
+
+    for (int i = 0; i < GLYPH_ATLAS_COUNT; i++)
+    {
+        glyph_atlas_t *entry = &gui.atlases[i];
+        if (entry->font == font && entry->points == points
+            && entry->color_fg == color_fg && entry->color_bg == color_bg)
+        {
+            entry->last_used = ++gui.atlas_clock;
+            return entry;
+        }
+        if (entry->last_used < atlas->last_used)
+            atlas = entry;
+    }
+
+    // Recycle the least recently used atlas, its arena keeps a block for the new glyphs
+    if (!atlas->arena)
+        atlas->arena = rg_arena_create(0x1000, MEM_SLOW);
+    rg_arena_reset(atlas->arena);
+    memset(atlas->pixels, 0, sizeof(atlas->pixels));
+    memset(atlas->widths, 0xFF, sizeof(atlas->widths));
+    atlas->font = font;
+    atlas->points = points;
+    atlas->color_fg = color_fg;
+    atlas->color_bg = color_bg;
+    atlas->last_used = ++gui.atlas_clock;
+
+    return atlas;
+}
+
+static inline int atlas_glyph_width(glyph_atlas_t *atlas, uint8_t c)
+{
+    if (atlas->widths[c] == 0xFF)
+        atlas->widths[c] = get_glyph(0, atlas->font, atlas->points, c);
+    return atlas->widths[c];
+}
+
+static const uint16_t *atlas_glyph_pixels(glyph_atlas_t *atlas, uint8_t c)
+{
+    if (!atlas->pixels[c])
+    {
+        uint16_t bitmap[24] = {0};
+        int width = get_glyph(bitmap, atlas->font, atlas->points, c);
+        uint16_t *pixels = rg_arena_alloc(atlas->arena, RG_MAX(width * atlas->points, 1) * 2);
+        for (int y = 0; y < atlas->points; y++)
+            for (int x = 0; x < width; x++)
+                pixels[y * width + x] = (bitmap[y] & (1 << x)) ? atlas->color_fg : atlas->color_bg;
+        atlas->widths[c] = width;
+        atlas->pixels[c] = pixels;
+    }
+    return atlas->pixels[c];
+}
+
 bool rg_gui_set_font_type(int type)
 {
     if (type < 0)
@@ -238,7 +413,7 @@ rg_rect_t rg_gui_draw_text(int x_pos, int y_pos, int width, const char *text,
     int padding = (flags & RG_TEXT_NO_PADDING) ? 0 : 1;
     int font_height = gui.style.font_points;
     int line_height = font_height + padding * 2;
-    const rg_font_t *font = gui.style.font;
+    glyph_atlas_t *atlas = get_atlas(gui.style.font, font_height, color_fg, color_bg);
 
     if (width == 0)
     {
@@ -247,7 +422,7 @@ rg_rect_t rg_gui_draw_text(int x_pos, int y_pos, int width, const char *text,
         for (const char *ptr = text; *ptr; )
         {
             int chr = *ptr++;
-            line_width += get_glyph(0, font, font_height, chr);
+            line_width += atlas_glyph_width(atlas, chr);
 
             if (chr == '\n' || *ptr == 0)
             {
@@ -272,8 +447,11 @@ rg_rect_t rg_gui_draw_text(int x_pos, int y_pos, int width, const char *text,
     {
         int x_offset = padding;
 
-        for (size_t p = draw_width * line_height; p--; )
-            gui.draw_buffer[p] = color_bg;
+        if (!(flags & RG_TEXT_DUMMY_DRAW))
+        {
+            for (size_t p = draw_width * line_height; p--; )
+                gui.draw_buffer[p] = color_bg;
+        }
 
         if (flags & (RG_TEXT_ALIGN_LEFT|RG_TEXT_ALIGN_CENTER))
         {
@@ -281,7 +459,7 @@ rg_rect_t rg_gui_draw_text(int x_pos, int y_pos, int width, const char *text,
             const char *line = ptr;
             while (x_offset < draw_width && *line && *line != '\n')
             {
-                int width = get_glyph(0, font, font_height, *line++);
+                int width = atlas_glyph_width(atlas, *line++);
                 if (draw_width - x_offset < width) // Do not truncate glyphs
                     break;
                 x_offset += width;
@@ -294,8 +472,8 @@ rg_rect_t rg_gui_draw_text(int x_pos, int y_pos, int width, const char *text,
 
         while (x_offset < draw_width)
         {
-            uint16_t bitmap[24] = {0};
-            int width = get_glyph(bitmap, font, font_height, *ptr++);
+            uint8_t chr = *ptr++;
+            int width = atlas_glyph_width(atlas, chr);
 
             if (draw_width - x_offset < width) // Do not truncate glyphs
             {
@@ -304,14 +482,11 @@ rg_rect_t rg_gui_draw_text(int x_pos, int y_pos, int width, const char *text,
                 break;
             }
 
-            if (!(flags & RG_TEXT_DUMMY_DRAW))
+            if (!(flags & RG_TEXT_DUMMY_DRAW) && width > 0)
             {
+                const uint16_t *pixels = atlas_glyph_pixels(atlas, chr);
                 for (int y = 0; y < font_height; y++)
-                {
-                    uint16_t *output = &gui.draw_buffer[(draw_width * (y + padding)) + x_offset];
-                    for (int x = 0; x < width; x++)
-                        output[x] = (bitmap[y] & (1 << x)) ? color_fg : color_bg;
-                }
+                    memcpy(&gui.draw_buffer[(draw_width * (y + padding)) + x_offset], &pixels[y * width], width * 2);
             }
 
             x_offset += width;
@@ -429,6 +604,10 @@ void rg_gui_draw_hourglass(void)
         image_hourglass.height,
         image_hourglass.width * 2,
         (uint16_t*)image_hourglass.pixel_data);
+    // The hourglass bypasses the buffer, make sure the next flush covers it
+    mark_damage((gui.screen_width / 2) - (image_hourglass.width / 2),
+        (gui.screen_height / 2) - (image_hourglass.height / 2),
+        image_hourglass.width, image_hourglass.height, true);
 }
 
 void rg_gui_clear(rg_color_t color)
@@ -438,6 +617,7 @@ void rg_gui_clear(rg_color_t color)
         size_t pixels = gui.screen_width * gui.screen_height;
         while (pixels > 0)
             gui.screen_buffer[--pixels] = color;
+        mark_damage(0, 0, gui.screen_width, gui.screen_height, false);
     }
     else
         rg_display_clear(color);
@@ -617,6 +797,13 @@ int rg_gui_dialog(const char *title, const rg_gui_option_t *options_const, int s
     // Constrain initial cursor and skip FLAG_SKIP items
     sel = RG_MIN(RG_MAX(0, sel), options_count - 1);
 
+    // Nobody is there to answer in benchmark mode, pick the default choice
+    if (rg_system_get_app()->benchmark)
+    {
+        RG_LOGW("Dialog '%s' skipped (benchmark mode).\n", title ?: "");
+        return options_count ? options_const[sel].arg : -1;
+    }
+
     // We create a copy of options because the callbacks might modify it (ie option->value)
     rg_gui_option_t options[options_count + 1];
     char *text_buffer = calloc(2, 1024);
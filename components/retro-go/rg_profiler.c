@@ -1,70 +1,202 @@
 #include "rg_system.h"
 #include "rg_profiler.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
 
 #ifdef RG_ENABLE_PROFILING
 #include <freertos/FreeRTOS.h>
-#include <freertos/semphr.h>
+#include <freertos/task.h>
 
 // Note this profiler might be inaccurate because of:
 // https://gcc.gnu.org/bugzilla/show_bug.cgi?id=28205
 
-// We also need to add multi-core support. Currently it's not an issue
-// because all our profiled code runs on the same core.
+// Every task has its own call stack, which gives us proper recursion handling and caller/callee
+// edges. The edges themselves live in a single open-addressed hash table shared by all tasks and
+// cores. Slots are claimed with a compare-and-swap and counters are updated atomically, so there
+// is no lock anywhere in the enter/exit path.
+
+#define FRAMES_MASK (RG_PROFILER_FRAMES - 1)
+#define FRAME_BUSY  ((void *)1) // Slot claimed but its key isn't published yet
 
 static rg_profile_t *profile;
-static SemaphoreHandle_t lock;
 static bool enabled = false;
 
-#define LOCK_PROFILE()   xSemaphoreTake(lock, pdMS_TO_TICKS(10000)); // {while(lock);lock=true;}
-#define UNLOCK_PROFILE() xSemaphoreGive(lock);                       // {lock = false;}
+NO_PROFILE static inline uint32_t hash_edge(void *caller, void *callee)
+{
+    uint32_t hash = ((uintptr_t)callee >> 2) ^ ((uintptr_t)caller * 0x9E3779B1u);
+    return hash ^ (hash >> 15);
+}
 
-NO_PROFILE static inline rg_profile_frame_t *find_frame(void *this_fn, void *call_site)
+NO_PROFILE static rg_profile_frame_t *find_frame(void *caller, void *callee)
 {
-    for (int i = 0; i < 512; ++i)
+    uint32_t index = hash_edge(caller, callee) & FRAMES_MASK;
+
+    for (int probe = 0; probe < RG_PROFILER_FRAMES; ++probe, index = (index + 1) & FRAMES_MASK)
     {
-        rg_profile_frame_t *frame = &profile->frames[i];
+        rg_profile_frame_t *frame = &profile->frames[index];
+        void *func_ptr = __atomic_load_n(&frame->func_ptr, __ATOMIC_ACQUIRE);
 
-        if (frame->func_ptr == 0)
+        if (func_ptr == NULL)
         {
-            profile->total_frames = RG_MAX(profile->total_frames, i + 1);
-            frame->func_ptr = this_fn;
-            // frame->caller_ptr = call_site;
+            if (__atomic_compare_exchange_n(&frame->func_ptr, &func_ptr, FRAME_BUSY, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                frame->caller_ptr = caller;
+                __atomic_store_n(&frame->func_ptr, callee, __ATOMIC_RELEASE);
+                __atomic_fetch_add(&profile->total_frames, 1, __ATOMIC_RELAXED);
+                return frame;
+            }
         }
 
-        if (frame->func_ptr == this_fn) // && frame->caller_ptr == call_site)
+        // A slot that is still being published is simply skipped. At worst the same edge ends up
+        // in two slots, which the analyzer merges anyway. Waiting could deadlock a single core.
+        if (func_ptr == callee && frame->caller_ptr == caller)
         {
             return frame;
         }
     }
 
-    RG_PANIC("Profile memory exhausted!");
+    return NULL;
+}
+
+NO_PROFILE static rg_profile_task_t *find_task(void)
+{
+    void *handle = xTaskGetCurrentTaskHandle();
+
+    for (int i = 0; i < RG_PROFILER_TASKS; ++i)
+    {
+        rg_profile_task_t *task = &profile->tasks[i];
+        void *owner = __atomic_load_n(&task->task_handle, __ATOMIC_ACQUIRE);
+
+        if (owner == NULL && __atomic_compare_exchange_n(&task->task_handle, &owner, handle, false,
+                                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            return task;
+        }
+
+        if (owner == handle)
+        {
+            return task;
+        }
+    }
+
+    return NULL;
+}
+
+NO_PROFILE static void profile_enter(void *func_ptr)
+{
+    rg_profile_task_t *task = find_task();
+
+    // busy protects against re-entry from instrumented code that we call (rg_system_timer, etc)
+    if (!task || task->busy)
+        return;
+
+    task->busy = 1;
+
+    if (task->depth < RG_PROFILER_STACK_DEPTH)
+    {
+        task->stack[task->depth].func_ptr = func_ptr;
+        task->stack[task->depth].enter_time = rg_system_timer();
+    }
+    task->depth++;
+
+    task->busy = 0;
+}
+
+NO_PROFILE static void profile_exit(void *func_ptr)
+{
+    rg_profile_task_t *task = find_task();
+
+    if (!task || task->busy || task->depth <= 0)
+        return;
+
+    task->busy = 1;
+
+    uint32_t now = rg_system_timer();
+    int level = task->depth - 1;
+
+    if (level >= RG_PROFILER_STACK_DEPTH)
+    {
+        // This call wasn't recorded because the stack was too deep
+        task->depth--;
+        task->busy = 0;
+        return;
+    }
+
+    // Normally the function is at the top of the stack. If it isn't, then the frames above it
+    // were entered while we were disabled (or exited abnormally) and must be discarded. If the
+    // function isn't in the stack at all, it was entered while we were disabled.
+    while (level >= 0 && task->stack[level].func_ptr != func_ptr)
+        level--;
+
+    if (level >= 0)
+    {
+        rg_profile_call_t *call = &task->stack[level];
+        void *caller_ptr = level > 0 ? task->stack[level - 1].func_ptr : NULL;
+        rg_profile_frame_t *frame = find_frame(caller_ptr, func_ptr);
+        bool recursive = false;
+
+        for (int i = 0; i < level && !recursive; ++i)
+            recursive = task->stack[i].func_ptr == func_ptr;
+
+        if (frame)
+        {
+            uint32_t started = (uint32_t)profile->time_started;
+            uint32_t enter_time = (int32_t)(call->enter_time - started) < 0 ? started : call->enter_time;
+
+            __atomic_fetch_add(&frame->num_calls, 1, __ATOMIC_RELAXED);
+
+            // Inclusive time is only accounted for the outermost activation of a recursive function
+            if (!recursive)
+                __atomic_fetch_add(&frame->run_time, now - enter_time, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            __atomic_fetch_add(&profile->lost_frames, 1, __ATOMIC_RELAXED);
+        }
+
+        task->depth = level;
+    }
+
+    task->busy = 0;
 }
 
 NO_PROFILE void rg_profiler_init(void)
 {
     profile = rg_alloc(sizeof(rg_profile_t), MEM_SLOW);
-    lock = xSemaphoreCreateMutex();
     RG_LOGI("init done.\n");
 }
 
+NO_PROFILE void rg_profiler_free(void)
+{
+    enabled = false;
+    free(profile);
+    profile = NULL;
+}
+
 NO_PROFILE void rg_profiler_start(void)
 {
-    LOCK_PROFILE();
+    enabled = false;
 
-    memset(profile, 0, sizeof(rg_profile_t));
+    // Task stacks are preserved, they still describe what each task is currently running
+    memset(profile->frames, 0, sizeof(profile->frames));
+    memset(profile->sections, 0, sizeof(profile->sections));
+    profile->total_frames = 0;
+    profile->lost_frames = 0;
     profile->time_started = rg_system_timer();
-    enabled = true;
+    profile->time_stopped = 0;
 
-    UNLOCK_PROFILE();
+    enabled = true;
 }
 
 NO_PROFILE void rg_profiler_stop(void)
 {
     enabled = false;
+    if (profile)
+        profile->time_stopped = rg_system_timer();
 }
 
 NO_PROFILE void rg_profiler_print(void)
@@ -72,36 +204,67 @@ NO_PROFILE void rg_profiler_print(void)
     if (!profile)
         return;
 
-    LOCK_PROFILE();
+    int64_t time_stopped = profile->time_stopped ?: rg_system_timer();
+
+    printf("RGD:PROF:BEGIN %d %d\n", profile->total_frames, (int)(time_stopped - profile->time_started));
 
-    printf("RGD:PROF:BEGIN %d %d\n", profile->total_frames, (int)(rg_system_timer() - profile->time_started));
+    // Sections have no symbol, give the analyzer a name for their address
+    for (int i = 0; i < RG_PROFILER_SECTIONS && profile->sections[i]; ++i)
+    {
+        printf("RGD:PROF:NAME 0x%08lx %s\n", (unsigned long)(uintptr_t)profile->sections[i], profile->sections[i]);
+    }
 
-    for (int i = 0; i < profile->total_frames; ++i)
+    for (int i = 0; i < RG_PROFILER_FRAMES; ++i)
     {
         rg_profile_frame_t *frame = &profile->frames[i];
 
+        if (frame->func_ptr == NULL || frame->func_ptr == FRAME_BUSY)
+            continue;
+
         printf(
-            "RGD:PROF:DATA %p\t%p\t%u\t%u\n",
-            frame->caller_ptr,
-            frame->func_ptr,
-            frame->num_calls,
-            frame->run_time
+            "RGD:PROF:DATA 0x%08lx\t0x%08lx\t%u\t%u\n",
+            (unsigned long)(uintptr_t)frame->caller_ptr,
+            (unsigned long)(uintptr_t)frame->func_ptr,
+            (unsigned)frame->num_calls,
+            (unsigned)frame->run_time
         );
     }
 
-    printf("RGD:PROF:END\n");
+    if (profile->lost_frames)
+        RG_LOGW("%d calls were lost because the profile is full!\n", profile->lost_frames);
 
-    UNLOCK_PROFILE();
+    printf("RGD:PROF:END\n");
 }
 
 NO_PROFILE void rg_profiler_push(char *section_name)
 {
+    if (!enabled || !section_name)
+        return;
+
+    for (int i = 0; i < RG_PROFILER_SECTIONS; ++i)
+    {
+        const char *name = __atomic_load_n(&profile->sections[i], __ATOMIC_ACQUIRE);
+        if (name == NULL && __atomic_compare_exchange_n(&profile->sections[i], &name, section_name, false,
+                                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            break;
+        if (name == section_name)
+            break;
+    }
 
+    profile_enter(section_name);
 }
 
 NO_PROFILE void rg_profiler_pop(void)
 {
+    if (!enabled)
+        return;
+
+    rg_profile_task_t *task = find_task();
 
+    if (task && task->depth > 0 && task->depth <= RG_PROFILER_STACK_DEPTH)
+        profile_exit(task->stack[task->depth - 1].func_ptr);
+    else if (task && task->depth > 0)
+        task->depth--;
 }
 
 NO_PROFILE void __cyg_profile_func_enter(void *this_fn, void *call_site)
@@ -109,20 +272,7 @@ NO_PROFILE void __cyg_profile_func_enter(void *this_fn, void *call_site)
     if (!enabled)
         return;
 
-    int64_t now = rg_system_timer();
-
-    LOCK_PROFILE();
-
-    rg_profile_frame_t *fn = find_frame(this_fn, call_site);
-
-    // Recursion will need a real stack, this is absurd
-    if (fn->enter_time != 0)
-        fn->run_time += now - fn->enter_time;
-
-    fn->enter_time = rg_system_timer(); // not now, because we delayed execution
-    fn->num_calls++;
-
-    UNLOCK_PROFILE();
+    profile_enter(this_fn);
 }
 
 NO_PROFILE void __cyg_profile_func_exit(void *this_fn, void *call_site)
@@ -130,19 +280,7 @@ NO_PROFILE void __cyg_profile_func_exit(void *this_fn, void *call_site)
     if (!enabled)
         return;
 
-    int64_t now = rg_system_timer();
-
-    LOCK_PROFILE();
-
-    rg_profile_frame_t *fn = find_frame(this_fn, call_site);
-
-    // Ignore if profiler was disabled when function entered
-    if (fn->enter_time != 0)
-        fn->run_time += now - fn->enter_time;
-
-    fn->enter_time = 0;
-
-    UNLOCK_PROFILE();
+    profile_exit(this_fn);
 }
 
 #endif
@@ -3,22 +3,42 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define RG_PROFILER_FRAMES      2048 // Must be a power of two
+#define RG_PROFILER_TASKS       16
+#define RG_PROFILER_STACK_DEPTH 48
+#define RG_PROFILER_SECTIONS    32
+
 typedef struct
 {
     void *func_ptr;
     void *caller_ptr;
-    uint32_t enter_time;
     uint32_t num_calls;
     uint32_t run_time;
 } rg_profile_frame_t;
 
+typedef struct
+{
+    void *func_ptr;
+    uint32_t enter_time;
+} rg_profile_call_t;
+
+typedef struct
+{
+    void *task_handle;
+    int32_t depth;
+    int32_t busy;
+    rg_profile_call_t stack[RG_PROFILER_STACK_DEPTH];
+} rg_profile_task_t;
+
 typedef struct
 {
     int64_t time_started;
     int64_t time_stopped;
     int32_t total_frames;
-    int32_t locked;
-    rg_profile_frame_t frames[512];
+    int32_t lost_frames;
+    const char *sections[RG_PROFILER_SECTIONS];
+    rg_profile_task_t tasks[RG_PROFILER_TASKS];
+    rg_profile_frame_t frames[RG_PROFILER_FRAMES];
 } rg_profile_t;
 
 #ifdef __cplusplus
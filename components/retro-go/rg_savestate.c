@@ -0,0 +1,562 @@
+#include "rg_system.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Save states are written by the emulators into memory (rg_savestate_fopen) and stored as a header
+// followed by fixed size chunks. A chunk is either all zeroes, identical to the base state, LZ
+// compressed (possibly as a XOR delta against the base state) or raw.
+// The base state is the first state saved for a given ROM. It is never overwritten, the launcher
+// deletes it along with the last slot. If it's missing while other states exist, or if it can't be
+// loaded, states are saved in full. It is only held in memory while a state is (un)packed.
+// If the emulator can't buffer its state in memory, the state is written again directly to the file.
+
+#if defined(__MINGW32__) || defined(__MINGW64__)
+#define NO_MEMSTREAM // States are written raw, containers can still be loaded through a tmpfile
+#endif
+
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_WORK_SIZE (RG_SAVESTATE_CHUNK_SIZE * 2 + (sizeof(uint16_t) << LZ_HASH_BITS))
+
+enum
+{
+    CHUNK_ZERO,
+    CHUNK_BASE,
+    CHUNK_RAW,
+    CHUNK_LZ,
+    CHUNK_LZ_DELTA,
+};
+
+typedef struct
+{
+    uint16_t type;
+    uint16_t length;
+} chunk_header_t;
+
+static struct
+{
+    char path[RG_PATH_MAX + 8];
+    bool active;
+    bool saving;
+    bool used; // The emulator went through rg_savestate_fopen
+    char *buffer;
+    size_t size;
+    int64_t core_start;
+} session;
+
+static struct
+{
+    uint8_t *data;
+    size_t size;
+    uint32_t crc;
+} base;
+
+static rg_savestate_stats_t stats;
+static bool unbuffered; // A state didn't fit in memory, the following ones are written directly
+
+
+static inline uint32_t read32(const uint8_t *ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, 4);
+    return value;
+}
+
+static uint8_t *lz_put_length(uint8_t *op, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *op++ = 255;
+    *op++ = length;
+    return op;
+}
+
+static bool lz_get_length(const uint8_t **ip, const uint8_t *end, size_t *length)
+{
+    uint8_t byte;
+    do
+    {
+        if (*ip >= end)
+            return false;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// LZ4-like block format: token (literals:4, match:4), literals, 16bit offset, extra lengths as 255 runs.
+// Returns 0 if the result wouldn't fit in capacity.
+static size_t lz_compress(const uint8_t *src, size_t length, uint8_t *dst, size_t capacity, uint16_t *table)
+{
+    const uint8_t *ip = src, *anchor = src, *end = src + length;
+    uint8_t *op = dst, *op_end = dst + capacity;
+
+    memset(table, 0xFF, sizeof(uint16_t) << LZ_HASH_BITS);
+
+    while (ip + LZ_MIN_MATCH <= end)
+    {
+        uint32_t sequence = read32(ip);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t ref = table[hash];
+        table[hash] = ip - src;
+
+        if (ref == 0xFFFF || read32(src + ref) != sequence)
+        {
+            ip++;
+            continue;
+        }
+
+        size_t literals = ip - anchor;
+        size_t match = LZ_MIN_MATCH;
+        while (ip + match < end && src[ref + match] == ip[match])
+            match++;
+
+        if (op + literals + literals / 255 + match / 255 + 5 > op_end)
+            return 0;
+
+        *op++ = (RG_MIN(literals, 15) << 4) | RG_MIN(match - LZ_MIN_MATCH, 15);
+        if (literals >= 15)
+            op = lz_put_length(op, literals - 15);
+        memcpy(op, anchor, literals);
+        op += literals;
+        *op++ = ((ip - src) - ref) & 0xFF;
+        *op++ = ((ip - src) - ref) >> 8;
+        if (match - LZ_MIN_MATCH >= 15)
+            op = lz_put_length(op, match - LZ_MIN_MATCH - 15);
+
+        ip += match;
+        anchor = ip;
+    }
+
+    // The last sequence is literals only
+    size_t literals = end - anchor;
+    if (op + literals + literals / 255 + 2 > op_end)
+        return 0;
+    *op++ = RG_MIN(literals, 15) << 4;
+    if (literals >= 15)
+        op = lz_put_length(op, literals - 15);
+    memcpy(op, anchor, literals);
+    op += literals;
+
+    return op - dst;
+}
+
+static size_t lz_decompress(const uint8_t *src, size_t length, uint8_t *dst, size_t capacity)
+{
+    const uint8_t *ip = src, *end = src + length;
+    uint8_t *op = dst, *op_end = dst + capacity;
+
+    while (ip < end)
+    {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        size_t match = token & 15;
+
+        if (literals == 15 && !lz_get_length(&ip, end, &literals))
+            return 0;
+        if (literals > (size_t)(end - ip) || literals > (size_t)(op_end - op))
+            return 0;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        if (ip >= end)
+            break;
+
+        if (end - ip < 2)
+            return 0;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (match == 15 && !lz_get_length(&ip, end, &match))
+            return 0;
+        match += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(op - dst) || match > (size_t)(op_end - op))
+            return 0;
+        // Byte by byte because the source and destination can overlap
+        for (const uint8_t *ref = op - offset; match > 0; match--)
+            *op++ = *ref++;
+    }
+
+    return op - dst;
+}
+
+static bool pack_state(const char *path, const uint8_t *data, size_t size, bool use_base)
+{
+    rg_savestate_header_t header = {
+        .magic = RG_SAVESTATE_MAGIC,
+        .flags = use_base ? RG_SAVESTATE_DELTA : 0,
+        .raw_size = size,
+        .raw_crc = rg_crc32(0, data, size),
+        .base_crc = use_base ? base.crc : 0,
+        .chunk_size = RG_SAVESTATE_CHUNK_SIZE,
+    };
+    uint8_t *work = malloc(LZ_WORK_SIZE);
+    uint8_t *delta = work, *packed = work + RG_SAVESTATE_CHUNK_SIZE;
+    uint16_t *table = (uint16_t *)(work + RG_SAVESTATE_CHUNK_SIZE * 2);
+    int64_t pack_time = 0;
+
+    FILE *fp = work ? fopen(path, "wb") : NULL;
+    bool success = fp && fwrite(&header, sizeof(header), 1, fp) == 1;
+    size_t total = sizeof(header);
+
+    for (size_t pos = 0; success && pos < size; pos += RG_SAVESTATE_CHUNK_SIZE)
+    {
+        int64_t start = rg_system_timer();
+        size_t length = RG_MIN(size - pos, RG_SAVESTATE_CHUNK_SIZE);
+        const uint8_t *chunk = data + pos;
+        const uint8_t *ref = (use_base && pos + length <= base.size) ? base.data + pos : NULL;
+        chunk_header_t chunk_header = {CHUNK_RAW, length};
+        const uint8_t *payload = chunk;
+        size_t same = 0;
+
+        if (ref)
+        {
+            for (size_t i = 0; i < length; ++i)
+                same += chunk[i] == ref[i];
+        }
+
+        if (chunk[0] == 0 && memcmp(chunk, chunk + 1, length - 1) == 0)
+        {
+            chunk_header = (chunk_header_t){CHUNK_ZERO, 0};
+        }
+        else if (ref && same == length)
+        {
+            chunk_header = (chunk_header_t){CHUNK_BASE, 0};
+        }
+        else
+        {
+            // A delta only pays off when most of the chunk didn't change
+            bool use_delta = ref && same * 2 >= length;
+            if (use_delta)
+            {
+                for (size_t i = 0; i < length; ++i)
+                    delta[i] = chunk[i] ^ ref[i];
+            }
+            size_t packed_len = lz_compress(use_delta ? delta : chunk, length, packed, length - 1, table);
+            if (packed_len > 0)
+            {
+                chunk_header = (chunk_header_t){use_delta ? CHUNK_LZ_DELTA : CHUNK_LZ, packed_len};
+                payload = packed;
+            }
+        }
+        pack_time += rg_system_timer() - start;
+
+        success = fwrite(&chunk_header, sizeof(chunk_header), 1, fp) == 1;
+        if (success && chunk_header.length)
+            success = fwrite(payload, chunk_header.length, 1, fp) == 1;
+        total += sizeof(chunk_header) + chunk_header.length;
+    }
+
+    if (fp && fclose(fp) != 0)
+        success = false;
+    free(work);
+
+    stats.packed_size = total;
+    stats.pack_time = pack_time / 1000;
+
+    return success;
+}
+
+// On success *data is NULL if the file isn't a container (states from older versions)
+static bool unpack_state(const char *path, uint8_t **data, size_t *size)
+{
+    rg_savestate_header_t header;
+    rg_file_view_t *view;
+    uint8_t *output = NULL;
+    bool success = false;
+
+    *data = NULL;
+    *size = 0;
+
+    if (!(view = rg_storage_view_open(path)))
+        return false;
+
+    if (rg_storage_view_read(view, 0, &header, sizeof(header)) != sizeof(header)
+        || header.magic != RG_SAVESTATE_MAGIC)
+    {
+        rg_storage_view_close(view);
+        return true;
+    }
+
+    int64_t start = rg_system_timer();
+    const uint8_t *src = rg_storage_view_data(view, MEM_ANY);
+    const uint8_t *src_end = src + view->size;
+    stats.io_time = (rg_system_timer() - start) / 1000;
+    stats.packed_size = view->size;
+    start = rg_system_timer();
+
+    if (!src || header.chunk_size != RG_SAVESTATE_CHUNK_SIZE)
+    {
+        RG_LOGE("Unsupported state file.\n");
+        goto done;
+    }
+
+    if ((header.flags & RG_SAVESTATE_DELTA) && (!base.data || base.crc != header.base_crc))
+    {
+        RG_LOGE("The base state this state depends on is missing or has changed!\n");
+        goto done;
+    }
+
+    if (!(output = malloc(RG_MAX(header.raw_size, 1))))
+    {
+        RG_LOGE("Out of memory!\n");
+        goto done;
+    }
+
+    src += sizeof(header);
+
+    for (size_t pos = 0; pos < header.raw_size; pos += RG_SAVESTATE_CHUNK_SIZE)
+    {
+        size_t length = RG_MIN(header.raw_size - pos, RG_SAVESTATE_CHUNK_SIZE);
+        const uint8_t *ref = pos + length <= base.size ? base.data + pos : NULL;
+        uint8_t *chunk = output + pos;
+        chunk_header_t chunk_header;
+
+        if (src + sizeof(chunk_header) > src_end)
+            goto corrupted;
+        memcpy(&chunk_header, src, sizeof(chunk_header));
+        src += sizeof(chunk_header);
+        if (chunk_header.length > (size_t)(src_end - src))
+            goto corrupted;
+
+        switch (chunk_header.type)
+        {
+        case CHUNK_ZERO:
+            memset(chunk, 0, length);
+            break;
+        case CHUNK_BASE:
+            if (!ref)
+                goto corrupted;
+            memcpy(chunk, ref, length);
+            break;
+        case CHUNK_RAW:
+            if (chunk_header.length != length)
+                goto corrupted;
+            memcpy(chunk, src, length);
+            break;
+        case CHUNK_LZ:
+        case CHUNK_LZ_DELTA:
+            if (lz_decompress(src, chunk_header.length, chunk, length) != length)
+                goto corrupted;
+            if (chunk_header.type == CHUNK_LZ_DELTA)
+            {
+                if (!ref)
+                    goto corrupted;
+                for (size_t i = 0; i < length; ++i)
+                    chunk[i] ^= ref[i];
+            }
+            break;
+        default:
+            goto corrupted;
+        }
+        src += chunk_header.length;
+    }
+
+    if (rg_crc32(0, output, header.raw_size) != header.raw_crc)
+        goto corrupted;
+
+    *data = output;
+    *size = header.raw_size;
+    success = true;
+    goto done;
+
+corrupted:
+    RG_LOGE("State file is corrupted!\n");
+    free(output);
+
+done:
+    stats.pack_time = (rg_system_timer() - start) / 1000;
+    rg_storage_view_close(view);
+    return success;
+}
+
+static char *get_base_path(void)
+{
+    return rg_emu_get_path(RG_PATH_SAVE_STATE + RG_SAVESTATE_BASE_SLOT, rg_system_get_app()->romPath);
+}
+
+// Returns false if a base exists but can't be loaded (corrupted, out of memory)
+static bool load_base(void)
+{
+    char *path = get_base_path();
+    bool success = true;
+    uint8_t *data;
+    size_t size;
+
+    // The base is always a standalone container
+    if (access(path, F_OK) == 0)
+    {
+        if ((success = unpack_state(path, &data, &size) && data))
+        {
+            base.data = data;
+            base.size = size;
+            base.crc = rg_crc32(0, data, size);
+            RG_LOGI("Base state loaded (size=%d).\n", (int)size);
+        }
+        else
+        {
+            RG_LOGW("Unable to load base state, states won't use deltas.\n");
+        }
+    }
+
+    free(path);
+    return success;
+}
+
+static void free_base(void)
+{
+    free(base.data);
+    memset(&base, 0, sizeof(base));
+}
+
+// Other states may be deltas of a base that was lost, a new base mustn't be created under them
+static bool other_states_exist(void)
+{
+    rg_emu_state_t *states = rg_emu_get_states(rg_system_get_app()->romPath, 4);
+    bool found = !states; // Assume the worst
+
+    for (size_t i = 0; states && i < states->total; ++i)
+    {
+        const char *file = states->slots[i].file;
+        if (states->slots[i].exists && strncmp(session.path, file, strlen(file)) != 0)
+            found = true;
+    }
+
+    free(states);
+    return found;
+}
+
+static void create_base(const uint8_t *data, size_t size)
+{
+    char *path = get_base_path();
+
+    if ((base.data = malloc(size)))
+    {
+        memcpy(base.data, data, size);
+        base.size = size;
+        base.crc = rg_crc32(0, data, size);
+
+        if (!pack_state(path, data, size, false))
+        {
+            RG_LOGW("Unable to write base state, states won't use deltas.\n");
+            unlink(path);
+            free(base.data);
+            base.data = NULL;
+            base.size = 0;
+        }
+    }
+
+    free(path);
+}
+
+bool rg_savestate_begin(const char *path, bool saving)
+{
+    RG_ASSERT(path, "Bad param");
+
+    free(session.buffer);
+    memset(&session, 0, sizeof(session));
+    memset(&stats, 0, sizeof(stats));
+
+    if (!saving)
+    {
+        load_base();
+        bool unpacked = unpack_state(path, (uint8_t **)&session.buffer, &session.size);
+        free_base();
+        if (!unpacked)
+            return false;
+    }
+
+    snprintf(session.path, sizeof(session.path), "%s", path);
+    session.saving = saving;
+    session.active = true;
+    session.core_start = rg_system_timer();
+
+    return true;
+}
+
+bool rg_savestate_end(bool success)
+{
+    if (!session.active)
+        return false;
+
+    stats.core_time = (rg_system_timer() - session.core_start) / 1000;
+
+    if (session.saving && session.used && success)
+    {
+        int64_t start = rg_system_timer();
+
+        // The very first state of a ROM becomes the base for all the others
+        if (load_base() && !base.data && !other_states_exist())
+            create_base((uint8_t *)session.buffer, session.size);
+
+        if (!pack_state(session.path, (uint8_t *)session.buffer, session.size, base.data != NULL))
+        {
+            RG_LOGW("Packing failed, falling back to a raw state.\n");
+            success = rg_storage_write_file(session.path, session.buffer, session.size);
+        }
+
+        free_base();
+
+        stats.io_time = (rg_system_timer() - start) / 1000 - stats.pack_time;
+    }
+
+    else if (session.saving && session.used)
+    {
+        // Most likely the buffer couldn't grow, the caller can retry without it
+        RG_LOGW("Buffered save failed, the next states will be written directly.\n");
+        unbuffered = true;
+    }
+
+    stats.raw_size = session.size;
+    stats.buffered = session.used;
+
+    if (session.saving)
+        RG_LOGI("State saved: %d => %d bytes, core %dms, pack %dms, write %dms.\n", (int)stats.raw_size,
+                (int)stats.packed_size, stats.core_time, stats.pack_time, stats.io_time);
+    else
+        RG_LOGI("State loaded: %d => %d bytes, read %dms, unpack %dms, core %dms.\n", (int)stats.packed_size,
+                (int)stats.raw_size, stats.io_time, stats.pack_time, stats.core_time);
+
+    free(session.buffer);
+    memset(&session, 0, sizeof(session));
+
+    return success;
+}
+
+FILE *rg_savestate_fopen(const char *path, const char *mode)
+{
+    if (!session.active || strcmp(path, session.path) != 0)
+        return fopen(path, mode);
+
+    if (session.saving)
+    {
+    #ifndef NO_MEMSTREAM
+        FILE *fp = unbuffered ? NULL : open_memstream(&session.buffer, &session.size);
+        if (fp)
+        {
+            session.used = true;
+            return fp;
+        }
+    #endif
+        return fopen(path, mode);
+    }
+
+    // Older states aren't containers and are read directly
+    if (!session.buffer)
+        return fopen(path, mode);
+
+#ifdef NO_MEMSTREAM
+    FILE *fp = tmpfile();
+    if (fp && fwrite(session.buffer, session.size, 1, fp) == 1)
+        rewind(fp);
+    return fp;
+#else
+    return fmemopen(session.buffer, session.size, "rb");
+#endif
+}
+
+rg_savestate_stats_t rg_savestate_get_stats(void)
+{
+    return stats;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define RG_SAVESTATE_MAGIC      0x31534752 // "RGS1"
+#define RG_SAVESTATE_CHUNK_SIZE 0x4000
+#define RG_SAVESTATE_DELTA      0x01       // Chunks may refer to the base state
+#define RG_SAVESTATE_BASE_SLOT  0xFE       // Hidden slot holding the base state
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t flags;
+    uint32_t raw_size;
+    uint32_t raw_crc;
+    uint32_t base_crc;
+    uint32_t chunk_size;
+    uint32_t reserved[2];
+} rg_savestate_header_t;
+
+typedef struct
+{
+    size_t raw_size;
+    size_t packed_size;
+    int core_time;  // Time spent in the emulator's handler (ms)
+    int pack_time;  // Time spent (de)compressing (ms)
+    int io_time;    // Time spent reading or writing the file (ms)
+    bool buffered;  // The state went through memory (rg_savestate_fopen)
+} rg_savestate_stats_t;
+
+bool rg_savestate_begin(const char *path, bool saving);
+bool rg_savestate_end(bool success);
+FILE *rg_savestate_fopen(const char *path, const char *mode);
+rg_savestate_stats_t rg_savestate_get_stats(void);
@@ -16,6 +16,9 @@
 
 #if defined(__MINGW32__) || defined(__MINGW64__)
 #define mkdir(A, B) mkdir(A)
+#elif defined(RG_TARGET_SDL2)
+#include <sys/mman.h>
+#define USE_MMAP
 #endif
 
 static bool disk_mounted = false;
@@ -285,8 +288,16 @@ rg_scandir_t *rg_storage_scandir(const char *path, bool (*validator)(const char
     if (!dir)
         return NULL;
 
-    rg_scandir_t *results = malloc(4096 * sizeof(rg_scandir_t));
+    size_t capacity = 64;
+    rg_scandir_t *results = malloc(capacity * sizeof(rg_scandir_t));
     size_t count = 0;
+
+    if (!results)
+    {
+        RG_LOGE("Not enough memory to scan '%s'!\n", path);
+        closedir(dir);
+        return NULL;
+    }
     struct dirent *ent;
 
     char fullpath[RG_PATH_MAX] = {0};
@@ -302,15 +313,16 @@ rg_scandir_t *rg_storage_scandir(const char *path, bool (*validator)(const char
         if (validator && !validator(fullpath))
             continue;
 
-        if ((count % 20) == 0)
+        if (count + 1 >= capacity) // Keep room for the terminator
         {
-            void *temp = realloc(results, (count + 21) * sizeof(rg_scandir_t));
+            void *temp = realloc(results, capacity * 2 * sizeof(rg_scandir_t));
             if (!temp)
             {
                 RG_LOGW("Not enough memory to finish scan!\n");
                 break;
             }
             results = temp;
+            capacity *= 2;
         }
 
         rg_scandir_t *result = &results[count++];
@@ -329,10 +341,243 @@ rg_scandir_t *rg_storage_scandir(const char *path, bool (*validator)(const char
         #endif
     }
     memset(&results[count], 0, sizeof(rg_scandir_t));
+    closedir(dir);
 
     return results;
 }
 
+int rg_storage_count_entries(const char *path)
+{
+    DIR* dir = opendir(path);
+    if (!dir)
+        return -1;
+
+    struct dirent *ent;
+    int count = 0;
+
+    // Same rule as rg_storage_scandir: hidden files aren't counted
+    while ((ent = readdir(dir)))
+    {
+        if (ent->d_name[0] != '.')
+            count++;
+    }
+    closedir(dir);
+
+    return count;
+}
+
+bool rg_storage_read_file(const char *path, void **data_ptr, size_t *data_len)
+{
+    RG_ASSERT(data_ptr && data_len, "Bad param");
+
+    rg_file_view_t *view = rg_storage_view_open(path);
+    if (!view)
+        return false;
+
+    void *data = malloc(RG_MAX(view->size, 1));
+    size_t size = view->size;
+
+    if (data && rg_storage_view_read(view, 0, data, size) != size)
+    {
+        free(data);
+        data = NULL;
+    }
+    rg_storage_view_close(view);
+
+    if (!data)
+        return false;
+
+    *data_ptr = data;
+    *data_len = size;
+    return true;
+}
+
+bool rg_storage_write_file(const char *path, const void *data_ptr, const size_t data_len)
+{
+    RG_ASSERT(path && (data_ptr || data_len == 0), "Bad param");
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return false;
+
+    bool success = data_len == 0 || fwrite(data_ptr, data_len, 1, fp) == 1;
+    if (fclose(fp) != 0)
+        success = false;
+
+    return success;
+}
+
+rg_file_view_t *rg_storage_view_open(const char *path)
+{
+    RG_ASSERT(path, "Bad param");
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        RG_LOGE("Unable to open '%s'\n", path);
+        return NULL;
+    }
+
+    rg_file_view_t *view = calloc(1, sizeof(rg_file_view_t));
+    if (!view)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    view->size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    view->fp = fp;
+
+#ifdef USE_MMAP
+    if (view->size > 0)
+    {
+        // The mapping is private: cores that patch their ROM in place (decryption, byte swapping)
+        // get copy-on-write pages and the file itself is never modified.
+        void *data = mmap(NULL, view->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(fp), 0);
+        if (data != MAP_FAILED)
+        {
+            view->data = data;
+            view->mapped = true;
+            view->fp = NULL;
+            fclose(fp);
+        }
+        else
+        {
+            RG_LOGW("mmap failed (errno=%d), falling back to reads.\n", errno);
+        }
+    }
+#endif
+
+    RG_LOGI("Opened '%s' (size=%d, mapped=%d)\n", path, (int)view->size, view->mapped);
+
+    return view;
+}
+
+static uint8_t *view_get_chunk(rg_file_view_t *view, size_t offset)
+{
+    int victim = 0;
+
+    for (int i = 0; i < RG_STORAGE_VIEW_CHUNKS; ++i)
+    {
+        if (view->chunks[i].length && view->chunks[i].offset == offset)
+        {
+            view->chunks[i].used = ++view->clock;
+            return view->cache + i * RG_STORAGE_VIEW_CHUNK_SIZE;
+        }
+        if (view->chunks[i].used < view->chunks[victim].used)
+            victim = i;
+    }
+
+    if (!view->cache && !(view->cache = malloc(RG_STORAGE_VIEW_CHUNKS * RG_STORAGE_VIEW_CHUNK_SIZE)))
+        return NULL;
+
+    uint8_t *buffer = view->cache + victim * RG_STORAGE_VIEW_CHUNK_SIZE;
+    size_t length = RG_MIN(view->size - offset, RG_STORAGE_VIEW_CHUNK_SIZE);
+
+    view->chunks[victim].length = 0;
+
+    if (fseek(view->fp, offset, SEEK_SET) != 0 || fread(buffer, length, 1, view->fp) != 1)
+    {
+        RG_LOGE("Read error at offset %d\n", (int)offset);
+        clearerr(view->fp);
+        return NULL;
+    }
+
+    view->chunks[victim].offset = offset;
+    view->chunks[victim].length = length;
+    view->chunks[victim].used = ++view->clock;
+
+    return buffer;
+}
+
+size_t rg_storage_view_read(rg_file_view_t *view, size_t offset, void *dest, size_t length)
+{
+    RG_ASSERT(view && dest, "Bad param");
+
+    if (offset >= view->size)
+        return 0;
+
+    length = RG_MIN(length, view->size - offset);
+
+    if (view->data)
+    {
+        memcpy(dest, view->data + offset, length);
+        return length;
+    }
+
+    // Large reads gain nothing from the cache and would only evict the small hot chunks
+    if (length >= RG_STORAGE_VIEW_CHUNK_SIZE)
+    {
+        if (fseek(view->fp, offset, SEEK_SET) != 0)
+            return 0;
+        size_t done = fread(dest, 1, length, view->fp);
+        clearerr(view->fp);
+        return done;
+    }
+
+    size_t done = 0;
+
+    while (done < length)
+    {
+        size_t pos = offset + done;
+        size_t chunk_pos = pos % RG_STORAGE_VIEW_CHUNK_SIZE;
+        uint8_t *chunk = view_get_chunk(view, pos - chunk_pos);
+        if (!chunk)
+            break;
+        size_t count = RG_MIN(length - done, RG_STORAGE_VIEW_CHUNK_SIZE - chunk_pos);
+        memcpy((uint8_t *)dest + done, chunk + chunk_pos, count);
+        done += count;
+    }
+
+    return done;
+}
+
+void *rg_storage_view_data(rg_file_view_t *view, uint32_t caps)
+{
+    RG_ASSERT(view, "Bad param");
+
+    if (view->data)
+        return view->data;
+
+    uint8_t *data = rg_alloc(RG_MAX(view->size, 1), caps);
+    if (rg_storage_view_read(view, 0, data, view->size) != view->size)
+    {
+        RG_LOGE("Failed to load file (size=%d)\n", (int)view->size);
+        free(data);
+        return NULL;
+    }
+
+    // Everything is in memory now, the handle and the chunk cache are no longer needed
+    fclose(view->fp);
+    view->fp = NULL;
+    free(view->cache);
+    view->cache = NULL;
+    view->data = data;
+
+    return data;
+}
+
+void rg_storage_view_close(rg_file_view_t *view)
+{
+    if (!view)
+        return;
+
+#ifdef USE_MMAP
+    if (view->mapped)
+        munmap(view->data, view->size);
+    else
+#endif
+        free(view->data);
+
+    if (view->fp)
+        fclose(view->fp);
+
+    free(view->cache);
+    free(view);
+}
+
 const char *rg_dirname(const char *path)
 {
     static char buffer[100];
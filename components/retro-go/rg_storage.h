@@ -22,6 +22,28 @@ typedef struct __attribute__((packed))
     char name[63];
 } rg_scandir_t;
 
+#define RG_STORAGE_VIEW_CHUNKS     4
+#define RG_STORAGE_VIEW_CHUNK_SIZE 0x1000
+
+// Read-only view of a file. On SDL2 the file is mapped and `data` is always available, on the
+// ESP32 reads go through a small chunk cache unless the file is loaded with rg_storage_view_data.
+// A view isn't thread-safe, the caller must serialize accesses.
+typedef struct
+{
+    uint8_t *data; // The whole file when it is mapped or loaded, NULL otherwise
+    size_t size;
+    // Private
+    void *fp;
+    bool mapped;
+    uint8_t *cache;
+    uint32_t clock;
+    struct {
+        size_t offset;
+        size_t length;
+        uint32_t used;
+    } chunks[RG_STORAGE_VIEW_CHUNKS];
+} rg_file_view_t;
+
 void rg_storage_init(void);
 void rg_storage_deinit(void);
 bool rg_storage_format(void);
@@ -34,6 +56,12 @@ bool rg_storage_write_file(const char *path, const void *data_ptr, const size_t
 bool rg_storage_delete(const char *path);
 bool rg_storage_mkdir(const char *dir);
 rg_scandir_t *rg_storage_scandir(const char *path, bool (*validator)(const char *path));
+int rg_storage_count_entries(const char *path); // Cheaper than a scandir, returns -1 on error
+
+rg_file_view_t *rg_storage_view_open(const char *path);
+size_t rg_storage_view_read(rg_file_view_t *view, size_t offset, void *dest, size_t length);
+void *rg_storage_view_data(rg_file_view_t *view, uint32_t caps);
+void rg_storage_view_close(rg_file_view_t *view);
 
 const char *rg_dirname(const char *path);
 const char *rg_basename(const char *path);
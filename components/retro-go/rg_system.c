@@ -39,6 +39,11 @@ typedef struct
 #define logbuf_putc(buf, c) (buf)->buffer[(buf)->cursor++] = c, (buf)->cursor %= RG_LOGBUF_SIZE;
 #define logbuf_puts(buf, str) for (const char *ptr = str; *ptr; ptr++) logbuf_putc(buf, *ptr);
 
+#define BENCHMARK_DEFAULT_FRAMES 1800
+
+#define PACING_MAX_SKIP     3  // Consecutive frames that can be skipped at 1x speed
+#define PACING_AUDIO_TARGET 25 // Audio we try to keep queued, in percent of a frame
+
 #define WDT_TIMEOUT 10000000
 #define WDT_RELOAD(val) wdtCounter = (val)
 
@@ -64,12 +69,33 @@ typedef struct
     char name[20];
 } rg_task_t;
 
+typedef struct
+{
+    int64_t startTime;
+    int64_t busyTime;
+    rg_display_counters_t display;
+    rg_audio_counters_t audio;
+    int frames;
+} benchmark_t;
+
+typedef struct
+{
+    int64_t lastTick;
+    int64_t displayBusyTime;
+    int lag;     // How far behind real time we are (us), frames are skipped while it's positive
+    int skipped; // Consecutive frames skipped so far
+    int forced;  // Frames the app asked us to skip
+    bool draw;   // Decision for the next frame
+} pacing_t;
+
 // The trace will survive a software reset
 static RTC_NOINIT_ATTR panic_trace_t panicTrace;
 static rg_stats_t statistics;
 static rg_app_t app;
 static logbuf_t logbuf;
 static rg_task_t tasks[8];
+static benchmark_t benchmark;
+static pacing_t pacing = {.draw = true};
 static int ledValue = -1;
 static int wdtCounter = 0;
 static bool exitCalled = false;
@@ -259,6 +285,41 @@ static void system_monitor_task(void *arg)
     rg_task_delete(NULL);
 }
 
+static void benchmark_begin(int busyTime)
+{
+    benchmark.startTime = rg_system_timer() - busyTime;
+    benchmark.busyTime = statistics.busyTime;
+    benchmark.display = rg_display_get_counters();
+    benchmark.audio = rg_audio_get_counters();
+    benchmark.frames = app.benchmark;
+    RG_LOGI("Benchmark started: %d frames.\n", benchmark.frames);
+}
+
+static void benchmark_end(void)
+{
+    rg_display_counters_t display = rg_display_get_counters();
+    rg_audio_counters_t audio = rg_audio_get_counters();
+    int64_t totalTime = rg_system_timer() - benchmark.startTime;
+    int64_t busyTime = statistics.busyTime - benchmark.busyTime;
+    int64_t videoTime = display.busyTime - benchmark.display.busyTime;
+    int64_t audioTime = audio.busyTime - benchmark.audio.busyTime;
+
+    // One line, key=value pairs, so that it is trivial to grep and parse from a script
+    printf("RGD:BENCH:RESULT app=%s rom=%s frames=%d drawn=%d full=%d total_us=%lld emu_us=%lld "
+           "video_us=%lld audio_us=%lld samples=%d fps=%.2f\n",
+           app.name, rg_basename(app.romPath ?: "-"), benchmark.frames,
+           (int)(display.totalFrames - benchmark.display.totalFrames),
+           (int)(display.fullFrames - benchmark.display.fullFrames),
+           (long long)totalTime, (long long)busyTime, (long long)videoTime, (long long)audioTime,
+           (int)(audio.samples - benchmark.audio.samples),
+           benchmark.frames / (RG_MAX(totalTime, 1) / 1000000.f));
+    fflush(stdout);
+
+    // Back to the launcher through the normal path, so that settings and storage are flushed
+    rg_system_set_boot_app(RG_APP_LAUNCHER);
+    rg_system_restart();
+}
+
 static void enter_recovery_mode(void)
 {
     RG_LOGW("Entering recovery mode...\n");
@@ -364,6 +425,22 @@ rg_app_t *rg_system_init(int sampleRate, const rg_handlers_t *handlers, const rg
         app.romPath = app.bootArgs;
     }
 
+    // Benchmark mode can be requested through the boot flags or, mostly useful on the SDL2
+    // target, through the environment: RG_BENCHMARK=<frames> [RG_BENCHMARK_ROM=<path>]
+    const char *benchmarkEnv = getenv("RG_BENCHMARK");
+    if (benchmarkEnv || (app.bootFlags & RG_BOOT_BENCHMARK))
+    {
+        const char *romPath = getenv("RG_BENCHMARK_ROM");
+        app.benchmark = benchmarkEnv ? atoi(benchmarkEnv) : 0;
+        if (app.benchmark <= 0)
+            app.benchmark = BENCHMARK_DEFAULT_FRAMES;
+        if (romPath)
+            app.romPath = romPath;
+        // Always start from power on, resuming a state would make runs impossible to compare
+        app.bootFlags &= ~RG_BOOT_RESUME;
+        RG_LOGW("Benchmark mode enabled: %d frames, headless.\n", app.benchmark);
+    }
+
     rg_input_init(); // Must be first for the qtpy (input -> aw9523 -> lcd)
     rg_display_init();
     rg_gui_init();
@@ -494,11 +571,79 @@ rg_stats_t rg_system_get_counters(void)
     return statistics;
 }
 
+static void update_pacing(void)
+{
+    int frameTime = 1000000 / (app.refreshRate * app.speed);
+    int maxSkip = PACING_MAX_SKIP * app.speed;
+    int64_t now = rg_system_timer();
+    int64_t displayBusyTime = rg_display_get_counters().busyTime;
+    int displayWait = displayBusyTime - pacing.displayBusyTime;
+    int wallTime = pacing.lastTick ? now - pacing.lastTick : frameTime;
+
+    pacing.lastTick = now;
+    pacing.displayBusyTime = displayBusyTime;
+
+    // Everything the main task did since the last tick counts, including waiting on the audio
+    // device when we're ahead. Drawn frames typically cost more than a frame and skipped ones
+    // less, carrying the difference over spreads the skipping evenly. A little credit is kept to
+    // absorb jitter and a little debt to recover from stalls (menus, storage) without a burst.
+    pacing.lag = RG_MIN(RG_MAX(pacing.lag + wallTime - frameTime, -frameTime), frameTime * 2);
+
+    // The audio buffer running low means we're behind whatever our accounting says. It only tells
+    // something while the app is actually submitting audio.
+    int audioQueued = rg_audio_get_queued_time();
+    if (audioQueued >= 0 && audioQueued < frameTime * PACING_AUDIO_TARGET / 100)
+        pacing.lag = RG_MAX(pacing.lag, 1);
+
+    // Presenting blocked on the display queue, another frame right away would just block again
+    if (displayWait > frameTime / 2)
+        pacing.lag = RG_MAX(pacing.lag, 1);
+
+    if (pacing.forced > 0)
+    {
+        pacing.forced--;
+        pacing.draw = false;
+    }
+    else
+    {
+        pacing.draw = app.benchmark || pacing.lag <= 0 || pacing.skipped >= maxSkip;
+    }
+
+    pacing.skipped = pacing.draw ? 0 : pacing.skipped + 1;
+}
+
 IRAM_ATTR void rg_system_tick(int busyTime)
 {
+    if (app.benchmark && benchmark.frames == 0)
+        benchmark_begin(busyTime);
+
     statistics.busyTime += busyTime;
     statistics.ticks++;
     // WDT_RELOAD(WDT_TIMEOUT);
+
+    update_pacing();
+
+    if (app.benchmark && --app.benchmark == 0)
+        benchmark_end();
+}
+
+bool rg_system_should_draw(void)
+{
+    return pacing.draw;
+}
+
+void rg_system_skip_frames(int count)
+{
+    if (count > 0)
+    {
+        pacing.forced = RG_MAX(pacing.forced, count - 1);
+        pacing.draw = false;
+    }
+    else
+    {
+        pacing.forced = 0;
+        pacing.draw = true;
+    }
 }
 
 IRAM_ATTR int64_t rg_system_timer(void)
@@ -604,7 +749,13 @@ bool rg_emu_load_state(uint8_t slot)
 
     rg_gui_draw_hourglass();
 
-    if (!(success = (*app.handlers.loadState)(filename)))
+    if (rg_savestate_begin(filename, false))
+    {
+        success = (*app.handlers.loadState)(filename);
+        success = rg_savestate_end(success);
+    }
+
+    if (!success)
     {
         RG_LOGE("Load failed!\n");
     }
@@ -644,7 +795,18 @@ bool rg_emu_save_state(uint8_t slot)
 
     #define tempname(ext) strcat(strcpy(tempname, filename), ext)
 
-    if ((*app.handlers.saveState)(tempname(".new")))
+    // The emulator writes to memory through rg_savestate_fopen, the state is compressed when it's done
+    rg_savestate_begin(tempname(".new"), true);
+    bool written = rg_savestate_end((*app.handlers.saveState)(tempname(".new")));
+
+    // The state may not fit in memory, in which case it is written again directly
+    if (!written && rg_savestate_get_stats().buffered)
+    {
+        rg_savestate_begin(tempname(".new"), true);
+        written = rg_savestate_end((*app.handlers.saveState)(tempname(".new")));
+    }
+
+    if (written)
     {
         rename(filename, tempname(".bak"));
 
@@ -26,11 +26,13 @@ extern "C" {
 #include "rg_display.h"
 #include "rg_input.h"
 #include "rg_storage.h"
+#include "rg_savestate.h"
 #include "rg_settings.h"
 #include "rg_gui.h"
 #include "rg_i2c.h"
 #include "rg_profiler.h"
 #include "rg_printf.h"
+#include "rg_arena.h"
 
 #ifdef RG_ENABLE_NETPLAY
 #include "rg_netplay.h"
@@ -60,7 +62,9 @@ enum
     RG_BOOT_SLOT2     = 0x20,
     RG_BOOT_SLOT3     = 0x30,
     RG_BOOT_SLOT_MASK = 0xF0,
-    // bits 8-31: unused...
+    // bits 8-15: options
+    RG_BOOT_BENCHMARK = 0x100,
+    // bits 16-31: unused...
 };
 
 enum
@@ -161,6 +165,7 @@ typedef struct
     int sampleRate;
     int logLevel;
     bool isLauncher;
+    int benchmark; // Frames left to run in headless benchmark mode (0 = disabled)
     int saveSlot;
     const char *romPath;
     const rg_gui_option_t *options;
@@ -195,6 +200,8 @@ bool rg_system_find_app(const char *app);
 void rg_system_set_led(int value);
 int  rg_system_get_led(void);
 void rg_system_tick(int busyTime);
+bool rg_system_should_draw(void);      // Frame pacing decision for the next frame, updated by rg_system_tick()
+void rg_system_skip_frames(int count); // Force the next count frames to be skipped (0 cancels)
 void rg_system_vlog(int level, const char *context, const char *format, va_list va);
 void rg_system_log(int level, const char *context, const char *format, ...) __attribute__((format(printf,3,4)));
 bool rg_system_save_trace(const char *filename, bool append);
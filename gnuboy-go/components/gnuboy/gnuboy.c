@@ -1,4 +1,5 @@
 #include <sys/param.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include "gnuboy.h"
@@ -136,38 +137,285 @@ int gnuboy_load_bios(const char *file)
 }
 
 
-void gnuboy_load_bank(int bank)
+/*
+ * ROM banks are loaded on demand and kept in an LRU cache bounded by
+ * bank_cache.budget (or by available memory, whichever comes first).
+ * When prefetch is enabled, a background thread reads the neighbours of
+ * every missed bank into a couple of staging buffers. Those are handed
+ * over to the cache by the emulation thread.
+ * Only the emulation thread modifies cart.rombanks, it does so under lock
+ * because the prefetch thread reads it. The emulation thread's own reads
+ * don't need the lock. ROM reads happen outside of lock, they are only
+ * serialized between themselves by io_lock (the file view isn't thread safe).
+ */
+#define BANK_SIZE 0x4000
+#define PREFETCH_SLOTS 2
+
+static struct
 {
-	const size_t BANK_SIZE = 0x4000;
-	const size_t OFFSET = bank * BANK_SIZE;
+	int budget;
+	int resident;
+	uint32_t clock;
+	uint32_t last_used[512];
+	gb_bank_stats_t stats;
+	// Prefetch state, protected by lock
+	bool prefetch;
+	bool quit;
+	int request;
+	struct {
+		int bank;
+		byte *data;
+	} slots[PREFETCH_SLOTS];
+	byte *spare; // Private to the prefetch thread, it reads into it
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_mutex_t io_lock;
+	pthread_cond_t cond;
+} bank_cache = {
+	.budget = 512,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.io_lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static bool read_bank(int bank, byte *dest)
+{
+	size_t offset = bank * BANK_SIZE;
+	// Some ROMs are smaller than their header claims, the rest reads as open bus
+	size_t length = offset < cart.romFile->size ? MIN(cart.romFile->size - offset, BANK_SIZE) : 0;
+	bool success = false;
+
+	pthread_mutex_lock(&bank_cache.io_lock);
+	// Retry a few times before concluding that the SD card is gone
+	for (int tries = 0; tries < 3 && !success; tries++)
+		success = rg_storage_view_read(cart.romFile, offset, dest, length) == length;
+	pthread_mutex_unlock(&bank_cache.io_lock);
+
+	memset(dest + (success ? length : 0), 0xFF, BANK_SIZE - (success ? length : 0));
+	return success;
+}
 
-	if (!cart.rombanks[bank])
-		cart.rombanks[bank] = malloc(BANK_SIZE);
+static void *prefetch_thread(void *arg)
+{
+	pthread_mutex_lock(&bank_cache.lock);
 
-	if (!cart.romFile)
+	while (!bank_cache.quit)
+	{
+		int bank = bank_cache.request;
+
+		if (bank < 0)
+		{
+			pthread_cond_wait(&bank_cache.cond, &bank_cache.lock);
+			continue;
+		}
+
+		bank_cache.request = -1;
+
+		bool staged = cart.rombanks[bank] != NULL;
+		for (int i = 0; i < PREFETCH_SLOTS; i++)
+			staged |= bank_cache.slots[i].bank == bank;
+
+		if (staged)
+			continue;
+
+		// Read without holding the lock, a miss on the emulation thread only waits for the I/O
+		pthread_mutex_unlock(&bank_cache.lock);
+		bool success = read_bank(bank, bank_cache.spare);
+		pthread_mutex_lock(&bank_cache.lock);
+
+		if (!success)
+		{
+			MESSAGE_WARN("prefetching bank %d failed.\n", bank);
+			continue;
+		}
+
+		// The emulation thread may have loaded it in the meantime
+		if (cart.rombanks[bank])
+			continue;
+
+		// Publish into the oldest slot, slot 0 is always the most recent
+		byte *data = bank_cache.slots[PREFETCH_SLOTS - 1].data;
+		memmove(&bank_cache.slots[1], &bank_cache.slots[0], sizeof(bank_cache.slots[0]) * (PREFETCH_SLOTS - 1));
+		bank_cache.slots[0].data = bank_cache.spare;
+		bank_cache.slots[0].bank = bank;
+		bank_cache.spare = data;
+	}
+
+	pthread_mutex_unlock(&bank_cache.lock);
+	return NULL;
+}
+
+static void prefetch_request(int bank)
+{
+	if (bank < 0 || bank >= cart.romsize || cart.rombanks[bank])
 		return;
+	pthread_mutex_lock(&bank_cache.lock);
+	bank_cache.request = bank;
+	pthread_cond_signal(&bank_cache.cond);
+	pthread_mutex_unlock(&bank_cache.lock);
+}
 
-	MESSAGE_INFO("loading bank %d.\n", bank);
-	while (!cart.rombanks[bank])
+// Must be called with the lock held
+static byte *evict_bank(int except)
+{
+	int victim = -1;
+	uint32_t oldest = 0;
+
+	// Bank 0 is always mapped, never evict it
+	for (int i = 1; i < cart.romsize; i++)
 	{
-		int i = rand() & 0xFF;
-		if (cart.rombanks[i])
+		uint32_t age = bank_cache.clock - bank_cache.last_used[i];
+		if (cart.rombanks[i] && i != except && age >= oldest)
 		{
-			MESSAGE_INFO("reclaiming bank %d.\n", i);
-			cart.rombanks[bank] = cart.rombanks[i];
-			cart.rombanks[i] = NULL;
-			break;
+			victim = i;
+			oldest = age;
+		}
+	}
+
+	if (victim < 0)
+		return NULL;
+
+	MESSAGE_DEBUG("evicting bank %d.\n", victim);
+	byte *data = cart.rombanks[victim];
+	cart.rombanks[victim] = NULL;
+	bank_cache.resident--;
+	bank_cache.stats.evictions++;
+	return data;
+}
+
+// Returns false if the bank couldn't be read, it then reads as open bus (0xFF)
+bool gnuboy_load_bank(int bank)
+{
+	bank_cache.last_used[bank] = ++bank_cache.clock;
+
+	if (cart.rombanks[bank])
+	{
+		bank_cache.stats.hits++;
+		return true;
+	}
+
+	if (!cart.romFile)
+		return false;
+
+	bank_cache.stats.misses++;
+
+	byte *data = NULL;
+	bool success = true;
+
+	if (bank_cache.resident < bank_cache.budget)
+		data = malloc(BANK_SIZE);
+
+	pthread_mutex_lock(&bank_cache.lock);
+
+	if (!data)
+		data = evict_bank(bank);
+	if (!data)
+	{
+		MESSAGE_ERROR("no memory for bank %d!\n", bank);
+		abort();
+	}
+
+	int slot = -1;
+	for (int i = 0; i < PREFETCH_SLOTS && bank_cache.prefetch; i++)
+	{
+		if (bank_cache.slots[i].bank == bank)
+			slot = i;
+	}
+
+	if (slot >= 0)
+	{
+		// Swap buffers with the staging slot, no need to copy
+		byte *prefetched = bank_cache.slots[slot].data;
+		bank_cache.slots[slot].data = data;
+		bank_cache.slots[slot].bank = -1;
+		data = prefetched;
+		bank_cache.stats.prefetch_hits++;
+	}
+
+	pthread_mutex_unlock(&bank_cache.lock);
+
+	if (slot < 0)
+	{
+		MESSAGE_INFO("loading bank %d.\n", bank);
+		if (!(success = read_bank(bank, data)))
+		{
+			MESSAGE_ERROR("ROM bank %d loading failed!\n", bank); // This indicates an SD Card failure
+			bank_cache.stats.errors++;
 		}
 	}
 
-	// Load the 16K page
-	if (fseek(cart.romFile, OFFSET, SEEK_SET)
-		|| !fread(cart.rombanks[bank], BANK_SIZE, 1, cart.romFile))
+	pthread_mutex_lock(&bank_cache.lock);
+	cart.rombanks[bank] = data;
+	bank_cache.resident++;
+	pthread_mutex_unlock(&bank_cache.lock);
+
+	// Games usually move through banks sequentially
+	if (bank_cache.prefetch)
+		prefetch_request(bank + 1);
+
+	return success;
+}
+
+void gnuboy_set_bank_cache(int budget, bool prefetch)
+{
+	bank_cache.budget = (budget > 0 && budget < 512) ? budget : 512;
+
+	pthread_mutex_lock(&bank_cache.lock);
+	while (bank_cache.resident > bank_cache.budget)
+	{
+		byte *data = evict_bank(-1);
+		if (!data)
+			break;
+		free(data);
+	}
+	pthread_mutex_unlock(&bank_cache.lock);
+
+	if (prefetch && !bank_cache.prefetch)
 	{
-		MESSAGE_WARN("ROM bank loading failed\n");
-		if (!feof(cart.romFile))
-			abort(); // This indicates an SD Card failure
+		for (int i = 0; i < PREFETCH_SLOTS; i++)
+		{
+			bank_cache.slots[i].bank = -1;
+			bank_cache.slots[i].data = malloc(BANK_SIZE);
+			if (!bank_cache.slots[i].data)
+				prefetch = false;
+		}
+		if (!(bank_cache.spare = malloc(BANK_SIZE)))
+			prefetch = false;
+		bank_cache.request = -1;
+		bank_cache.quit = false;
+		if (prefetch && pthread_create(&bank_cache.thread, NULL, prefetch_thread, NULL) != 0)
+			prefetch = false;
+		if (!prefetch)
+		{
+			MESSAGE_WARN("Prefetch disabled, not enough resources.\n");
+			for (int i = 0; i < PREFETCH_SLOTS; i++)
+				free(bank_cache.slots[i].data), bank_cache.slots[i].data = NULL;
+			free(bank_cache.spare), bank_cache.spare = NULL;
+		}
 	}
+	else if (!prefetch && bank_cache.prefetch)
+	{
+		pthread_mutex_lock(&bank_cache.lock);
+		bank_cache.quit = true;
+		pthread_cond_signal(&bank_cache.cond);
+		pthread_mutex_unlock(&bank_cache.lock);
+		pthread_join(bank_cache.thread, NULL);
+		for (int i = 0; i < PREFETCH_SLOTS; i++)
+			free(bank_cache.slots[i].data), bank_cache.slots[i].data = NULL;
+		free(bank_cache.spare), bank_cache.spare = NULL;
+	}
+
+	bank_cache.prefetch = prefetch;
+
+	MESSAGE_INFO("Bank cache: budget=%d banks, prefetch=%d\n", bank_cache.budget, prefetch);
+}
+
+gb_bank_stats_t gnuboy_get_bank_stats(void)
+{
+	gb_bank_stats_t stats = bank_cache.stats;
+	stats.resident = bank_cache.resident;
+	stats.budget = bank_cache.budget;
+	return stats;
 }
 
 
@@ -188,17 +436,18 @@ int gnuboy_load_rom(const char *file)
 
 	byte header[0x200];
 
-	cart.romFile = fopen(file, "rb");
+	cart.romFile = rg_storage_view_open(file);
 	if (cart.romFile == NULL)
 	{
-		MESSAGE_ERROR("ROM fopen failed");
+		MESSAGE_ERROR("ROM open failed");
 		return -1;
 	}
 
-	if (fread(&header, 0x200, 1, cart.romFile) != 1)
+	if (rg_storage_view_read(cart.romFile, 0, &header, 0x200) != 0x200)
 	{
-		MESSAGE_ERROR("ROM fread failed");
-		fclose(cart.romFile);
+		MESSAGE_ERROR("ROM read failed");
+		rg_storage_view_close(cart.romFile);
+		cart.romFile = NULL;
 		return -1;
 	}
 
@@ -364,10 +613,13 @@ int gnuboy_load_rom(const char *file)
 		preload = cart.romsize - 40;
 	}
 
+	preload = MIN(preload, bank_cache.budget);
+
 	MESSAGE_INFO("Preloading the first %d banks\n", preload);
 	for (int i = 0; i < preload; i++)
 	{
-		gnuboy_load_bank(i);
+		if (!gnuboy_load_bank(i))
+			return -1;
 	}
 
 	// Apply game-specific hacks
@@ -392,6 +644,14 @@ int gnuboy_load_rom(const char *file)
 
 void gnuboy_free_rom(void)
 {
+	gb_bank_stats_t stats = gnuboy_get_bank_stats();
+	MESSAGE_INFO("Bank cache: hits=%u misses=%u prefetched=%u evictions=%u errors=%u resident=%d\n",
+		stats.hits, stats.misses, stats.prefetch_hits, stats.evictions, stats.errors, stats.resident);
+
+	gnuboy_set_bank_cache(bank_cache.budget, false);
+	memset(&bank_cache.stats, 0, sizeof(bank_cache.stats));
+	bank_cache.resident = 0;
+
 	for (int i = 0; i < 512; i++)
 	{
 		if (cart.rombanks[i]) {
@@ -404,7 +664,7 @@ void gnuboy_free_rom(void)
 
 	if (cart.romFile)
 	{
-		fclose(cart.romFile);
+		rg_storage_view_close(cart.romFile);
 		cart.romFile = NULL;
 	}
 
@@ -724,7 +984,7 @@ static int do_save_load(const char *file, bool save)
 
 	if (save)
 	{
-		if (!(fp = fopen(file, "wb")))
+		if (!(fp = rg_savestate_fopen(file, "wb")))
 			goto _error;
 
 		for (int i = 0; svars[i].ptr; i++)
@@ -764,7 +1024,7 @@ static int do_save_load(const char *file, bool save)
 	}
 	else
 	{
-		if (!(fp = fopen(file, "rb")))
+		if (!(fp = rg_savestate_fopen(file, "rb")))
 			goto _error;
 
 		for (int i = 0; blocks[i].ptr != NULL; i++)
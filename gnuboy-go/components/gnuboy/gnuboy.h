@@ -116,6 +116,17 @@ typedef struct
 	} audio;
 } gb_host_t;
 
+typedef struct
+{
+	unsigned hits;
+	unsigned misses;
+	unsigned evictions;
+	unsigned prefetch_hits;
+	unsigned errors; // Banks that couldn't be read, they read as open bus
+	int resident;
+	int budget;
+} gb_bank_stats_t;
+
 extern gb_host_t host;
 
 int  gnuboy_init(int samplerate, bool stereo, int pixformat, void *blit_func);
@@ -126,7 +137,9 @@ void gnuboy_free_rom(void);
 void gnuboy_reset(bool hard);
 void gnuboy_run(bool draw);
 bool gnuboy_sram_dirty(void);
-void gnuboy_load_bank(int);
+bool gnuboy_load_bank(int);
+void gnuboy_set_bank_cache(int budget, bool prefetch);
+gb_bank_stats_t gnuboy_get_bank_stats(void);
 void gnuboy_set_pad(int);
 
 void gnuboy_get_time(int *day, int *hour, int *minute, int *second);
@@ -273,10 +273,8 @@ void hw_updatemap(void)
 {
 	int rombank = cart.rombank & (cart.romsize - 1);
 
-	if (cart.rombanks[rombank] == NULL)
-	{
-		gnuboy_load_bank(rombank);
-	}
+	// Loads the bank if needed and keeps the cache's LRU information up to date
+	gnuboy_load_bank(rombank);
 
 	// ROM
 	hw.rmap[0x0] = cart.rombanks[0];
@@ -198,8 +198,8 @@ typedef struct
 	int rombank;
 	int rambank;
 
-	// File descriptors that we keep open
-	FILE *romFile;
+	// Files that we keep open
+	rg_file_view_t *romFile;
 	FILE *sramFile;
 } gb_cart_t;
 
@@ -6,14 +6,10 @@
 
 #define AUDIO_SAMPLE_RATE   (32000)
 
-static rg_video_update_t updates[2];
-static rg_video_update_t *currentUpdate = &updates[0];
+static rg_video_update_t *currentUpdate;
 
 static rg_app_t *app;
 
-static bool fullFrame = false;
-static long skipFrames = 20; // The 20 is to hide startup flicker in some games
-
 static const char *sramFile;
 static long autoSaveSRAM = 0;
 static long autoSaveSRAM_Timer = 0;
@@ -25,7 +21,7 @@ static const char *SETTING_PALETTE  = "Palette";
 
 static bool screenshot_handler(const char *filename, int width, int height)
 {
-    return rg_display_save_frame(filename, currentUpdate, width, height);
+    return rg_display_save_frame(filename, rg_display_last_frame(), width, height);
 }
 
 static bool save_state_handler(const char *filename)
@@ -45,7 +41,7 @@ static bool load_state_handler(const char *filename)
         return false;
     }
 
-    skipFrames = 0;
+    rg_system_skip_frames(0);
     autoSaveSRAM_Timer = 0;
 
     // TO DO: Call rtc_sync() if a physical RTC is present
@@ -56,8 +52,7 @@ static bool reset_handler(bool hard)
 {
     gnuboy_reset(hard);
 
-    fullFrame = false;
-    skipFrames = 20;
+    rg_system_skip_frames(20); // The 20 is to hide startup flicker in some games
     autoSaveSRAM_Timer = 0;
 
     if (hard)
@@ -207,9 +202,8 @@ static rg_gui_event_t sram_settings_cb(rg_gui_option_t *option, rg_gui_event_t e
 
 static void blit_frame(void)
 {
-    rg_video_update_t *previousUpdate = &updates[currentUpdate == &updates[0]];
-    fullFrame = rg_display_queue_update(currentUpdate, previousUpdate) == RG_UPDATE_FULL;
-    currentUpdate = previousUpdate;
+    rg_display_present_frame(currentUpdate);
+    currentUpdate = rg_display_acquire_frame();
     host.video.buffer = currentUpdate->buffer;
 }
 
@@ -243,10 +237,9 @@ void app_main(void)
 
     app = rg_system_init(AUDIO_SAMPLE_RATE, &handlers, options);
 
-    updates[0].buffer = rg_alloc(GB_WIDTH * GB_HEIGHT * 2, MEM_ANY);
-    updates[1].buffer = rg_alloc(GB_WIDTH * GB_HEIGHT * 2, MEM_ANY);
-
     rg_display_set_source_format(GB_WIDTH, GB_HEIGHT, 0, 0, GB_WIDTH * 2, RG_PIXEL_565_BE);
+    rg_display_swapchain_init(3, GB_WIDTH * GB_HEIGHT * 2, MEM_ANY, RG_DISPLAY_DROP_OLDEST);
+    currentUpdate = rg_display_acquire_frame();
 
     autoSaveSRAM = rg_settings_get_number(NS_APP, SETTING_SAVESRAM, 0);
     sramFile = rg_emu_get_path(RG_PATH_SAVE_SRAM, app->romPath);
@@ -261,6 +254,9 @@ void app_main(void)
     if (gnuboy_load_rom(app->romPath) < 0)
         RG_PANIC("ROM Loading failed!");
 
+    // Large games don't fit in memory, read ahead the banks they are likely to switch to
+    gnuboy_set_bank_cache(0, true);
+
     // Load BIOS
     if (gnuboy_get_hwtype() == GB_HW_CGB)
         gnuboy_load_bios(RG_BASE_PATH_SYSTEM "/gbc_bios.bin");
@@ -271,6 +267,7 @@ void app_main(void)
 
     // Hard reset to have a clean slate
     gnuboy_reset(true);
+    rg_system_skip_frames(20); // The 20 is to hide startup flicker in some games
 
     // Load saved state or SRAM
     if (app->bootFlags & RG_BOOT_RESUME)
@@ -318,7 +315,7 @@ void app_main(void)
         }
 
         int64_t startTime = rg_system_timer();
-        bool drawFrame = !skipFrames;
+        bool drawFrame = rg_system_should_draw();
 
         gnuboy_run(drawFrame);
 
@@ -336,28 +333,13 @@ void app_main(void)
                 auto_sram_update();
 
                 #if RG_STORAGE_DRIVER == 1 // This is only necessary when the SPI bus is shared
-                skipFrames += 5;
+                rg_system_skip_frames(5);
                 #endif
             }
         }
 
         int elapsed = rg_system_timer() - startTime;
 
-        if (skipFrames == 0)
-        {
-            int frameTime = 1000000 / (60 * app->speed);
-            if (elapsed > frameTime - 2000) // It takes about 2ms to copy the audio buffer
-                skipFrames = (elapsed + frameTime / 2) / frameTime;
-            else if (drawFrame && fullFrame) // This could be avoided when scaling != full
-                skipFrames = 1;
-            if (app->speed > 1.f) // This is a hack until we account for audio speed...
-                skipFrames += (int)app->speed;
-        }
-        else if (skipFrames > 0)
-        {
-            skipFrames--;
-        }
-
         // Tick before submitting audio/syncing
         rg_system_tick(elapsed);
 
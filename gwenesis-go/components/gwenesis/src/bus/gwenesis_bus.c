@@ -369,9 +369,11 @@ static inline unsigned int gwenesis_bus_read_memory_8(unsigned int address) {
     return FETCH8ROM(address);
 
   case Z80_RAM_ADDR:
+    gwenesis_sound_sync();
     return ZRAM[address & 0x1FFF];
 
   case YM2612_ADDR:
+    gwenesis_sound_sync();
     return YM2612Read();
 
   case IO_CTRL:
@@ -408,9 +410,11 @@ static inline unsigned int gwenesis_bus_read_memory_16(unsigned int address) {
     return FETCH16ROM(address);
 
   case Z80_RAM_ADDR:
+    gwenesis_sound_sync();
     return ZRAM[address & 0X7FFF] | (ZRAM[address & 0X7FFF] << 8); 
 
   case YM2612_ADDR:
+    gwenesis_sound_sync();
     return YM2612Read();
 
   case IO_CTRL:
@@ -449,6 +453,7 @@ static inline void gwenesis_bus_write_memory_8(unsigned int address,
     return;
 
   case Z80_RAM_ADDR:
+    gwenesis_sound_sync();
     ZRAM[address & 0x1FFF] = value;
     return;
 
@@ -459,12 +464,13 @@ static inline void gwenesis_bus_write_memory_8(unsigned int address,
 
   case Z80_CTRL:
 
+    gwenesis_sound_sync();
     z80_write_ctrl(address & 0xFFFF, value);
     return;
 
   case YM2612_ADDR:
 
-    YM2612Write(address & 0x3, value);
+    gwenesis_sound_ym_write(address & 0x3, value);
     return;
 
   case TMSS_CTRL:
@@ -498,17 +504,19 @@ static inline void gwenesis_bus_write_memory_16(unsigned int address,
   switch (gwenesis_bus_map_address(address)) {
 
   case Z80_RAM_ADDR:
+    gwenesis_sound_sync();
     ZRAM[address & 0X7FFF]= value >> 8;
     return;
 
   case Z80_CTRL:
 
+    gwenesis_sound_sync();
     z80_write_ctrl(address & 0x1FFF, value);
     return;
 
   case YM2612_ADDR:
 
-    YM2612Write(address & 0x3, value & 0Xff);
+    gwenesis_sound_ym_write(address & 0x3, value & 0Xff);
     return;
 
   case VDP_ADDR:
@@ -75,6 +75,10 @@ void m68k_write_memory_32(unsigned int address,unsigned int value);
 void m68k_write_memory_16(unsigned int address,unsigned int value);
 void m68k_write_memory_8(unsigned int address,unsigned int value);
 
+/* Provided by the frontend, which runs the Z80 and YM2612 asynchronously */
+void gwenesis_sound_sync(void);
+void gwenesis_sound_ym_write(unsigned int port, unsigned int value);
+
 void gwenesis_bus_save_state();
 void gwenesis_bus_load_state();
 
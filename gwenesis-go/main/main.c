@@ -1,6 +1,5 @@
 #include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
-#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <rg_system.h>
 #include <stdio.h>
 
@@ -25,13 +24,38 @@ extern uint64_t zclk;
 
 static int16_t audioBuffer[AUDIO_BUFFER_LENGTH * 2];
 
-static rg_video_update_t updates[2];
-static rg_video_update_t *currentUpdate = &updates[0];
+static rg_video_update_t *currentUpdate;
 
 static rg_app_t *app;
 
-#define WAIT_FOR_Z80_RUN() while (uxQueueMessagesWaiting(sound_task_run));
-static QueueHandle_t sound_task_run;
+// The Z80 and YM2612 run on the other core, fed by a lock-free ring of timestamped events. The 68K
+// queues YM2612 writes, Z80 interrupts and line ends and only waits for the sound task when it
+// accesses the Z80 bus. The sound task is woken every few lines and catches up in one go.
+#define SOUND_RING_SIZE   1024 // Must be a power of two
+#define SOUND_BATCH_LINES 32
+
+typedef enum
+{
+    SOUND_EV_LINE,
+    SOUND_EV_YM_WRITE,
+    SOUND_EV_Z80_IRQ,
+} sound_event_type_t;
+
+typedef struct
+{
+    uint64_t clock;
+    uint16_t value;
+    uint8_t type;
+    uint8_t port;
+} sound_event_t;
+
+static struct
+{
+    sound_event_t events[SOUND_RING_SIZE];
+    uint32_t head; // Only written by the 68K
+    uint32_t tail; // Only written by the sound task, once the event has been processed
+    TaskHandle_t task;
+} sound_ring;
 
 static bool yfm_enabled = true;
 static bool yfm_resample = true;
@@ -157,12 +181,13 @@ static rg_gui_event_t sampling_update_cb(rg_gui_option_t *option, rg_gui_event_t
 
 static bool screenshot_handler(const char *filename, int width, int height)
 {
-    return rg_display_save_frame(filename, currentUpdate, width, height);
+    return rg_display_save_frame(filename, rg_display_last_frame(), width, height);
 }
 
 static bool save_state_handler(const char *filename)
 {
-    if ((savestate_fp = fopen(filename, "wb")))
+    gwenesis_sound_sync();
+    if ((savestate_fp = rg_savestate_fopen(filename, "wb")))
     {
         savestate_errors = 0;
         gwenesis_save_state();
@@ -174,7 +199,8 @@ static bool save_state_handler(const char *filename)
 
 static bool load_state_handler(const char *filename)
 {
-    if ((savestate_fp = fopen(filename, "rb")))
+    gwenesis_sound_sync();
+    if ((savestate_fp = rg_savestate_fopen(filename, "rb")))
     {
         savestate_errors = 0;
         gwenesis_load_state();
@@ -188,63 +214,128 @@ static bool load_state_handler(const char *filename)
 
 static bool reset_handler(bool hard)
 {
+    gwenesis_sound_sync();
     reset_emulation();
     return true;
 }
 
-static void sound_task(void *arg)
+static inline void sound_kick(void)
 {
-    sound_task_run = xQueueCreate(1, sizeof(uint64_t));
+    if (sound_ring.task)
+        xTaskNotifyGive(sound_ring.task);
+}
 
-    uint64_t system_clock;
-    size_t audio_index = 0;
+static void sound_push(sound_event_type_t type, uint64_t clock, uint8_t port, uint16_t value)
+{
+    uint32_t head = sound_ring.head;
 
-    while (true)
+    // The ring is full, the sound task must catch up before we can go on
+    if (head - __atomic_load_n(&sound_ring.tail, __ATOMIC_ACQUIRE) >= SOUND_RING_SIZE)
     {
-        xQueuePeek(sound_task_run, &system_clock, portMAX_DELAY);
-        if (!z80_enabled)
-            zclk = system_clock * 2; // To infinity, and beyond!
-        z80_run(system_clock);
-        xQueueReceive(sound_task_run, &system_clock, portMAX_DELAY);
-
-        if (!yfm_enabled)
+        sound_kick();
+        while (head - __atomic_load_n(&sound_ring.tail, __ATOMIC_ACQUIRE) >= SOUND_RING_SIZE)
             continue;
+    }
+
+    sound_ring.events[head & (SOUND_RING_SIZE - 1)] = (sound_event_t){clock, value, type, port};
+    __atomic_store_n(&sound_ring.head, head + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint64_t m68k_time(void)
+{
+    return m68k_clock + m68k_cycles_run() * M68K_FREQ_DIVISOR;
+}
 
-        // This is essentially magic to get close enough. Not accurate at all.
-        size_t audio_step = 3 + (scan_line & 1);
-        YM2612Update(&audioBuffer[audio_index * 2], audio_step);
-        audio_index += audio_step;
+// Called by the bus before the 68K touches Z80 RAM, the Z80 control lines or reads the YM2612
+void gwenesis_sound_sync(void)
+{
+    if (__atomic_load_n(&sound_ring.tail, __ATOMIC_ACQUIRE) == sound_ring.head)
+        return;
+    sound_kick();
+    while (__atomic_load_n(&sound_ring.tail, __ATOMIC_ACQUIRE) != sound_ring.head)
+        continue;
+}
+
+// Called by the bus when the 68K writes to the YM2612, the Z80 side is never blocked by it
+void gwenesis_sound_ym_write(unsigned int port, unsigned int value)
+{
+    sound_push(SOUND_EV_YM_WRITE, m68k_time(), port, value);
+}
 
-        // Submit at end of frame or whenever the buffer is full
-        if (scan_line == 261 || audio_index >= AUDIO_BUFFER_LENGTH - 4)
+static inline void sound_run_z80(uint64_t clock)
+{
+    if (!z80_enabled)
+        zclk = clock * 2; // To infinity, and beyond!
+    z80_run(clock);
+}
+
+static void sound_task(void *arg)
+{
+    size_t audio_index = 0;
+
+    sound_ring.task = xTaskGetCurrentTaskHandle();
+
+    // Events queued before our handle was published are handled before we first go to sleep
+    while (true)
+    {
+        uint32_t tail = sound_ring.tail;
+
+        while (tail != __atomic_load_n(&sound_ring.head, __ATOMIC_ACQUIRE))
         {
-            int carry = 0;
+            const sound_event_t *event = &sound_ring.events[tail & (SOUND_RING_SIZE - 1)];
+
+            sound_run_z80(event->clock);
 
-            if (yfm_resample > 0)
+            if (event->type == SOUND_EV_YM_WRITE)
             {
-                // Resampling deals with even number of samples, carry what's left
-                carry = (audio_index & 1) ? (audio_index - 1) : 0;
-                for (size_t i = 0; i < audio_index - 1; ++i)
-                {
-                    audioBuffer[i] = (audioBuffer[i*2] + audioBuffer[(i+1)*2]) >> 1;
-                }
-                audio_index >>= 1;
+                YM2612Write(event->port, event->value);
+            }
+            else if (event->type == SOUND_EV_Z80_IRQ)
+            {
+                z80_irq_line(event->value);
             }
+            else if (yfm_enabled)
+            {
+                unsigned line = event->value;
 
-            rg_audio_submit((void*)audioBuffer, audio_index);
-            audio_index = 0;
+                // This is essentially magic to get close enough. Not accurate at all.
+                size_t audio_step = 3 + (line & 1);
+                YM2612Update(&audioBuffer[audio_index * 2], audio_step);
+                audio_index += audio_step;
 
-            if (carry)
-            {
-                audioBuffer[0] = audioBuffer[carry*2-1];
-                audioBuffer[1] = audioBuffer[carry*2-0];
-                audio_index = 1;
+                // Submit at end of frame or whenever the buffer is full
+                if (line == 261 || audio_index >= AUDIO_BUFFER_LENGTH - 4)
+                {
+                    int carry = 0;
+
+                    if (yfm_resample > 0)
+                    {
+                        // Resampling deals with even number of samples, carry what's left
+                        carry = (audio_index & 1) ? (audio_index - 1) : 0;
+                        for (size_t i = 0; i < audio_index - 1; ++i)
+                        {
+                            audioBuffer[i] = (audioBuffer[i*2] + audioBuffer[(i+1)*2]) >> 1;
+                        }
+                        audio_index >>= 1;
+                    }
+
+                    rg_audio_submit((void*)audioBuffer, audio_index);
+                    audio_index = 0;
+
+                    if (carry)
+                    {
+                        audioBuffer[0] = audioBuffer[carry*2-1];
+                        audioBuffer[1] = audioBuffer[carry*2-0];
+                        audio_index = 1;
+                    }
+                }
             }
+
+            __atomic_store_n(&sound_ring.tail, ++tail, __ATOMIC_RELEASE);
         }
-    }
 
-    vQueueDelete(sound_task_run);
-    sound_task_run = NULL;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
 
     rg_task_delete(NULL);
 }
@@ -272,27 +363,28 @@ void app_main(void)
 
     VRAM = rg_alloc(VRAM_MAX_SIZE, MEM_FAST);
 
-    updates[0].buffer = rg_alloc(320 * 240, MEM_FAST);
-    // updates[1].buffer = rg_alloc(320 * 240 * 2, MEM_FAST);
+    rg_display_swapchain_init(2, 320 * 240, MEM_FAST, RG_DISPLAY_DROP_NONE);
+    currentUpdate = rg_display_acquire_frame();
 
     rg_task_create("gen_sound", &sound_task, NULL, 2048, 7, 1);
     rg_audio_set_sample_rate(yfm_resample ? 26634 : 53267);
 
     RG_LOGI("Genesis start\n");
 
-    FILE *fp = fopen(app->romPath, "rb");
-    if (fp)
+    rg_file_view_t *view = rg_storage_view_open(app->romPath);
+    if (view)
     {
+        // The core reads past the end of small ROMs and wants them byte swapped, so we copy
         uint8_t *buffer = rg_alloc(0x300000, MEM_SLOW);
         ROM_DATA = buffer;
-        ROM_DATA_LENGTH = fread(buffer, 1, 0x300000, fp);
+        ROM_DATA_LENGTH = rg_storage_view_read(view, 0, buffer, 0x300000);
         for (size_t i = 0; i < ROM_DATA_LENGTH; i += 2)
         {
             uint8_t z = buffer[i];
             buffer[i] = buffer[i + 1];
             buffer[i + 1] = z;
         }
-        fclose(fp);
+        rg_storage_view_close(view);
         RG_LOGI("ROM SIZE = %d\n", ROM_DATA_LENGTH);
     } else {
         RG_PANIC("Rom load failed");
@@ -308,7 +400,6 @@ void app_main(void)
     uint32_t keymap[8] = {RG_KEY_UP, RG_KEY_DOWN, RG_KEY_LEFT, RG_KEY_RIGHT, RG_KEY_A, RG_KEY_B, RG_KEY_SELECT, RG_KEY_START};
     uint32_t joystick = 0, joystick_old;
     uint64_t system_clock = 0;
-    uint32_t frames = 0;
 
     RG_LOGI("load_cartridge()\n");
     load_cartridge();
@@ -352,7 +443,7 @@ void app_main(void)
         }
 
         int64_t startTime = rg_system_timer();
-        bool drawFrame = (frames++ & 3) == 3;
+        bool drawFrame = rg_system_should_draw();
 
         int hint_counter = gwenesis_vdp_regs[10];
 
@@ -364,12 +455,12 @@ void app_main(void)
 
         for (scan_line = 0; scan_line < 262; scan_line++)
         {
+            m68k_clock = system_clock;
             system_clock += VDP_CYCLES_PER_LINE;
 
-            WAIT_FOR_Z80_RUN(); // m68k_run might call z80_sync, we don't want to conflict
             m68k_execute(VDP_CYCLES_PER_LINE / M68K_FREQ_DIVISOR);
             // system_clock -= m68k_cycles_remaining() * M68K_FREQ_DIVISOR;
-            xQueueSend(sound_task_run, &system_clock, portMAX_DELAY);
+            sound_push(SOUND_EV_LINE, system_clock, 0, scan_line);
 
             if (drawFrame && scan_line < screen_height)
                 gwenesis_vdp_render_line(scan_line);
@@ -398,23 +489,23 @@ void app_main(void)
                     gwenesis_vdp_status |= STATUS_VIRQPENDING;
                     m68k_set_irq(6);
                 }
-                WAIT_FOR_Z80_RUN();
-                z80_irq_line(1);
+                sound_push(SOUND_EV_Z80_IRQ, system_clock, 0, 1);
             }
             else if (scan_line == screen_height)
             {
-                WAIT_FOR_Z80_RUN();
-                z80_irq_line(0);
+                sound_push(SOUND_EV_Z80_IRQ, system_clock, 0, 0);
             }
+
+            if ((scan_line % SOUND_BATCH_LINES) == SOUND_BATCH_LINES - 1 || scan_line == 261)
+                sound_kick();
         }
 
         if (drawFrame)
         {
             for (int i = 0; i < 256; ++i)
                 currentUpdate->palette[i] = (CRAM565[i] << 8) | (CRAM565[i] >> 8);
-            // rg_video_update_t *previousUpdate = &updates[currentUpdate == &updates[0]];
-            rg_display_queue_update(currentUpdate, NULL);
-            // currentUpdate = previousUpdate;
+            rg_display_present_frame(currentUpdate);
+            currentUpdate = rg_display_acquire_frame();
         }
 
         int elapsed = rg_system_timer() - startTime;
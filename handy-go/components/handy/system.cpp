@@ -126,28 +126,24 @@ CSystem::CSystem(const char* filename, long displayformat, long samplerate)
    mSusie(NULL),
    mEEPROM(NULL)
 {
+   rg_file_view_t *view;
    UBYTE *filedata = NULL;
    ULONG filesize = 0;
-   FILE *fp;
 
    log_printf("Loading '%s'...\n", filename);
 
-   if ((fp = fopen(filename, "rb"))) {
-      fseek(fp, 0, SEEK_END);
-      filesize = ftell(fp);
-      filedata = (UBYTE*)malloc(filesize);
-      fseek(fp, 0, SEEK_SET);
+   // CCart and CRam copy what they need, so a mapped file is used as is
+   if ((view = rg_storage_view_open(filename))) {
+      filesize = view->size;
+      filedata = (UBYTE*)rg_storage_view_data(view, MEM_ANY);
       if (!filedata) {
-         log_printf("-> memory allocation failed (%d bytes)!\n", filesize);
-      } else if (fread(filedata, filesize, 1, fp) != 1) {
-         log_printf("-> fread failed (%d bytes)!\n", filesize);
+         log_printf("-> read failed (%d bytes)!\n", filesize);
       } else {
          // log_printf("-> read ok. size=%d, crc32=%08X\n", filesize, crc32_le(0, filedata, filesize));
          log_printf("-> read ok. size=%d\n", filesize);
       }
-      fclose(fp);
    } else {
-      log_printf("-> fopen failed!\n");
+      log_printf("-> open failed!\n");
    }
 
    // Now try and determine the filetype we have opened
@@ -190,7 +186,7 @@ CSystem::CSystem(const char* filename, long displayformat, long samplerate)
    mBiosVectors[5] = 0xFF;
 
    // Regain some memory before initializing the rest
-   free(filedata);
+   rg_storage_view_close(view);
 
    mRamPointer = mRam->GetRamPointer();
    mMemMapReg = 0x00;
@@ -12,8 +12,7 @@ extern "C" {
 
 static rg_audio_sample_t audioBuffer[AUDIO_BUFFER_LENGTH];
 
-static rg_video_update_t updates[2];
-static rg_video_update_t *currentUpdate = &updates[0];
+static rg_video_update_t *currentUpdate;
 static rg_app_t *app = NULL;
 static CSystem *lynx = NULL;
 
@@ -27,7 +26,6 @@ static int dpad_mapped_right;
 static void set_display_mode(void)
 {
     display_rotation_t rotation = rg_display_get_rotation();
-    int width, height;
 
     if (rotation == RG_DISPLAY_ROTATION_AUTO)
     {
@@ -57,27 +55,19 @@ static void set_display_mode(void)
     switch(rotation)
     {
         case RG_DISPLAY_ROTATION_LEFT:
-            width = HANDY_SCREEN_HEIGHT;
-            height = HANDY_SCREEN_WIDTH;
-            lynx->mMikie->SetRotation(MIKIE_ROTATE_L);
             dpad_mapped_up    = BUTTON_RIGHT;
             dpad_mapped_down  = BUTTON_LEFT;
             dpad_mapped_left  = BUTTON_UP;
             dpad_mapped_right = BUTTON_DOWN;
             break;
         case RG_DISPLAY_ROTATION_RIGHT:
-            width = HANDY_SCREEN_HEIGHT;
-            height = HANDY_SCREEN_WIDTH;
-            lynx->mMikie->SetRotation(MIKIE_ROTATE_R);
             dpad_mapped_up    = BUTTON_LEFT;
             dpad_mapped_down  = BUTTON_RIGHT;
             dpad_mapped_left  = BUTTON_DOWN;
             dpad_mapped_right = BUTTON_UP;
             break;
         default:
-            width = HANDY_SCREEN_WIDTH;
-            height = HANDY_SCREEN_HEIGHT;
-            lynx->mMikie->SetRotation(MIKIE_NO_ROTATE);
+            rotation = RG_DISPLAY_ROTATION_OFF;
             dpad_mapped_up    = BUTTON_UP;
             dpad_mapped_down  = BUTTON_DOWN;
             dpad_mapped_left  = BUTTON_LEFT;
@@ -85,7 +75,9 @@ static void set_display_mode(void)
             break;
     }
 
-    rg_display_set_source_format(width, height, 0, 0, HANDY_SCREEN_WIDTH * 2, RG_PIXEL_565_BE);
+    // The frame is always rendered upright, the display driver rotates it
+    rg_display_set_source_format(HANDY_SCREEN_WIDTH, HANDY_SCREEN_HEIGHT, 0, 0, HANDY_SCREEN_WIDTH * 2, RG_PIXEL_565_BE);
+    rg_display_set_source_rotation(rotation);
 }
 
 
@@ -114,7 +106,7 @@ static rg_gui_event_t rotation_cb(rg_gui_option_t *option, rg_gui_event_t event)
 
 static bool screenshot_handler(const char *filename, int width, int height)
 {
-    return rg_display_save_frame(filename, currentUpdate, width, height);
+    return rg_display_save_frame(filename, rg_display_last_frame(), width, height);
 }
 
 static bool save_state_handler(const char *filename)
@@ -122,7 +114,7 @@ static bool save_state_handler(const char *filename)
     bool ret = false;
     FILE *fp;
 
-    if ((fp = fopen(filename, "wb")))
+    if ((fp = rg_savestate_fopen(filename, "wb")))
     {
         ret = lynx->ContextSave(fp);
         fclose(fp);
@@ -136,7 +128,7 @@ static bool load_state_handler(const char *filename)
     bool ret = false;
     FILE *fp;
 
-    if ((fp = fopen(filename, "rb")))
+    if ((fp = rg_savestate_fopen(filename, "rb")))
     {
         ret = lynx->ContextLoad(fp);
         fclose(fp);
@@ -173,9 +165,8 @@ extern "C" void app_main(void)
 
     app = rg_system_init(AUDIO_SAMPLE_RATE, &handlers, options);
 
-    // the HANDY_SCREEN_WIDTH * HANDY_SCREEN_WIDTH is deliberate because of rotation
-    updates[0].buffer = (void*)rg_alloc(HANDY_SCREEN_WIDTH * HANDY_SCREEN_WIDTH * 2, MEM_FAST);
-    updates[1].buffer = (void*)rg_alloc(HANDY_SCREEN_WIDTH * HANDY_SCREEN_WIDTH * 2, MEM_FAST);
+    rg_display_swapchain_init(2, HANDY_SCREEN_WIDTH * HANDY_SCREEN_HEIGHT * 2, MEM_FAST, RG_DISPLAY_DROP_NONE);
+    currentUpdate = rg_display_acquire_frame();
 
     // The Lynx has a variable framerate but 60 is typical
     app->refreshRate = 60;
@@ -199,10 +190,6 @@ extern "C" void app_main(void)
 
     set_display_mode();
 
-    float sampleTime = AUDIO_SAMPLE_RATE / 1000000.f;
-    long skipFrames = 0;
-    bool fullFrame = 0;
-
     // Start emulation
     while (1)
     {
@@ -214,12 +201,11 @@ extern "C" void app_main(void)
                 rg_gui_game_menu();
             else
                 rg_gui_options_menu();
-            sampleTime = AUDIO_SAMPLE_RATE / 1000000.f * app->speed;
             rg_audio_set_sample_rate(app->sampleRate * app->speed);
         }
 
         int64_t startTime = rg_system_timer();
-        bool drawFrame = !skipFrames;
+        bool drawFrame = rg_system_should_draw();
         ULONG buttons = 0;
 
     	if (joystick & RG_KEY_UP)     buttons |= dpad_mapped_up;
@@ -237,32 +223,13 @@ extern "C" void app_main(void)
 
         if (drawFrame)
         {
-            rg_video_update_t *previousUpdate = &updates[currentUpdate == &updates[0]];
-
-            fullFrame = rg_display_queue_update(currentUpdate, previousUpdate) == RG_UPDATE_FULL;
-
-            currentUpdate = previousUpdate;
+            rg_display_present_frame(currentUpdate);
+            currentUpdate = rg_display_acquire_frame();
             gPrimaryFrameBuffer = (UBYTE*)currentUpdate->buffer;
         }
 
         int elapsed = rg_system_timer() - startTime;
 
-        // See if we need to skip a frame to keep up
-        if (skipFrames == 0)
-        {
-            if (app->speed > 1.f)
-                skipFrames += (int)app->speed * 2;
-            // The Lynx uses a variable framerate so we use the count of generated audio samples as reference instead
-            else if (elapsed > ((gAudioBufferPointer/2) * sampleTime))
-                skipFrames += 1;
-            else if (drawFrame && fullFrame) // This could be avoided when scaling != full
-                skipFrames += 1;
-        }
-        else if (skipFrames > 0)
-        {
-            skipFrames--;
-        }
-
         rg_system_tick(elapsed);
 
         rg_audio_submit(audioBuffer, gAudioBufferPointer >> 1);
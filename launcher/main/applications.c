@@ -1,4 +1,6 @@
 #include <rg_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -9,91 +11,365 @@
 
 #include "applications.h"
 #include "bookmarks.h"
+#include "thumbnails.h"
 #include "utils.h"
 #include "gui.h"
 
-#define CRC_CACHE_MAGIC 0x21112222
+#define CRC_CACHE_MAGIC 0x21112223 // v2: keys include the file size and mtime
 #define CRC_CACHE_MAX_ENTRIES 8192
-static struct __attribute__((__packed__))
+#define CRC_CACHE_SLOTS (CRC_CACHE_MAX_ENTRIES * 2) // Must be a power of two
+#define CRC_CACHE_PATH RG_BASE_PATH_CACHE "/crc32.bin"
+
+#define ROM_INDEX_MAGIC 0x32584449 // "IDX2", v2: folders record their entry count
+#define ROM_INDEX_PATH RG_BASE_PATH_CACHE "/roms_%s.bin"
+
+#define NAMES_BLOCK_SIZE 0x2000
+
+typedef struct __attribute__((__packed__))
+{
+    uint32_t key;
+    uint32_t crc;
+} crc_cache_entry_t;
+
+// The on-disk cache is an append-only log of entries, loaded into an open addressing table
+static struct
+{
+    crc_cache_entry_t *slots;
+    int count;
+    int records; // Entries in the file, including stale ones
+    SemaphoreHandle_t lock;
+    // Shared with the worker: polled without the lock, so they must be volatile
+    volatile bool worker_running;
+    volatile bool quit;
+    struct {
+        char path[RG_PATH_MAX + 1];
+        size_t offset;
+        volatile bool pending;
+        volatile bool done;
+        volatile uint32_t failed; // Key of the last file that couldn't be hashed, it isn't queued again
+    } wanted; // File the UI is waiting on, it goes before everything else
+} crc_cache;
+
+// File format: {header} {dir, ...} {file, ...} {strings}
+// Each folder owns a contiguous range of files, offsets point into the string table.
+typedef struct __attribute__((__packed__))
 {
     uint32_t magic;
+    uint32_t dirs_count;
+    uint32_t files_count;
+    uint32_t strings_size;
+} rom_index_header_t;
+
+typedef struct __attribute__((__packed__))
+{
+    uint32_t path;
+    uint32_t mtime;
+    uint32_t entries;
+    uint32_t first;
     uint32_t count;
-    struct {
-        uint32_t key;
-        uint32_t crc;
-    } entries[CRC_CACHE_MAX_ENTRIES];
-} *crc_cache;
-static bool crc_cache_dirty = true;
+} rom_index_dir_t;
+
+typedef struct __attribute__((__packed__))
+{
+    uint32_t name;
+    uint8_t type;
+} rom_index_file_t;
+
+typedef struct
+{
+    rom_index_header_t header;
+    rom_index_dir_t *dirs;
+    rom_index_file_t *files;
+    char *strings;
+    size_t next_dir;
+} rom_index_t;
 
 static retro_app_t *apps[24];
 static int apps_count = 0;
 
 
-static const char *get_file_path(retro_file_t *file)
+static const char *get_file_path_r(retro_file_t *file, char *buffer)
 {
-    static char buffer[RG_PATH_MAX + 1];
     if (file == NULL) return NULL;
     return strcat(strcat(strcpy(buffer, file->folder), "/"), file->name);
 }
 
-static void scan_folder(retro_app_t *app, const char* path, void *parent)
+static const char *get_file_path(retro_file_t *file)
 {
-    RG_ASSERT(app && path, "Bad param");
+    static char buffer[RG_PATH_MAX + 1];
+    return get_file_path_r(file, buffer);
+}
 
-    RG_LOGI("Scanning directory %s\n", path);
+static const char *alloc_name(const char *name)
+{
+    static rg_arena_t *names = NULL;
 
-    const char *folder = const_string(path);
-    rg_scandir_t *files = rg_storage_scandir(path, NULL);
+    // Names live as long as the launcher, packing them avoids one heap block per file
+    if (!names)
+        names = rg_arena_create(NAMES_BLOCK_SIZE, MEM_SLOW);
 
-    for (rg_scandir_t *entry = files; entry && entry->is_valid; ++entry)
-    {
-        uint8_t is_valid = false;
-        uint8_t type = 0x00;
+    return rg_arena_strdup(names, name);
+}
 
-        if (entry->is_file)
+static retro_file_t *add_file(retro_app_t *app, const char *name, const char *folder, uint8_t type)
+{
+    if (app->files_count >= app->files_capacity)
+    {
+        size_t new_capacity = RG_MAX(app->files_capacity * 2, 64);
+        retro_file_t *new_buf = realloc(app->files, new_capacity * sizeof(retro_file_t));
+        if (!new_buf)
         {
-            char buffer[RG_PATH_MAX];
-            snprintf(buffer, RG_PATH_MAX, " %s ", rg_extension(entry->name));
-            is_valid = strstr(app->extensions, strtolower(buffer)) != NULL;
-            type = 0x00;
+            RG_LOGW("Ran out of memory, file scanning stopped at %d entries ...\n", (int)app->files_count);
+            return NULL;
         }
-        else if (entry->is_dir)
+        app->files = new_buf;
+        app->files_capacity = new_capacity;
+    }
+
+    retro_file_t *file = &app->files[app->files_count++];
+    *file = (retro_file_t) {
+        .name = name,
+        .folder = folder,
+        .app = (void*)app,
+        .type = type,
+        .is_valid = true,
+    };
+    return file;
+}
+
+static void rom_index_free(rom_index_t *index)
+{
+    free(index->dirs);
+    free(index->files);
+    free(index->strings);
+    memset(index, 0, sizeof(rom_index_t));
+}
+
+static bool rom_index_load(retro_app_t *app, rom_index_t *index)
+{
+    char path[RG_PATH_MAX + 1];
+    bool success = false;
+
+    snprintf(path, sizeof(path), ROM_INDEX_PATH, app->short_name);
+    memset(index, 0, sizeof(rom_index_t));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+
+    rom_index_header_t *hdr = &index->header;
+    if (fread(hdr, sizeof(*hdr), 1, fp) == 1 && hdr->magic == ROM_INDEX_MAGIC)
+    {
+        index->dirs = malloc(hdr->dirs_count * sizeof(rom_index_dir_t) + 1);
+        index->files = malloc(hdr->files_count * sizeof(rom_index_file_t) + 1);
+        index->strings = malloc(hdr->strings_size + 1);
+        success = index->dirs && index->files && index->strings
+            && fread(index->dirs, sizeof(rom_index_dir_t), hdr->dirs_count, fp) == hdr->dirs_count
+            && fread(index->files, sizeof(rom_index_file_t), hdr->files_count, fp) == hdr->files_count
+            && fread(index->strings, 1, hdr->strings_size, fp) == hdr->strings_size;
+        if (success)
+            index->strings[hdr->strings_size] = 0;
+    }
+    fclose(fp);
+
+    if (!success)
+    {
+        RG_LOGW("Index '%s' is invalid, ignoring it\n", path);
+        rom_index_free(index);
+    }
+
+    return success;
+}
+
+static void rom_index_save(retro_app_t *app)
+{
+    char path[RG_PATH_MAX + 1];
+    uint32_t offset = 0;
+
+    snprintf(path, sizeof(path), ROM_INDEX_PATH, app->short_name);
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+    {
+        RG_LOGE("Unable to write index '%s'\n", path);
+        return;
+    }
+
+    // Invalid (deleted) files are still written, their folder's mtime or entry count tells us to rescan it
+    rom_index_header_t header = {ROM_INDEX_MAGIC, app->folders_count, app->files_count, 0};
+    fwrite(&header, sizeof(header), 1, fp);
+
+    for (size_t i = 0; i < app->folders_count; i++)
+    {
+        rom_index_dir_t dir = {offset, app->folders[i].mtime, app->folders[i].entries, app->folders[i].first,
+                               app->folders[i].count};
+        fwrite(&dir, sizeof(dir), 1, fp);
+        offset += strlen(app->folders[i].path) + 1;
+    }
+    for (size_t i = 0; i < app->files_count; i++)
+    {
+        rom_index_file_t file = {offset, app->files[i].type};
+        fwrite(&file, sizeof(file), 1, fp);
+        offset += strlen(app->files[i].name) + 1;
+    }
+    for (size_t i = 0; i < app->folders_count; i++)
+        fwrite(app->folders[i].path, strlen(app->folders[i].path) + 1, 1, fp);
+    for (size_t i = 0; i < app->files_count; i++)
+        fwrite(app->files[i].name, strlen(app->files[i].name) + 1, 1, fp);
+
+    // The size goes in last, a truncated file will fail to load and be rebuilt
+    header.strings_size = offset;
+    fseek(fp, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, fp);
+    fclose(fp);
+
+    RG_LOGI("Saved index '%s' (folders: %d, files: %d)\n", path, (int)app->folders_count, (int)app->files_count);
+}
+
+// Deleting a file doesn't always touch the folder's mtime, make sure it gets rescanned
+static void rom_index_invalidate(retro_app_t *app, const char *folder)
+{
+    if (!app->initialized)
+        return;
+
+    for (size_t i = 0; i < app->folders_count; i++)
+    {
+        if (strcmp(app->folders[i].path, folder) == 0)
+            app->folders[i].mtime = 0;
+    }
+
+    rom_index_save(app);
+}
+
+static const rom_index_dir_t *rom_index_find(rom_index_t *index, const char *path)
+{
+    // Folders are visited in the same order as when the index was written, try the next one first
+    for (size_t i = 0; i < index->header.dirs_count; i++)
+    {
+        size_t pos = (index->next_dir + i) % index->header.dirs_count;
+        const rom_index_dir_t *dir = &index->dirs[pos];
+        if (dir->path < index->header.strings_size && strcmp(index->strings + dir->path, path) == 0)
         {
-            is_valid = true;
-            type = 0xFF;
+            index->next_dir = pos + 1;
+            return dir;
         }
+    }
+    return NULL;
+}
 
-        if (!is_valid)
-            continue;
+static bool scan_folder(retro_app_t *app, const char *path, rom_index_t *index)
+{
+    RG_ASSERT(app && path, "Bad param");
+
+    const char *folder = const_string(path);
+    const rom_index_dir_t *cached = rom_index_find(index, path);
+    size_t first = app->files_count;
+    uint32_t entries = 0;
+    uint32_t mtime = 0;
+    struct stat st;
+
+    if (stat(path, &st) == 0)
+        mtime = st.st_mtime;
 
-        app->files[app->files_count++] = (retro_file_t) {
-            .name = strdup(entry->name),
-            .folder = folder,
-            .app = (void*)app,
-            .type = type,
-            .is_valid = true,
-        };
+    // FAT doesn't always update a folder's mtime when files are copied into it, the entry count
+    // catches most of those and only costs a readdir, without any allocation or extension matching
+    if (cached && mtime && cached->mtime == mtime)
+        entries = rg_storage_count_entries(path);
 
-        if ((app->files_count % 10) == 0)
+    if (cached && mtime && cached->mtime == mtime && cached->entries == entries
+        && cached->first + cached->count <= index->header.files_count)
+    {
+        // Names are copied, so that the index (and its stale entries) can be freed once we're done
+        for (size_t i = cached->first; i < cached->first + cached->count; i++)
         {
-            size_t new_size = (app->files_count + 10 + 2) * sizeof(retro_file_t);
-            retro_file_t *new_buf = realloc(app->files, new_size);
-            if (!new_buf)
-            {
-                RG_LOGW("Ran out of memory, file scanning stopped at %d entries ...\n", app->files_count);
+            const rom_index_file_t *entry = &index->files[i];
+            if (entry->name >= index->header.strings_size)
+                continue;
+            if (!add_file(app, alloc_name(index->strings + entry->name), folder, entry->type))
                 break;
-            }
-            app->files = new_buf;
         }
+    }
+    else
+    {
+        RG_LOGI("Scanning directory %s\n", path);
+
+        rg_scandir_t *files = rg_storage_scandir(path, NULL);
 
-        if (type == 0xFF)
+        entries = 0;
+        for (rg_scandir_t *entry = files; entry && entry->is_valid; ++entry, ++entries)
         {
-            retro_file_t *file = &app->files[app->files_count-1];
-            scan_folder(app, get_file_path(file), file);
+            uint8_t is_valid = false;
+            uint8_t type = 0x00;
+
+            if (entry->is_file)
+            {
+                char buffer[RG_PATH_MAX];
+                snprintf(buffer, RG_PATH_MAX, " %s ", rg_extension(entry->name));
+                is_valid = strstr(app->extensions, strtolower(buffer)) != NULL;
+                type = 0x00;
+            }
+            else if (entry->is_dir)
+            {
+                is_valid = true;
+                type = 0xFF;
+            }
+
+            if (!is_valid)
+                continue;
+
+            if (!add_file(app, alloc_name(entry->name), folder, type))
+                break;
         }
+
+        free(files);
+    }
+
+    if (app->folders_count >= app->folders_capacity)
+    {
+        size_t new_capacity = RG_MAX(app->folders_capacity * 2, 16);
+        void *new_buf = realloc(app->folders, new_capacity * sizeof(*app->folders));
+        RG_ASSERT(new_buf, "alloc failed");
+        app->folders = new_buf;
+        app->folders_capacity = new_capacity;
     }
 
-    free(files);
+    app->folders[app->folders_count++] = (retro_folder_t) {
+        .path = folder,
+        .mtime = mtime,
+        .entries = entries,
+        .first = first,
+        .count = app->files_count - first,
+    };
+
+    return !cached || cached->mtime != mtime || cached->entries != entries || cached->count != app->files_count - first;
+}
+
+static void scan_folders(retro_app_t *app)
+{
+    char path[RG_PATH_MAX + 1];
+    rom_index_t index;
+    bool changed = false;
+
+    if (!rom_index_load(app, &index))
+        changed = true;
+
+    // Breadth first: sub-folders are appended to files[] and visited as we walk over it
+    changed |= scan_folder(app, app->paths.roms, &index);
+
+    for (size_t i = 0; i < app->files_count; i++)
+    {
+        if (app->files[i].type == 0xFF)
+            changed |= scan_folder(app, get_file_path_r(&app->files[i], path), &index);
+    }
+
+    // Folders removed since last time only show up as a different count
+    if (index.header.dirs_count != app->folders_count)
+        changed = true;
+
+    rom_index_free(&index);
+
+    if (changed)
+        rom_index_save(app);
 }
 
 static void application_init(retro_app_t *app)
@@ -117,7 +393,7 @@ static void application_init(retro_app_t *app)
 
     rg_storage_mkdir(app->paths.saves);
     rg_storage_mkdir(app->paths.roms);
-    scan_folder(app, app->paths.roms, 0);
+    scan_folders(app);
 
     app->initialized = true;
 }
@@ -138,28 +414,73 @@ static void application_start(retro_file_t *file, int load_state)
     rg_system_start_app(part, name, path, flags);
 }
 
+static bool crc_cache_insert(uint32_t key, uint32_t crc)
+{
+    size_t index = key & (CRC_CACHE_SLOTS - 1);
+
+    while (crc_cache.slots[index].key && crc_cache.slots[index].key != key)
+        index = (index + 1) & (CRC_CACHE_SLOTS - 1);
+
+    if (!crc_cache.slots[index].key)
+    {
+        if (crc_cache.count >= CRC_CACHE_MAX_ENTRIES)
+            return false;
+        crc_cache.count++;
+    }
+
+    crc_cache.slots[index] = (crc_cache_entry_t){key, crc};
+    return true;
+}
+
+static void crc_cache_compact(void)
+{
+    RG_LOGI("Compacting cache (entries: %d, records: %d)\n", crc_cache.count, crc_cache.records);
+
+    FILE *fp = fopen(CRC_CACHE_PATH, "wb");
+    if (!fp)
+        return;
+
+    uint32_t header[2] = {CRC_CACHE_MAGIC, 0};
+    fwrite(header, sizeof(header), 1, fp);
+    for (size_t i = 0; i < CRC_CACHE_SLOTS; i++)
+    {
+        if (crc_cache.slots[i].key)
+            fwrite(&crc_cache.slots[i], sizeof(crc_cache_entry_t), 1, fp);
+    }
+    fclose(fp);
+
+    crc_cache.records = crc_cache.count;
+}
+
 static void crc_cache_init(void)
 {
-    crc_cache = calloc(1, sizeof(*crc_cache));
-    if (!crc_cache)
+    crc_cache.slots = calloc(CRC_CACHE_SLOTS, sizeof(crc_cache_entry_t));
+    crc_cache.lock = xSemaphoreCreateMutex();
+    if (!crc_cache.slots || !crc_cache.lock)
     {
         RG_LOGE("Failed to allocate crc_cache!\n");
+        free(crc_cache.slots);
+        crc_cache.slots = NULL;
         return;
     }
-    // File format: {magic:U32 count:U32} {{key:U32 crc:U32}, ...}
-    FILE *fp = fopen(RG_BASE_PATH_CACHE"/crc32.bin", "rb");
+
+    // File format: {magic:U32 reserved:U32} {{key:U32 crc:U32}, ...}
+    // Entries are appended as they are computed, the last one for a given key wins.
+    FILE *fp = fopen(CRC_CACHE_PATH, "rb");
     if (fp)
     {
-        fread(crc_cache, 8, 1, fp);
-        if (crc_cache->magic == CRC_CACHE_MAGIC && crc_cache->count <= CRC_CACHE_MAX_ENTRIES)
-        {
-            RG_LOGI("Loaded CRC cache (entries: %d)\n", crc_cache->count);
-            fread(crc_cache->entries, crc_cache->count, 8, fp);
-            crc_cache_dirty = false;
-        }
-        else
+        uint32_t header[2] = {0};
+        crc_cache_entry_t entry;
+
+        if (fread(header, sizeof(header), 1, fp) == 1 && header[0] == CRC_CACHE_MAGIC)
         {
-            crc_cache->count = 0;
+            // A partial trailing record (interrupted write) is simply ignored
+            while (fread(&entry, sizeof(entry), 1, fp) == 1)
+            {
+                crc_cache_insert(entry.key, entry.crc);
+                crc_cache.records++;
+            }
+            RG_LOGI("Loaded CRC cache (entries: %d)\n", crc_cache.count);
         }
         fclose(fp);
     }
@@ -167,136 +488,227 @@ static void crc_cache_init(void)
     {
         rg_storage_mkdir(RG_BASE_PATH_CACHE);
     }
+
+    // Rewrite the file if it's new, from an older version, or mostly stale records
+    if (crc_cache.records == 0 || crc_cache.records > crc_cache.count * 2)
+        crc_cache_compact();
 }
 
-static uint32_t crc_cache_calc_key(retro_file_t *file)
+static uint32_t crc_cache_calc_key(const char *path)
 {
-    // return ((uint64_t)rg_crc32(0, (void *)file->name, strlen(file->name)) << 33 | file->size);
-    // This should be reasonably unique
-    return rg_crc32(0, (void *)file->name, strlen(file->name));
+    const char *name = rg_basename(path);
+    uint32_t key = rg_crc32(0, (void *)name, strlen(name));
+    struct stat st;
+
+    // The name alone isn't enough to notice that a ROM was replaced by a different dump
+    if (stat(path, &st) == 0)
+    {
+        uint32_t meta[2] = {st.st_size, st.st_mtime};
+        key = rg_crc32(key, (void *)meta, sizeof(meta));
+    }
+
+    return key ?: 1; // 0 marks empty slots
 }
 
-static uint32_t crc_cache_lookup(retro_file_t *file)
+static uint32_t crc_cache_lookup(uint32_t key)
 {
-    uint32_t key = crc_cache_calc_key(file);
+    uint32_t crc = 0;
 
-    if (!crc_cache)
+    if (!crc_cache.slots)
         return 0;
 
-    for (int i = 0; i < crc_cache->count; i++)
+    xSemaphoreTake(crc_cache.lock, portMAX_DELAY);
+    for (size_t index = key & (CRC_CACHE_SLOTS - 1); crc_cache.slots[index].key;
+         index = (index + 1) & (CRC_CACHE_SLOTS - 1))
     {
-        if (crc_cache->entries[i].key == key)
-            return crc_cache->entries[i].crc;
+        if (crc_cache.slots[index].key == key)
+        {
+            crc = crc_cache.slots[index].crc;
+            break;
+        }
     }
+    xSemaphoreGive(crc_cache.lock);
 
-    return 0;
+    return crc;
 }
 
-static void crc_cache_save(void)
+static void crc_cache_update(uint32_t key, uint32_t crc)
 {
-    if (!crc_cache || !crc_cache_dirty)
+    if (!crc_cache.slots)
         return;
 
-    RG_LOGI("Saving cache\n");
+    xSemaphoreTake(crc_cache.lock, portMAX_DELAY);
 
-    FILE *fp = fopen(RG_BASE_PATH_CACHE"/crc32.bin", "wb");
-    if (fp)
+    if (!crc_cache.quit && crc_cache_insert(key, crc))
     {
-        size_t minsize = RG_MIN(8 + (crc_cache->count * sizeof(crc_cache->entries[0])), sizeof(*crc_cache));
-        fwrite(crc_cache, minsize, 1, fp);
-        fclose(fp);
-        crc_cache_dirty = false;
+        FILE *fp = fopen(CRC_CACHE_PATH, "ab");
+        if (fp)
+        {
+            fwrite(&(crc_cache_entry_t){key, crc}, sizeof(crc_cache_entry_t), 1, fp);
+            fclose(fp);
+            crc_cache.records++;
+        }
+        RG_LOGI("Adding %08X => %08X to cache (new total: %d)\n", key, crc, crc_cache.count);
     }
+
+    xSemaphoreGive(crc_cache.lock);
 }
 
-static void crc_cache_update(retro_file_t *file)
+// Must be called before leaving the launcher, so that we don't restart in the middle of a write
+static void crc_cache_stop(void)
 {
-    uint32_t key = crc_cache_calc_key(file);
-    size_t index = 0;
-
-    if (!crc_cache)
+    if (!crc_cache.slots)
         return;
 
-    if (crc_cache->count < CRC_CACHE_MAX_ENTRIES)
-        index = crc_cache->count++;
-    else
-        index = rand() % CRC_CACHE_MAX_ENTRIES;
+    xSemaphoreTake(crc_cache.lock, portMAX_DELAY);
+    crc_cache.quit = true;
+    xSemaphoreGive(crc_cache.lock);
+}
+
+static uint32_t compute_file_crc32(const char *path, size_t offset, bool interruptible)
+{
+    uint8_t buffer[0x800];
+    uint32_t crc = 0;
+    size_t count = 0;
+    FILE *fp;
+
+    if (!(fp = fopen(path, "rb")))
+        return 0;
+
+    fseek(fp, offset, SEEK_SET);
+
+    for (int chunk = 1; (count = fread(buffer, 1, sizeof(buffer), fp)) > 0; chunk++)
+    {
+        crc = rg_crc32(crc, buffer, count);
+
+        // Give up on any button press to improve responsiveness
+        if (interruptible && (gui.joystick = rg_input_read_gamepad()))
+            break;
+
+        // Leave some SD bandwidth to the UI when running in the background
+        if (!interruptible && (chunk % 8) == 0)
+            rg_task_delay(1);
+
+        if (crc_cache.quit)
+            break;
+    }
 
-    crc_cache->magic = CRC_CACHE_MAGIC;
-    crc_cache->entries[index].key = key;
-    crc_cache->entries[index].crc = file->checksum;
-    crc_cache_dirty = true;
+    if (!feof(fp))
+        crc = 0;
 
-    RG_LOGI("Adding %08X => %08X to cache (new total: %d)\n",
-        key, file->checksum, crc_cache->count);
+    fclose(fp);
 
-    // crc_cache_save();
+    return crc;
 }
 
-void crc_cache_idle_task(tab_t *tab)
+static void crc_cache_worker(void *arg)
 {
-    if (!crc_cache)
-        return;
+    char path[RG_PATH_MAX + 1];
+    size_t cursors[RG_COUNT(apps)] = {0};
 
-    if (crc_cache->count < CRC_CACHE_MAX_ENTRIES)
+    while (!crc_cache.quit)
     {
-        int start_offset = 0;
-        int remaining = 100;
+        bool busy = false;
 
-        // Find the currently focused app, if any
-        for (int i = 0; i < apps_count; i++)
+        if (crc_cache.wanted.pending)
         {
-            if (tab && tab->arg == apps[i])
-            {
-                start_offset = i;
-                break;
-            }
+            xSemaphoreTake(crc_cache.lock, portMAX_DELAY);
+            strcpy(path, crc_cache.wanted.path);
+            size_t offset = crc_cache.wanted.offset;
+            crc_cache.wanted.pending = false;
+            xSemaphoreGive(crc_cache.lock);
+
+            uint32_t key = crc_cache_calc_key(path);
+            uint32_t crc = crc_cache_lookup(key) ?: compute_file_crc32(path, offset, false);
+            if (crc)
+                crc_cache_update(key, crc);
+
+            xSemaphoreTake(crc_cache.lock, portMAX_DELAY);
+            if (!crc)
+                crc_cache.wanted.failed = key; // Empty, shorter than the offset, or unreadable
+            crc_cache.wanted.done = true;
+            xSemaphoreGive(crc_cache.lock);
+            continue;
         }
 
-        for (int i = 0; i < apps_count && remaining > 0; i++)
+        // Only applications initialized by the UI thread are visited, their file list is then stable
+        for (int i = 0; i < apps_count && !busy; i++)
         {
-            retro_app_t *app = apps[(start_offset + i) % apps_count];
-            int processed = 0;
+            retro_app_t *app = apps[i];
 
-            if (!app->available || app->crc_scan_done)
+            if (!app->available || !app->initialized || app->crc_scan_done)
                 continue;
 
-            gui_set_status(tab, "BUILDING CACHE...", "SCANNING");
-            gui_redraw(); // gui_draw_status(tab);
-
-            if (!app->initialized)
-                application_init(app);
-
-            if ((gui.joystick |= rg_input_read_gamepad()))
-                remaining = -1;
-
-            for (int j = 0; j < app->files_count && remaining > 0; j++)
+            for (size_t *j = &cursors[i]; *j < app->files_count && !crc_cache.wanted.pending && !crc_cache.quit; (*j)++)
             {
-                retro_file_t *file = &app->files[j];
+                retro_file_t *file = &app->files[*j];
 
-                if (file->checksum == 0)
-                    file->checksum = crc_cache_lookup(file);
+                if (file->checksum || file->type == 0xFF)
+                    continue;
 
-                if (file->checksum == 0 && application_get_file_crc32(file))
-                {
-                    processed++;
-                    remaining--;
-                }
+                uint32_t key = crc_cache_calc_key(get_file_path_r(file, path));
+                uint32_t crc = crc_cache_lookup(key);
 
-                // Give up on any button press to improve responsiveness
-                if ((gui.joystick |= rg_input_read_gamepad()))
-                    remaining = -1;
+                if (!crc && (crc = compute_file_crc32(path, app->crc_offset, false)))
+                    crc_cache_update(key, crc);
+
+                // A file that can't be hashed stays at 0, move past it either way
+                file->checksum = crc;
+                (*j)++;
+                busy = true;
+                break;
             }
 
-            if (processed == 0 && remaining != -1)
+            if (!busy && !crc_cache.wanted.pending)
                 app->crc_scan_done = true;
-
-            gui_set_status(tab, "", "");
-            gui_redraw(); // gui_draw_status(tab);
         }
+
+        if (!busy)
+            rg_task_delay(500);
     }
 
-    crc_cache_save();
+    xSemaphoreTake(crc_cache.lock, portMAX_DELAY);
+    crc_cache.worker_running = false;
+    xSemaphoreGive(crc_cache.lock);
+    rg_task_delete(NULL);
+}
+
+void crc_cache_idle_task(tab_t *tab)
+{
+    if (!crc_cache.slots)
+        return;
+
+    // Directory scanning stays on the UI thread, the worker only hashes files
+    for (int i = 0; i < apps_count; i++)
+    {
+        retro_app_t *app = apps[i];
+
+        if (!app->available || app->initialized)
+            continue;
+
+        gui_set_status(tab, "BUILDING CACHE...", "SCANNING");
+        gui_redraw(); // gui_draw_status(tab);
+        application_init(app);
+        gui_set_status(tab, "", "");
+        gui_redraw(); // gui_draw_status(tab);
+        break;
+    }
+
+    // The worker's stack holds a path and compute_file_crc32's 2KB read buffer, on top of stdio
+    if (!crc_cache.worker_running && !crc_cache.quit)
+        crc_cache.worker_running = rg_task_create("crc_cache", &crc_cache_worker, NULL, 8 * 1024, RG_TASK_PRIORITY - 2, -1);
+}
+
+bool crc_cache_take_ready(void)
+{
+    if (!crc_cache.slots)
+        return false;
+
+    xSemaphoreTake(crc_cache.lock, portMAX_DELAY);
+    bool ready = crc_cache.wanted.done;
+    crc_cache.wanted.done = false;
+    xSemaphoreGive(crc_cache.lock);
+    return ready;
 }
 
 static void tab_refresh(tab_t *tab)
@@ -313,6 +725,8 @@ static void tab_refresh(tab_t *tab)
     if (folder == basepath)
         tab->navpath = NULL;
 
+    gui_clear_list(tab);
+
     if (app->files_count > 0)
     {
         gui_resize_list(tab, app->files_count);
@@ -331,14 +745,13 @@ static void tab_refresh(tab_t *tab)
 
             if (file->type == 0xFF)
             {
-                snprintf(item->text, 128, "[%s]", file->name);
-                // snprintf(item->text, 128, "/%s/", file->name);
+                item->text = rg_arena_printf(tab->arena, "[%s]", file->name);
+                // item->text = rg_arena_printf(tab->arena, "/%s/", file->name);
             }
             else
             {
-                snprintf(item->text, 128, "%s", file->name);
-                if ((ext = strrchr(item->text, '.')))
-                    *ext = 0;
+                ext = strrchr(file->name, '.');
+                item->text = rg_arena_printf(tab->arena, "%.*s", ext ? (int)(ext - file->name) : 127, file->name);
             }
 
             item->arg = file;
@@ -351,12 +764,12 @@ static void tab_refresh(tab_t *tab)
     if (items_count == 0)
     {
         gui_resize_list(tab, 6);
-        sprintf(tab->listbox.items[0].text, "Welcome to Retro-Go!");
-        sprintf(tab->listbox.items[1].text, " ");
-        sprintf(tab->listbox.items[2].text, "Place roms in folder: %s", rg_relpath(app->paths.roms));
-        sprintf(tab->listbox.items[3].text, "With file extension: %s", app->extensions);
-        sprintf(tab->listbox.items[4].text, " ");
-        sprintf(tab->listbox.items[5].text, "You can hide this tab in the menu");
+        tab->listbox.items[0].text = "Welcome to Retro-Go!";
+        tab->listbox.items[1].text = " ";
+        tab->listbox.items[2].text = rg_arena_printf(tab->arena, "Place roms in folder: %s", rg_relpath(app->paths.roms));
+        tab->listbox.items[3].text = rg_arena_printf(tab->arena, "With file extension: %s", app->extensions);
+        tab->listbox.items[4].text = " ";
+        tab->listbox.items[5].text = "You can hide this tab in the menu";
         tab->listbox.cursor = 4;
     }
 
@@ -405,7 +818,7 @@ static void event_handler(gui_event_t event, tab_t *tab)
     }
     else if (event == TAB_IDLE)
     {
-        if (file && !tab->preview && gui.browse && gui.idle_counter == 1)
+        if (file && !tab->preview && gui.browse && (gui.idle_counter == 1 || crc_cache_take_ready()))
             gui_load_preview(tab);
         else if ((gui.idle_counter % 100) == 0)
             crc_cache_idle_task(tab);
@@ -475,55 +888,61 @@ bool application_path_to_file(const char *path, retro_file_t *file)
 
 bool application_get_file_crc32(retro_file_t *file)
 {
-    uint8_t buffer[0x800];
-    uint32_t crc_tmp = 0;
-    int count = -1;
-    FILE *fp;
-
     if (file == NULL)
         return false;
 
     if (file->checksum > 0)
         return true;
 
-    if ((crc_tmp = crc_cache_lookup(file)))
-    {
-        file->checksum = crc_tmp;
-    }
-    else
+    const char *path = get_file_path(file);
+    uint32_t key = crc_cache_calc_key(path);
+
+    if (!(file->checksum = crc_cache_lookup(key)))
     {
         tab_t *tab = gui_get_current_tab();
         gui_set_status(tab, NULL, "CRC32...");
         gui_redraw(); // gui_draw_status(tab);
 
-        if ((fp = fopen(get_file_path(file), "rb")))
-        {
-            fseek(fp, file->app->crc_offset, SEEK_SET);
+        if ((file->checksum = compute_file_crc32(path, file->app->crc_offset, true)))
+            crc_cache_update(key, file->checksum);
 
-            while (count != 0)
-            {
-                // Give up on any button press to improve responsiveness
-                if ((gui.joystick = rg_input_read_gamepad()))
-                    break;
+        gui_set_status(tab, NULL, "");
+        gui_redraw(); // gui_draw_status(tab);
+    }
 
-                count = fread(buffer, 1, sizeof(buffer), fp);
-                crc_tmp = rg_crc32(crc_tmp, buffer, count);
-            }
+    return file->checksum > 0;
+}
 
-            if (feof(fp))
-            {
-                file->checksum = crc_tmp;
-                crc_cache_update(file);
-            }
+bool application_peek_file_crc32(retro_file_t *file)
+{
+    if (file == NULL)
+        return false;
 
-            fclose(fp);
-        }
+    if (file->checksum > 0)
+        return true;
 
-        gui_set_status(tab, NULL, "");
-        gui_redraw(); // gui_draw_status(tab);
+    const char *path = get_file_path(file);
+    uint32_t key = crc_cache_calc_key(path);
+
+    if ((file->checksum = crc_cache_lookup(key)))
+        return true;
+
+    // The worker already gave up on it, queuing it again would reload the preview forever
+    if (key == crc_cache.wanted.failed)
+        return false;
+
+    // Let the worker hash it, crc_cache_take_ready() tells the UI when to try again
+    if (crc_cache.worker_running)
+    {
+        xSemaphoreTake(crc_cache.lock, portMAX_DELAY);
+        snprintf(crc_cache.wanted.path, sizeof(crc_cache.wanted.path), "%s", path);
+        crc_cache.wanted.offset = file->app->crc_offset;
+        crc_cache.wanted.pending = true;
+        xSemaphoreGive(crc_cache.lock);
+        return false;
     }
 
-    return file->checksum > 0;
+    return application_get_file_crc32(file);
 }
 
 static void show_file_info(retro_file_t *file)
@@ -566,6 +985,7 @@ static void show_file_info(retro_file_t *file)
             {
                 if (unlink(get_file_path(file)) == 0)
                 {
+                    rom_index_invalidate(file->app, file->folder);
                     bookmark_remove(BOOK_TYPE_FAVORITE, file);
                     bookmark_remove(BOOK_TYPE_RECENT, file);
                     file->is_valid = false;
@@ -609,7 +1029,8 @@ void application_show_file_menu(retro_file_t *file, bool advanced)
             break;
         /* fallthrough */
     case 1:
-        crc_cache_save();
+        crc_cache_stop();
+        thumbnails_stop();
         gui_save_config();
         application_start(file, slot);
         break;
@@ -620,6 +1041,15 @@ void application_show_file_menu(retro_file_t *file, bool advanced)
             unlink(savestate->slots[slot].preview);
             unlink(savestate->slots[slot].file);
         }
+        // The base state is only useful as long as some slot refers to it
+        free(savestate);
+        savestate = rg_emu_get_states(rom_path, 4);
+        if (savestate->used == 0)
+        {
+            char *base_path = rg_emu_get_path(RG_PATH_SAVE_STATE + RG_SAVESTATE_BASE_SLOT, rom_path);
+            unlink(base_path);
+            free(base_path);
+        }
         if (has_sram && rg_gui_confirm("Delete sram file?", 0, 0))
         {
             unlink(sram_path);
@@ -670,11 +1100,30 @@ static void application(const char *desc, const char *name, const char *exts, co
     snprintf(app->paths.roms, RG_PATH_MAX, RG_BASE_PATH_ROMS "/%s", app->short_name);
     app->available = rg_system_find_app(app->partition);
     app->files = calloc(10, sizeof(retro_file_t));
+    app->files_capacity = 10;
     app->crc_offset = crc_offset;
 
     gui_add_tab(app->short_name, app->description, app, event_handler);
 }
 
+// Neither the mtime nor the entry count changes when a file is replaced from a PC, this picks those up
+void applications_rescan(void)
+{
+    char path[RG_PATH_MAX + 1];
+
+    crc_cache_stop();
+    thumbnails_stop();
+
+    for (int i = 0; i < apps_count; i++)
+    {
+        snprintf(path, sizeof(path), ROM_INDEX_PATH, apps[i]->short_name);
+        unlink(path);
+    }
+
+    gui_save_config();
+    rg_system_restart();
+}
+
 void applications_init(void)
 {
     application("Nintendo Entertainment System", "nes", "nes fc fds nsf", "nofrendo-go", 16);
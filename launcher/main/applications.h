@@ -18,6 +18,15 @@ typedef struct
     retro_app_t *app;
 } retro_file_t;
 
+typedef struct
+{
+    const char *path;
+    uint32_t mtime;
+    uint32_t entries; // Directory entries, hidden files excluded
+    size_t first; // Range of app->files that are in this folder
+    size_t count;
+} retro_folder_t;
+
 typedef struct retro_app_s
 {
     char description[64];
@@ -32,6 +41,10 @@ typedef struct retro_app_s
     size_t crc_offset;
     retro_file_t *files;
     size_t files_count;
+    size_t files_capacity;
+    retro_folder_t *folders;
+    size_t folders_count;
+    size_t folders_capacity;
     bool use_crc_covers;
     bool crc_scan_done;
     bool initialized;
@@ -41,7 +54,10 @@ typedef struct retro_app_s
 typedef struct tab_s tab_t;
 
 void applications_init(void);
+void applications_rescan(void);
 void application_show_file_menu(retro_file_t *file, bool simplified);
 bool application_get_file_crc32(retro_file_t *file);
+bool application_peek_file_crc32(retro_file_t *file);
 bool application_path_to_file(const char *path, retro_file_t *out_file);
 void crc_cache_idle_task(tab_t *tab);
+bool crc_cache_take_ready(void);
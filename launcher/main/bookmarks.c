@@ -36,7 +36,7 @@ static void event_handler(gui_event_t event, tab_t *tab)
     }
     else if (event == TAB_IDLE)
     {
-        if (file && !tab->preview && gui.browse && gui.idle_counter == 1)
+        if (file && !tab->preview && gui.browse && (gui.idle_counter == 1 || crc_cache_take_ready()))
             gui_load_preview(tab);
         else if ((gui.idle_counter % 100) == 0)
             crc_cache_idle_task(tab);
@@ -62,6 +62,7 @@ static void tab_refresh(book_type_t book_type)
         return;
 
     memset(&tab->status, 0, sizeof(tab->status));
+    gui_clear_list(tab);
 
     if (book->count)
     {
@@ -73,7 +74,7 @@ static void tab_refresh(book_type_t book_type)
             {
                 listbox_item_t *listitem = &tab->listbox.items[items_count++];
                 const char *type = file->app ? file->app->short_name : "n/a";
-                snprintf(listitem->text, 128, "[%-3s] %.100s", type, file->name);
+                listitem->text = rg_arena_printf(tab->arena, "[%-3s] %.100s", type, file->name);
                 listitem->arg = file;
                 listitem->id = i;
             }
@@ -86,11 +87,11 @@ static void tab_refresh(book_type_t book_type)
     if (items_count == 0)
     {
         gui_resize_list(tab, 6);
-        sprintf(tab->listbox.items[0].text, "Welcome to Retro-Go!");
-        sprintf(tab->listbox.items[1].text, " ");
-        sprintf(tab->listbox.items[2].text, "You have no %s games", book->name);
-        sprintf(tab->listbox.items[3].text, " ");
-        sprintf(tab->listbox.items[4].text, "You can hide this tab in the menu");
+        tab->listbox.items[0].text = "Welcome to Retro-Go!";
+        tab->listbox.items[1].text = " ";
+        tab->listbox.items[2].text = rg_arena_printf(tab->arena, "You have no %s games", book->name);
+        tab->listbox.items[3].text = " ";
+        tab->listbox.items[4].text = "You can hide this tab in the menu";
         tab->listbox.cursor = 3;
     }
 }
@@ -1,4 +1,6 @@
 #include <rg_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <stdio.h>
 #include <string.h>
 #include <dirent.h>
@@ -6,6 +8,7 @@
 #include <unistd.h>
 
 #include "applications.h"
+#include "thumbnails.h"
 #include "utils.h"
 #include "gui.h"
 
@@ -13,6 +16,8 @@
 #define LOGO_WIDTH          (46)
 #define PREVIEW_HEIGHT      ((int)(gui.height * 0.70f))
 #define PREVIEW_WIDTH       ((int)(gui.width * 0.50f))
+#define PREFETCH_DISTANCE   (2) // Neighbours warmed on each side of the cursor
+#define LIST_ARENA_SIZE     (0x4000)
 
 static const theme_t gui_themes[] = {
     {{C_TRANSPARENT, C_GRAY, C_TRANSPARENT, C_WHITE}},
@@ -24,6 +29,25 @@ const int gui_themes_count = RG_COUNT(gui_themes);
 
 retro_gui_t gui;
 
+// What's needed to find the preview of a file, copied so that the worker doesn't touch the lists
+typedef struct
+{
+    char rom_path[RG_PATH_MAX + 1];
+    char covers[RG_PATH_MAX];
+    uint32_t checksum;
+    bool use_crc_covers;
+} preview_source_t;
+
+static struct
+{
+    SemaphoreHandle_t lock;
+    preview_source_t queue[PREFETCH_DISTANCE * 2];
+    uint32_t order;
+    int count;
+    int next;
+    bool running;
+} prefetch;
+
 #define SETTING_SELECTED_TAB    "SelectedTab"
 #define SETTING_START_SCREEN    "StartScreen"
 #define SETTING_STARTUP_MODE    "StartupMode"
@@ -53,6 +77,7 @@ void gui_init(void)
     // Always enter browse mode when leaving an emulator
     gui.browse = gui.start_screen == 2 || (!gui.start_screen && rg_system_get_app()->bootType == RG_RST_RESTART);
     gui_set_theme(rg_settings_get_string(NS_GLOBAL, SETTING_THEME, NULL));
+    thumbnails_init();
 }
 
 void gui_event(gui_event_t event, tab_t *tab)
@@ -73,9 +98,10 @@ tab_t *gui_add_tab(const char *name, const char *desc, void *arg, void *event_ha
     tab->initialized = false;
     tab->enabled = !rg_settings_get_number(NS_APP, SETTING_HIDE_TAB(name), 0);
     tab->arg = arg;
+    tab->arena = rg_arena_create(LIST_ARENA_SIZE, MEM_SLOW);
     tab->listbox = (listbox_t){
-        .items = calloc(10, sizeof(listbox_item_t)),
-        .capacity = 10,
+        .items = NULL,
+        .capacity = 0,
         .length = 0,
         .cursor = 0,
         .sort_mode = SORT_TEXT_ASC,
@@ -260,6 +286,15 @@ void gui_sort_list(tab_t *tab)
     qsort((void*)tab->listbox.items, tab->listbox.length, sizeof(listbox_item_t), comp[sort_mode]);
 }
 
+// Drops the items and everything allocated in the tab's arena, the cursor is preserved
+void gui_clear_list(tab_t *tab)
+{
+    rg_arena_reset(tab->arena);
+    tab->listbox.items = NULL;
+    tab->listbox.capacity = 0;
+    tab->listbox.length = 0;
+}
+
 void gui_resize_list(tab_t *tab, int new_size)
 {
     listbox_t *list = &tab->listbox;
@@ -267,17 +302,21 @@ void gui_resize_list(tab_t *tab, int new_size)
     if (new_size == list->length)
         return;
 
-    // Always grow but only shrink past a certain threshold
-    if (new_size >= list->capacity || list->capacity - new_size >= 20)
+    // The array lives in the arena, a grown copy leaves the old one there until gui_clear_list()
+    if (new_size > list->capacity)
     {
-        list->capacity = new_size + 10;
-        list->items = realloc(list->items, list->capacity * sizeof(listbox_item_t));
+        int capacity = RG_MAX(new_size, list->capacity * 2);
+        listbox_item_t *items = rg_arena_alloc(tab->arena, capacity * sizeof(listbox_item_t));
+        if (list->length > 0)
+            memcpy(items, list->items, list->length * sizeof(listbox_item_t));
+        list->items = items;
+        list->capacity = capacity;
         RG_LOGI("Resized list '%s' from %d to %d items (new capacity: %d)\n",
             tab->name, list->length, new_size, list->capacity);
     }
 
-    for (int i = list->length; i < list->capacity; i++)
-        memset(&list->items[i], 0, sizeof(listbox_item_t));
+    for (int i = list->length; i < new_size; i++)
+        list->items[i] = (listbox_item_t){.text = ""};
 
     list->length = new_size;
 
@@ -431,7 +470,7 @@ void gui_draw_list(tab_t *tab)
     {
         int idx = list->cursor + i - (lines / 2);
         int selected = idx == list->cursor;
-        char *label = (idx >= 0 && idx < list->length) ? list->items[idx].text : "";
+        const char *label = (idx >= 0 && idx < list->length) ? list->items[idx].text : "";
         top += rg_gui_draw_text(0, top, gui.width, label, fg[selected], bg[selected], 0).height;
     }
 }
@@ -446,6 +485,132 @@ void gui_set_preview(tab_t *tab, rg_image_t *preview)
     tab->preview = preview;
 }
 
+static uint32_t get_preview_order(bool *show_missing_cover)
+{
+    switch (gui.show_preview)
+    {
+        case PREVIEW_MODE_COVER_SAVE:
+            *show_missing_cover = true;
+            return 0x4123;
+        case PREVIEW_MODE_SAVE_COVER:
+            *show_missing_cover = true;
+            return 0x1234;
+        case PREVIEW_MODE_COVER_ONLY:
+            *show_missing_cover = true;
+            return 0x0123;
+        case PREVIEW_MODE_SAVE_ONLY:
+            *show_missing_cover = false;
+            return 0x0004;
+        default:
+            *show_missing_cover = false;
+            return 0x0000;
+    }
+}
+
+static void get_preview_source(const retro_file_t *file, preview_source_t *src)
+{
+    const retro_app_t *app = file->app;
+    snprintf(src->rom_path, sizeof(src->rom_path), "%s/%s", file->folder, file->name);
+    snprintf(src->covers, sizeof(src->covers), "%s", app->paths.covers);
+    src->checksum = file->checksum;
+    src->use_crc_covers = app->use_crc_covers;
+}
+
+static bool get_preview_path(const preview_source_t *src, int type, char *path)
+{
+    if (type == 0x1 && src->use_crc_covers && src->checksum) // Game cover (old format)
+        sprintf(path, "%s/%X/%08X.art", src->covers, src->checksum >> 28, src->checksum);
+    else if (type == 0x2 && src->use_crc_covers && src->checksum) // Game cover (png)
+        sprintf(path, "%s/%X/%08X.png", src->covers, src->checksum >> 28, src->checksum);
+    else if (type == 0x3) // Game cover (based on filename)
+        sprintf(path, "%s/%s.png", src->covers, rg_basename(src->rom_path));
+    else if (type == 0x4) // Save state screenshot (png)
+    {
+        rg_emu_state_t *state = rg_emu_get_states(src->rom_path, 4);
+        if (state->lastused)
+            strcpy(path, state->lastused->preview);
+        else if (state->latest)
+            strcpy(path, state->latest->preview);
+        else
+            strcpy(path, "/lazy/invalid/path");
+        free(state);
+    }
+    else
+        return false;
+    return true;
+}
+
+static void prefetch_worker(void *arg)
+{
+    char path[RG_PATH_MAX + 1];
+    preview_source_t src;
+
+    while (true)
+    {
+        bool found = false;
+        uint32_t order = 0;
+
+        // Stay out of the way while the user scrolls and while the selected preview loads
+        if (gui.idle_counter >= 2)
+        {
+            xSemaphoreTake(prefetch.lock, portMAX_DELAY);
+            if ((found = prefetch.next < prefetch.count))
+            {
+                src = prefetch.queue[prefetch.next++];
+                order = prefetch.order;
+            }
+            xSemaphoreGive(prefetch.lock);
+        }
+
+        if (!found)
+        {
+            rg_task_delay(100);
+            continue;
+        }
+
+        // Same search as gui_load_preview(), stopping at the first image found
+        for (bool done = false; order && !done; order >>= 4)
+        {
+            rg_image_t *img = NULL;
+            if (get_preview_path(&src, order & 0xF, path))
+                done = thumbnail_load(path, PREVIEW_WIDTH, PREVIEW_HEIGHT, &img);
+            rg_image_free(img);
+        }
+    }
+}
+
+static void prefetch_neighbours(tab_t *tab, uint32_t order)
+{
+    const listbox_t *list = &tab->listbox;
+    int count = 0;
+
+    if (!prefetch.lock && !(prefetch.lock = xSemaphoreCreateMutex()))
+        return;
+
+    if (!prefetch.running)
+        prefetch.running = rg_task_create("gui_prefetch", &prefetch_worker, NULL, 6 * 1024, RG_TASK_PRIORITY - 2, -1);
+
+    xSemaphoreTake(prefetch.lock, portMAX_DELAY);
+    for (int i = 1; i <= PREFETCH_DISTANCE; i++)
+    {
+        // Nearest first, and the direction we're more likely to scroll in (down) before up
+        int indexes[2] = {list->cursor + i, list->cursor - i};
+        for (int j = 0; j < 2; j++)
+        {
+            if (indexes[j] < 0 || indexes[j] >= list->length)
+                continue;
+            const retro_file_t *file = list->items[indexes[j]].arg;
+            if (!file || file->type == 0xFF)
+                continue;
+            get_preview_source(file, &prefetch.queue[count++]);
+        }
+    }
+    prefetch.order = order;
+    prefetch.count = count;
+    prefetch.next = 0;
+    xSemaphoreGive(prefetch.lock);
+}
+
 void gui_load_preview(tab_t *tab)
 {
     listbox_item_t *item = gui_get_selected_item(tab);
@@ -458,33 +623,18 @@ void gui_load_preview(tab_t *tab)
     if (!item || !item->arg)
         return;
 
-    switch (gui.show_preview)
-    {
-        case PREVIEW_MODE_COVER_SAVE:
-            show_missing_cover = true;
-            order = 0x4123;
-            break;
-        case PREVIEW_MODE_SAVE_COVER:
-            show_missing_cover = true;
-            order = 0x1234;
-            break;
-        case PREVIEW_MODE_COVER_ONLY:
-            show_missing_cover = true;
-            order = 0x0123;
-            break;
-        case PREVIEW_MODE_SAVE_ONLY:
-            show_missing_cover = false;
-            order = 0x0004;
-            break;
-        default:
-            show_missing_cover = false;
-            order = 0x0000;
-    }
+    order = get_preview_order(&show_missing_cover);
 
     retro_file_t *file = item->arg;
     retro_app_t *app = file->app;
+    preview_source_t src;
     uint32_t errors = 0;
 
+    get_preview_source(file, &src);
+
+    if (order)
+        prefetch_neighbours(tab, order);
+
     while (order && !tab->preview)
     {
         int type = order & 0xF;
@@ -498,30 +648,17 @@ void gui_load_preview(tab_t *tab)
         if (file->missing_cover & (1 << type))
             continue;
 
-        if (type == 0x1 && app->use_crc_covers && application_get_file_crc32(file)) // Game cover (old format)
-            sprintf(path, "%s/%X/%08X.art", app->paths.covers, file->checksum >> 28, file->checksum);
-        else if (type == 0x2 && app->use_crc_covers && application_get_file_crc32(file)) // Game cover (png)
-            sprintf(path, "%s/%X/%08X.png", app->paths.covers, file->checksum >> 28, file->checksum);
-        else if (type == 0x3) // Game cover (based on filename)
-            sprintf(path, "%s/%s.png", app->paths.covers, file->name);
-        else if (type == 0x4) // Save state screenshot (png)
-        {
-            sprintf(path, "%s/%s", file->folder, file->name);
-            rg_emu_state_t *state = rg_emu_get_states(path, 4);
-            if (state->lastused)
-                strcpy(path, state->lastused->preview);
-            else if (state->latest)
-                strcpy(path, state->latest->preview);
-            else
-                strcpy(path, "/lazy/invalid/path");
-            free(state);
-        }
-        else
+        if ((type == 0x1 || type == 0x2) && app->use_crc_covers && application_peek_file_crc32(file))
+            src.checksum = file->checksum;
+
+        if (!get_preview_path(&src, type, path))
             continue;
 
-        if (access(path, F_OK) == 0)
+        // The thumbnail cache returns the image already scaled for the preview area
+        rg_image_t *img = NULL;
+        if (thumbnail_load(path, PREVIEW_WIDTH, PREVIEW_HEIGHT, &img))
         {
-            gui_set_preview(tab, rg_image_load_from_file(path, 0));
+            gui_set_preview(tab, img);
             if (!tab->preview)
                 errors++;
         }
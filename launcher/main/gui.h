@@ -1,5 +1,6 @@
 #pragma once
 
+#include <rg_arena.h>
 #include <rg_gui.h>
 #include <stdbool.h>
 
@@ -49,7 +50,7 @@ typedef struct {
 } theme_t;
 
 typedef struct {
-    char text[128];
+    const char *text; // Usually allocated in the tab's arena
     int enabled;
     int id;
     void *arg;
@@ -95,6 +96,7 @@ typedef struct tab_s {
     void *arg;
     const char *navpath;
     listbox_t listbox;
+    rg_arena_t *arena; // Holds the list, it's reset by gui_clear_list()
     rg_image_t *preview;
     gui_event_handler_t event_handler;
 } tab_t;
@@ -131,6 +133,7 @@ const rg_image_t *gui_get_image(const char *type, const char *subtype);
 
 void gui_sort_list(tab_t *tab);
 void gui_scroll_list(tab_t *tab, scroll_mode_t mode, int arg);
+void gui_clear_list(tab_t *tab);
 void gui_resize_list(tab_t *tab, int new_size);
 listbox_item_t *gui_get_selected_item(tab_t *tab);
 
@@ -20,6 +20,7 @@ static void event_handler(gui_event_t event, tab_t *tab)
         rg_scandir_t *files;
 
         memset(&tab->status, 0, sizeof(tab->status));
+        gui_clear_list(tab);
         gui_resize_list(tab, 1);
 
         tab->listbox.items[0] = (listbox_item_t){
@@ -39,8 +40,8 @@ static void event_handler(gui_event_t event, tab_t *tab)
                 {
                     gui_resize_list(tab, items_count + 1);
                     listbox_item_t *item = &tab->listbox.items[items_count++];
-                    strcpy(item->text, entry->name);
-                    item->arg = strdup(item->text); // This could be relocated
+                    item->text = rg_arena_strdup(tab->arena, entry->name);
+                    item->arg = (void *)item->text; // Stays put when the list grows
                     item->enabled = true;
                 }
             }
@@ -53,9 +54,9 @@ static void event_handler(gui_event_t event, tab_t *tab)
         if (items_count < 2)
         {
             gui_resize_list(tab, 6);
-            sprintf(tab->listbox.items[0].text, "Welcome to Retro-Go!");
-            sprintf(tab->listbox.items[2].text, "Place themes in folder: %s", rg_relpath(themes_path));
-            sprintf(tab->listbox.items[4].text, "You can hide this tab in the menu");
+            tab->listbox.items[0].text = "Welcome to Retro-Go!";
+            tab->listbox.items[2].text = rg_arena_printf(tab->arena, "Place themes in folder: %s", rg_relpath(themes_path));
+            tab->listbox.items[4].text = "You can hide this tab in the menu";
             tab->listbox.cursor = 3;
         }
     }
@@ -0,0 +1,174 @@
+#include <rg_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "thumbnails.h"
+
+#define THUMB_CACHE_MAGIC 0x31424D54 // "TMB1"
+#define THUMB_CACHE_PATH RG_BASE_PATH_CACHE "/thumbs"
+
+// File format: {header} {RGB565 pixels, width * height}
+typedef struct __attribute__((__packed__))
+{
+    uint32_t magic;
+    uint32_t src_size;
+    uint32_t src_mtime;
+    uint16_t width;
+    uint16_t height;
+} thumb_header_t;
+
+static struct
+{
+    SemaphoreHandle_t lock; // Serializes cache accesses between the UI and the prefetch worker
+    bool quit;
+} thumbs;
+
+
+void thumbnails_init(void)
+{
+    thumbs.lock = xSemaphoreCreateMutex();
+    rg_storage_mkdir(THUMB_CACHE_PATH);
+}
+
+// Must be called before leaving the launcher, so that we don't restart in the middle of a write
+void thumbnails_stop(void)
+{
+    if (!thumbs.lock)
+        return;
+
+    xSemaphoreTake(thumbs.lock, portMAX_DELAY);
+    thumbs.quit = true;
+    xSemaphoreGive(thumbs.lock);
+}
+
+static void get_cache_path(const char *path, int max_width, int max_height, char *buffer)
+{
+    // Entries are named after what they were made from, a changed source simply overwrites its entry
+    uint32_t box[2] = {max_width, max_height};
+    uint32_t key = rg_crc32(0, (void *)path, strlen(path));
+    key = rg_crc32(key, (void *)box, sizeof(box));
+    sprintf(buffer, "%s/%X/%08X.bin", THUMB_CACHE_PATH, key >> 28, key);
+}
+
+static rg_image_t *cache_read(const char *cache_path, const struct stat *src)
+{
+    thumb_header_t header;
+    rg_image_t *img = NULL;
+    FILE *fp;
+
+    if (!(fp = fopen(cache_path, "rb")))
+        return NULL;
+
+    if (fread(&header, sizeof(header), 1, fp) == 1 && header.magic == THUMB_CACHE_MAGIC
+        && header.src_size == (uint32_t)src->st_size && header.src_mtime == (uint32_t)src->st_mtime
+        && (img = rg_image_alloc(header.width, header.height)))
+    {
+        // A truncated entry (interrupted write) is treated as a miss and rebuilt
+        size_t count = (size_t)header.width * header.height;
+        if (fread(img->data, 2, count, fp) != count)
+        {
+            rg_image_free(img);
+            img = NULL;
+        }
+    }
+
+    fclose(fp);
+    return img;
+}
+
+static void cache_write(const char *cache_path, const struct stat *src, const rg_image_t *img)
+{
+    char folder[RG_PATH_MAX + 1];
+    FILE *fp;
+
+    if (!(fp = fopen(cache_path, "wb")))
+    {
+        snprintf(folder, sizeof(folder), "%s", cache_path);
+        *strrchr(folder, '/') = 0;
+        rg_storage_mkdir(folder);
+        if (!(fp = fopen(cache_path, "wb")))
+            return;
+    }
+
+    thumb_header_t header = {
+        .magic = THUMB_CACHE_MAGIC,
+        .src_size = src->st_size,
+        .src_mtime = src->st_mtime,
+        .width = img->width,
+        .height = img->height,
+    };
+    size_t count = (size_t)img->width * img->height;
+    bool success = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(img->data, 2, count, fp) == count;
+
+    // A partial entry would only be rejected on every read, don't leave it behind (card full)
+    if (fclose(fp) != 0 || !success)
+    {
+        RG_LOGW("Unable to write '%s'\n", cache_path);
+        unlink(cache_path);
+    }
+}
+
+// Returns false if the image doesn't exist. Otherwise *img is the image already scaled to fit
+// max_width x max_height, or NULL if it couldn't be decoded.
+bool thumbnail_load(const char *path, int max_width, int max_height, rg_image_t **img)
+{
+    RG_ASSERT(path && img, "Bad param");
+
+    char cache_path[RG_PATH_MAX + 1];
+    struct stat st;
+
+    *img = NULL;
+
+    if (stat(path, &st) != 0)
+        return false;
+
+    get_cache_path(path, max_width, max_height, cache_path);
+
+    if (!thumbs.lock)
+    {
+        *img = rg_image_load_from_file(path, 0);
+        return true;
+    }
+
+    xSemaphoreTake(thumbs.lock, portMAX_DELAY);
+    *img = cache_read(cache_path, &st);
+    xSemaphoreGive(thumbs.lock);
+
+    if (*img)
+        return true;
+
+    // Decoding is the slow part, it's done without the lock so the other side isn't held up
+    rg_image_t *full = rg_image_load_from_file(path, 0);
+    if (full)
+    {
+        int width = RG_MIN(full->width, max_width);
+        int height = RG_MIN(full->height, max_height);
+        if (width != full->width || height != full->height)
+        {
+            *img = rg_image_copy_resampled(full, width, height, 0);
+            rg_image_free(full);
+        }
+        else
+        {
+            *img = full;
+        }
+    }
+
+    if (*img)
+    {
+        xSemaphoreTake(thumbs.lock, portMAX_DELAY);
+        if (!thumbs.quit)
+        {
+            RG_LOGI("Caching thumbnail of '%s' (%dx%d)\n", path, (*img)->width, (*img)->height);
+            cache_write(cache_path, &st, *img);
+        }
+        xSemaphoreGive(thumbs.lock);
+    }
+
+    return true;
+}
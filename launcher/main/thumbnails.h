@@ -0,0 +1,8 @@
+#pragma once
+
+#include <rg_system.h>
+#include <stdbool.h>
+
+void thumbnails_init(void);
+void thumbnails_stop(void);
+bool thumbnail_load(const char *path, int max_width, int max_height, rg_image_t **img);
@@ -4,27 +4,17 @@
 
 #include "utils.h"
 
-static const char **strings;
-static size_t strings_count;
+static rg_strpool_t *strings;
 
 const char *const_string(const char *str)
 {
     if (!str)
         return NULL;
 
-    // To do : use hashmap or something faster
-    for (int i = 0; i < strings_count; i++)
-        if (strcmp(strings[i], str) == 0)
-            return strings[i];
+    if (!strings)
+        strings = rg_strpool_create(0x1000, MEM_SLOW);
 
-    str = strdup(str);
-
-    strings = realloc(strings, (strings_count + 1) * sizeof(char*));
-    RG_ASSERT(strings && str, "alloc failed");
-
-    strings[strings_count++] = str;
-
-    return str;
+    return rg_strpool_intern(strings, str);
 }
 
 char *strtolower(char *str)
@@ -88,7 +88,6 @@ void nes_emulate(bool draw)
     if (draw && nes.blit_func)
     {
         nes.blit_func(nes.vidbuf);
-        nes.vidbuf = nes.framebuffers[nes.vidbuf == nes.framebuffers[0]];
     }
 
     apu_emulate();
@@ -240,7 +239,6 @@ void nes_reset(bool hard_reset)
     input_reset();
     nes6502_reset();
 
-    nes.vidbuf = nes.framebuffers[0];
     nes.scanline = 241;
     nes.cycles = 0;
 
@@ -259,8 +257,6 @@ void nes_shutdown(void)
     apu_shutdown();
     nes6502_shutdown();
     rom_free();
-    free(nes.framebuffers[0]);
-    free(nes.framebuffers[1]);
 }
 
 /* Initialize NES CPU, hardware, etc. */
@@ -273,12 +269,6 @@ nes_t *nes_init(nes_type_t system, int sample_rate, bool stereo)
     nes.system = system;
     nes.refresh_rate = 60;
 
-    /* Framebuffers */
-    nes.framebuffers[0] = rg_alloc(NES_SCREEN_PITCH * NES_SCREEN_HEIGHT, MEM_FAST);
-    nes.framebuffers[1] = rg_alloc(NES_SCREEN_PITCH * NES_SCREEN_HEIGHT, MEM_FAST);
-    if (NULL == nes.framebuffers[0] || NULL == nes.framebuffers[1])
-        goto _fail;
-
     /* memory */
     nes.mem = mem_init();
     if (NULL == nes.mem)
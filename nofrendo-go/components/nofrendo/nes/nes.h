@@ -76,8 +76,7 @@ typedef struct
     mapper_t *mapper;
     input_t *input;
 
-    /* Video buffer */
-    uint8 *framebuffers[2];
+    /* Video buffer, owned by the frontend (which may swap it from blit_func) */
     uint8 *vidbuf;
 
     /* Misc */
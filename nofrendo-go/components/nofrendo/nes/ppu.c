@@ -25,7 +25,7 @@
 
 /* PPU access */
 #define PPU_MEM_READ(x)      (ppu.page[(x) >> 10][(x)])
-#define PPU_MEM_WRITE(x,v)   (ppu.page[(x) >> 10][(x)] = (v))
+#define PPU_MEM_WRITE(x,v)   (ppu.page[(x) >> 10][(x)] = (v), chr_touch(x))
 
 /* Background (color 0) and solid sprite pixel flags */
 #define BG_TRANS             (0x80)
@@ -42,9 +42,30 @@
 
 #define INLINE static inline __attribute__((__always_inline__))
 
+/* Decoded pattern cache size, in 1KB CHR pages */
+#define CHR_CACHE_ENTRIES    16
+
 /* the NES PPU */
 static ppu_t ppu;
 
+/* Decoded pattern cache: each 1KB CHR page is decoded on demand into rows of
+** 2 bits per pixel, leftmost pixel in the low bits. Entries are tagged with the
+** memory they were decoded from, so a bank switched back in (MMC2/MMC4 flip
+** banks several times per frame) is still decoded. CHR-RAM writes invalidate
+** the tile they land in.
+*/
+typedef struct
+{
+   const uint8 *source;
+   uint64_t valid;      /* one bit per tile */
+   uint32 last_used;
+   uint16 rows[64 * 8];
+} chr_cache_t;
+
+static chr_cache_t *chr_cache;
+static chr_cache_t *chr_slots[8];
+static uint32 chr_clock;
+
 
 #ifndef PPU_MEM_READ
 INLINE uint8 PPU_MEM_READ(uint32 x)
@@ -56,11 +77,112 @@ INLINE uint8 PPU_MEM_READ(uint32 x)
 }
 #endif
 
+static void chr_bind(int slot)
+{
+   const uint8 *source = ppu.page[slot] + (slot * 0x400);
+   chr_cache_t *victim = NULL;
+
+   if (chr_slots[slot] && chr_slots[slot]->source == source)
+      return;
+
+   chr_slots[slot] = NULL;
+
+   for (int i = 0; i < CHR_CACHE_ENTRIES; i++)
+   {
+      chr_cache_t *entry = &chr_cache[i];
+      bool bound = false;
+
+      if (entry->source == source)
+      {
+         victim = entry;
+         break;
+      }
+
+      for (int j = 0; j < 8; j++)
+         bound |= (chr_slots[j] == entry);
+
+      if (!bound && (!victim || entry->last_used < victim->last_used))
+         victim = entry;
+   }
+
+   if (victim->source != source)
+   {
+      victim->source = source;
+      victim->valid = 0;
+   }
+
+   victim->last_used = ++chr_clock;
+   chr_slots[slot] = victim;
+}
+
+INLINE void chr_touch(uint32 address)
+{
+   if (address < 0x2000)
+      chr_slots[address >> 10]->valid &= ~(1ULL << ((address >> 4) & 0x3F));
+}
+
+static void chr_decode(chr_cache_t *entry, uint32 tile)
+{
+   const uint8 *data = entry->source + (tile << 4);
+   uint16 *rows = entry->rows + (tile << 3);
+
+   for (int y = 0; y < 8; y++)
+   {
+      uint32 pat1 = data[y], pat2 = data[y + 8];
+      uint32 row = 0;
+
+      for (int x = 0; x < 8; x++)
+         row |= (((pat1 >> (7 - x)) & 1) | (((pat2 >> (7 - x)) & 1) << 1)) << (x * 2);
+
+      rows[y] = row;
+   }
+
+   entry->valid |= (1ULL << tile);
+}
+
+/* Address must point to the first plane of a tile row ($0000-$1FFF) */
+INLINE uint32 chr_getrow(uint32 address)
+{
+   chr_cache_t *entry = chr_slots[address >> 10];
+   uint32 tile = (address >> 4) & 0x3F;
+
+   if (!(entry->valid & (1ULL << tile)))
+      chr_decode(entry, tile);
+
+   return entry->rows[((address & 0x3F0) >> 1) | (address & 7)];
+}
+
+INLINE uint32 chr_fliprow(uint32 row)
+{
+   row = ((row >> 8) | (row << 8)) & 0xFFFF;
+   row = ((row >> 4) & 0x0F0F) | ((row & 0x0F0F) << 4);
+   return ((row >> 2) & 0x3333) | ((row & 0x3333) << 2);
+}
+
+/* Forget everything decoded, for when CHR memory changed behind our back */
+void ppu_refresh(void)
+{
+   memset(chr_slots, 0, sizeof(chr_slots));
+
+   for (int i = 0; i < CHR_CACHE_ENTRIES; i++)
+   {
+      chr_cache[i].source = NULL;
+      chr_cache[i].valid = 0;
+   }
+
+   for (int i = 0; i < 8; i++)
+   {
+      if (ppu.page[i])
+         chr_bind(i);
+   }
+}
+
 void ppu_setcontext(ppu_t *src_ppu)
 {
    ASSERT(src_ppu);
    ppu = *src_ppu;
    ppu_setnametables(ppu.nt1, ppu.nt2, ppu.nt3, ppu.nt4);
+   ppu_refresh();
 }
 
 void ppu_getcontext(ppu_t *dest_ppu)
@@ -73,7 +195,10 @@ void ppu_setpage(int size, int page_num, uint8 *location)
 {
    while (size--)
    {
-      ppu.page[page_num++] = location;
+      ppu.page[page_num] = location;
+      if (page_num < 8)
+         chr_bind(page_num);
+      page_num++;
    }
 }
 
@@ -365,62 +490,20 @@ void ppu_setvreadfunc(ppu_vreadfunc_t func)
 }
 
 /* rendering routines */
-INLINE uint32 get_patpix(uint32 tile_addr)
-{
-   uint8 pat1 = PPU_MEM_READ(tile_addr);
-   uint8 pat2 = PPU_MEM_READ(tile_addr + 8);
-   return ((pat2 & 0xAA) << 8) | ((pat2 & 0x55) << 1)
-        | ((pat1 & 0xAA) << 7) | (pat1 & 0x55);
-}
-
-INLINE void build_tile_colors(bool flip, uint32 pattern, uint8 *colors)
-{
-   /* swap pixels around if our tile is flipped */
-   if (flip)
-   {
-      colors[7] = (pattern >> 14) & 3;
-      colors[6] = (pattern >> 6) & 3;
-      colors[5] = (pattern >> 12) & 3;
-      colors[4] = (pattern >> 4) & 3;
-      colors[3] = (pattern >> 10) & 3;
-      colors[2] = (pattern >> 2) & 3;
-      colors[1] = (pattern >> 8) & 3;
-      colors[0] = pattern & 3;
-   }
-   else
-   {
-      colors[0] = (pattern >> 14) & 3;
-      colors[1] = (pattern >> 6) & 3;
-      colors[2] = (pattern >> 12) & 3;
-      colors[3] = (pattern >> 4) & 3;
-      colors[4] = (pattern >> 10) & 3;
-      colors[5] = (pattern >> 2) & 3;
-      colors[6] = (pattern >> 8) & 3;
-      colors[7] = pattern & 3;
-   }
-}
 
 /* we render a scanline of graphics first so we know exactly
 ** where the sprite 0 strike is going to occur (in terms of
 ** cpu cycles), using the relation that 3 pixels == 1 cpu cycle
 */
-INLINE void check_strike(uint8 *surface, uint8 attrib, uint32 pattern)
+INLINE void check_strike(uint8 *surface, uint32 row)
 {
-   uint8 colors[8];
-
    /* Flag already set */
    if (ppu.strikeflag)
       return;
 
-   /* sprite is 100% transparent */
-   if (0 == pattern)
-      return;
-
-   build_tile_colors(attrib & OAMF_HFLIP, pattern, colors);
-
-   for (int i = 0; i < 8; i++)
+   for (int i = 0; row; i++, row >>= 2)
    {
-      if (colors[i] && (!surface || BG_SOLID(surface[i])))
+      if ((row & 3) && (!surface || BG_SOLID(surface[i])))
       {
          /* 3 pixels per cpu cycle */
          ppu.strike_cycle = nes6502_getcycles() + (i / 3);
@@ -430,50 +513,36 @@ INLINE void check_strike(uint8 *surface, uint8 attrib, uint32 pattern)
    }
 }
 
-INLINE void draw_bgtile(uint8 *surface, uint32 pattern, const uint8 *colors)
+INLINE void draw_bgtile(uint8 *surface, uint32 row, const uint8 *colors)
 {
-   *surface++ = colors[(pattern >> 14) & 3];
-   *surface++ = colors[(pattern >> 6) & 3];
-   *surface++ = colors[(pattern >> 12) & 3];
-   *surface++ = colors[(pattern >> 4) & 3];
-   *surface++ = colors[(pattern >> 10) & 3];
-   *surface++ = colors[(pattern >> 2) & 3];
-   *surface++ = colors[(pattern >> 8) & 3];
-   *surface   = colors[pattern & 3];
+   surface[0] = colors[row & 3];
+   surface[1] = colors[(row >> 2) & 3];
+   surface[2] = colors[(row >> 4) & 3];
+   surface[3] = colors[(row >> 6) & 3];
+   surface[4] = colors[(row >> 8) & 3];
+   surface[5] = colors[(row >> 10) & 3];
+   surface[6] = colors[(row >> 12) & 3];
+   surface[7] = colors[row >> 14];
 }
 
-INLINE void draw_oamtile(uint8 *surface, uint8 attrib, uint32 pattern, const uint8 *col_tbl)
+INLINE void draw_oamtile(uint8 *surface, uint8 attrib, uint32 row, const uint8 *col_tbl)
 {
-   uint8 colors[8];
-
-   /* sprite is 100% transparent */
-   if (0 == pattern)
-      return;
-
-   build_tile_colors(attrib & OAMF_HFLIP, pattern, colors);
-
-   /* draw the character */
+   /* the loops stop at the last opaque pixel */
    if (attrib & OAMF_BEHIND)
    {
-      if (colors[0])  surface[0] = SP_PIXEL | (BG_CLEAR(surface[0]) ? col_tbl[colors[0]] : surface[0]);
-      if (colors[1])  surface[1] = SP_PIXEL | (BG_CLEAR(surface[1]) ? col_tbl[colors[1]] : surface[1]);
-      if (colors[2])  surface[2] = SP_PIXEL | (BG_CLEAR(surface[2]) ? col_tbl[colors[2]] : surface[2]);
-      if (colors[3])  surface[3] = SP_PIXEL | (BG_CLEAR(surface[3]) ? col_tbl[colors[3]] : surface[3]);
-      if (colors[4])  surface[4] = SP_PIXEL | (BG_CLEAR(surface[4]) ? col_tbl[colors[4]] : surface[4]);
-      if (colors[5])  surface[5] = SP_PIXEL | (BG_CLEAR(surface[5]) ? col_tbl[colors[5]] : surface[5]);
-      if (colors[6])  surface[6] = SP_PIXEL | (BG_CLEAR(surface[6]) ? col_tbl[colors[6]] : surface[6]);
-      if (colors[7])  surface[7] = SP_PIXEL | (BG_CLEAR(surface[7]) ? col_tbl[colors[7]] : surface[7]);
+      for (; row; row >>= 2, surface++)
+      {
+         if (row & 3)
+            *surface = SP_PIXEL | (BG_CLEAR(*surface) ? col_tbl[row & 3] : *surface);
+      }
    }
    else
    {
-      if (colors[0] && SP_CLEAR(surface[0]))  surface[0] = SP_PIXEL | col_tbl[colors[0]];
-      if (colors[1] && SP_CLEAR(surface[1]))  surface[1] = SP_PIXEL | col_tbl[colors[1]];
-      if (colors[2] && SP_CLEAR(surface[2]))  surface[2] = SP_PIXEL | col_tbl[colors[2]];
-      if (colors[3] && SP_CLEAR(surface[3]))  surface[3] = SP_PIXEL | col_tbl[colors[3]];
-      if (colors[4] && SP_CLEAR(surface[4]))  surface[4] = SP_PIXEL | col_tbl[colors[4]];
-      if (colors[5] && SP_CLEAR(surface[5]))  surface[5] = SP_PIXEL | col_tbl[colors[5]];
-      if (colors[6] && SP_CLEAR(surface[6]))  surface[6] = SP_PIXEL | col_tbl[colors[6]];
-      if (colors[7] && SP_CLEAR(surface[7]))  surface[7] = SP_PIXEL | col_tbl[colors[7]];
+      for (; row; row >>= 2, surface++)
+      {
+         if ((row & 3) && SP_CLEAR(*surface))
+            *surface = SP_PIXEL | col_tbl[row & 3];
+      }
    }
 }
 
@@ -507,7 +576,7 @@ INLINE void ppu_renderbg(uint8 *vidbuf)
          ppu.latchfunc(ppu.bg_base, tile_index);
 
       /* Fetch tile and draw it */
-      draw_bgtile(bmp_ptr, get_patpix(bg_offset + (tile_index << 4)), ppu.palette + col_high);
+      draw_bgtile(bmp_ptr, chr_getrow(bg_offset + (tile_index << 4)), ppu.palette + col_high);
       bmp_ptr += 8;
 
       x_tile++;
@@ -598,21 +667,26 @@ INLINE void ppu_renderoam(uint8 *vidbuf, int scanline, bool draw)
          tile_addr += y_offset;
       }
 
+      /* Fetch tile row, leftmost pixel first */
+      uint32 row = chr_getrow(tile_addr);
+      if (sprite->attr & OAMF_HFLIP)
+         row = chr_fliprow(row);
+
       /* Check for a strike on sprite 0 if strike flag isn't set */
       if (sprite_num == 0 && !ppu.strikeflag)
       {
-         check_strike(draw ? vidbuf + sprite->x_loc : NULL, sprite->attr, get_patpix(tile_addr));
+         check_strike(draw ? vidbuf + sprite->x_loc : NULL, row);
       }
 
       /* If we don't draw to buffer then we're done after sprite 0 */
       if (!draw)
          return;
 
-      /* Fetch tile and draw it */
+      /* Draw it */
       draw_oamtile(
          vidbuf + sprite->x_loc,
          sprite->attr,
-         get_patpix(tile_addr),
+         row,
          ppu.palette + 16 + ((sprite->attr & 3) << 2));
 
       /* maximum of 8 sprites per scanline */
@@ -732,12 +806,18 @@ void ppu_reset()
    ppu.latch = 0;
    ppu.vram_accessible = true;
    ppu.last_scanline = NES_SCANLINES - 1;
+
+   ppu_refresh();
 }
 
 ppu_t *ppu_init(void)
 {
    memset(&ppu, 0, sizeof(ppu_t));
 
+   if (!chr_cache)
+      chr_cache = rg_alloc(CHR_CACHE_ENTRIES * sizeof(chr_cache_t), MEM_FAST);
+   memset(chr_slots, 0, sizeof(chr_slots));
+
    ppu_setopt(PPU_DRAW_BACKGROUND, true);
    ppu_setopt(PPU_DRAW_SPRITES, true);
    ppu_setopt(PPU_LIMIT_SPRITES, true);
@@ -747,7 +827,9 @@ ppu_t *ppu_init(void)
 
 void ppu_shutdown(void)
 {
-   //
+   free(chr_cache);
+   chr_cache = NULL;
+   memset(chr_slots, 0, sizeof(chr_slots));
 }
 
 
@@ -825,7 +907,7 @@ static void draw_sprite(uint8 *bmp, int x, int y, uint8 tile_num, uint8 attrib)
       if (line == 8)
          tile_addr += 8;
 
-      draw_bgtile(vid, get_patpix(tile_addr), ppu.palette + 16 + col_high);
+      draw_bgtile(vid, chr_getrow(tile_addr), ppu.palette + 16 + col_high);
       //draw_oamtile(vid, attrib, data_ptr[0], data_ptr[8], ppu.palette + 16 + col_high);
 
       tile_addr++;
@@ -252,14 +252,13 @@ rom_t *rom_loadmem(uint8 *data, size_t size)
 /* Load a ROM from file */
 rom_t *rom_loadfile(const char *filename)
 {
-   uint8 *data = NULL;
-   long size = 0;
+   rg_file_view_t *view;
+   uint8 *data;
 
    if (!filename)
       return NULL;
 
-   FILE *fp = fopen(filename, "rb");
-   if (!fp)
+   if (!(view = rg_storage_view_open(filename)))
    {
       MESSAGE_ERROR("ROM: Unable to open file '%s'\n", filename);
       return NULL;
@@ -267,29 +266,20 @@ rom_t *rom_loadfile(const char *filename)
 
    MESSAGE_INFO("ROM: Loading file '%s'\n", filename);
 
-   fseek(fp, 0, SEEK_END);
-   size = ftell(fp);
-   fseek(fp, 0, SEEK_SET);
-
-   if (size < 16 || size > 0x200000)
+   if (view->size < 16 || view->size > 0x200000)
    {
       MESSAGE_ERROR("ROM: File size error\n");
    }
-   else if ((data = malloc(size)) == NULL)
-   {
-      MESSAGE_ERROR("ROM: Memory allocation failed\n");
-   }
-   else if (fread(data, size, 1, fp) != 1)
+   else if ((data = rg_storage_view_data(view, MEM_ANY)) == NULL)
    {
       MESSAGE_ERROR("ROM: Read error\n");
    }
-   else if (rom_loadmem(data, size) == NULL)
+   else if (rom_loadmem(data, view->size) == NULL)
    {
       MESSAGE_ERROR("ROM: Load error\n");
    }
    else
    {
-      fclose(fp);
       if (rom.system == SYS_UNKNOWN)
       {
          if (strstr(filename, "(E)")
@@ -298,8 +288,8 @@ rom_t *rom_loadfile(const char *filename)
             || strstr(filename, "(Australia)"))
             rom.system = SYS_NES_PAL;
       }
-      rom.flags |= ROM_FLAG_FREE_DATA;
       // This is fine, rom_loadmem zeroes `rom`.
+      rom.view = view;
       strncpy(rom.filename, filename, sizeof(rom.filename) - 1);
       #ifdef USE_SRAM_FILE
          rom_loadsram();
@@ -307,8 +297,7 @@ rom_t *rom_loadfile(const char *filename)
       return &rom;
    }
 
-   fclose(fp);
-   free(data);
+   rg_storage_view_close(view);
    return NULL;
 }
 
@@ -318,9 +307,10 @@ void rom_free(void)
 #ifdef USE_SRAM_FILE
    rom_savesram();
 #endif
-   if (rom.flags & ROM_FLAG_FREE_DATA)
+   if (rom.view)
    {
-      free(rom.data_ptr);
+      rg_storage_view_close(rom.view);
+      rom.view = NULL;
       rom.data_ptr = NULL;
    }
    free(rom.prg_ram);
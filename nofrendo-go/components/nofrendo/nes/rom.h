@@ -32,7 +32,6 @@
 #define ROM_FLAG_TRAINER        0x04
 #define ROM_FLAG_BATTERY        0x02
 #define ROM_FLAG_VERTICAL       0x01
-#define ROM_FLAG_FREE_DATA      0x100
 #define ROM_FLAG_FDS_DISK       0x200
 
 #define ROM_PRG_BANK_SIZE       0x2000
@@ -81,6 +80,7 @@ typedef struct
 
    uint8 *data_ptr; // Top of our allocation
    size_t data_len; // Size of our allocation
+   rg_file_view_t *view; // File backing data_ptr, if we own it
 
    uint8 *prg_rom;
    uint8 *chr_rom;
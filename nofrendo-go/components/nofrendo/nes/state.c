@@ -123,7 +123,7 @@ int state_save(const char* fn)
    nes_t *machine = nes_getptr();
    FILE *file;
 
-   if (!(file = fopen(fn, "wb")))
+   if (!(file = rg_savestate_fopen(fn, "wb")))
    {
        MESSAGE_ERROR("state_save: file '%s' could not be opened.\n", fn);
        return -1; //goto _error;
@@ -295,7 +295,7 @@ int state_load(const char* fn)
    nes_t *machine = nes_getptr();
    FILE *file;
 
-   if (!(file = fopen(fn, "rb")))
+   if (!(file = rg_savestate_fopen(fn, "rb")))
    {
        MESSAGE_ERROR("state_load: file '%s' could not be opened.\n", fn);
        return -1; //goto _error;
@@ -468,6 +468,9 @@ int state_load(const char* fn)
    /* close file, we're done */
    fclose(file);
 
+   /* CHR-RAM was overwritten, drop decoded patterns */
+   ppu_refresh();
+
    MESSAGE_INFO("state_load: Game restored\n");
 
    return 0;
@@ -475,5 +478,6 @@ int state_load(const char* fn)
 _error:
    MESSAGE_ERROR("state_load: Load failed!\n");
    fclose(file);
+   ppu_refresh();
    return -1;
 }
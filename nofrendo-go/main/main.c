@@ -6,16 +6,13 @@
 #define AUDIO_SAMPLE_RATE   (32000)
 #define AUDIO_BUFFER_LENGTH (AUDIO_SAMPLE_RATE / 50 + 1)
 
-static rg_video_update_t updates[2];
-static rg_video_update_t *currentUpdate = &updates[0];
-static rg_video_update_t *previousUpdate = NULL;
+static rg_video_update_t *currentUpdate;
 
 static rg_app_t *app;
 
 static uint32_t joystick1;
 static uint32_t *localJoystick = &joystick1;
 
-static int fullFrame = 0;
 static int overscan = true;
 static int autocrop = 0;
 static int palette = 0;
@@ -81,7 +78,7 @@ static void event_handler(int event, void *arg)
 
 static bool screenshot_handler(const char *filename, int width, int height)
 {
-	return rg_display_save_frame(filename, currentUpdate, width, height);
+	return rg_display_save_frame(filename, rg_display_last_frame(), width, height);
 }
 
 static bool save_state_handler(const char *filename)
@@ -112,10 +109,18 @@ static void set_display_mode(void)
     crop_h = (autocrop) ? 8 : 0;
     // int crop_h = (autocrop == 2) || (autocrop == 1 && nes->ppu->left_bg_counter > 210) ? 8 : 0;
 
-    int width = NES_SCREEN_WIDTH - (crop_h * 2);
-    int height = NES_SCREEN_HEIGHT - (crop_v * 2);
+    // The swapchain owns the buffers, so the overdraw margins are cropped along with the borders
+    rg_display_set_source_format(NES_SCREEN_PITCH, NES_SCREEN_HEIGHT, NES_SCREEN_OVERDRAW + crop_h, crop_v,
+                                 NES_SCREEN_PITCH, RG_PIXEL_PAL565_BE);
+}
 
-    rg_display_set_source_format(width, height, 0, 0, NES_SCREEN_PITCH, RG_PIXEL_PAL565_BE);
+static void blit_screen(uint8 *bmp)
+{
+    // A rolling average should be used for autocrop == 1, it causes jitter in some games...
+    // int crop_h = (autocrop == 2) || (autocrop == 1 && nes->ppu->left_bg_counter > 210) ? 8 : 0;
+    rg_display_present_frame(currentUpdate);
+    currentUpdate = rg_display_acquire_frame();
+    nes->vidbuf = currentUpdate->buffer;
 }
 
 static void build_palette(int n)
@@ -123,12 +128,10 @@ static void build_palette(int n)
     uint16_t *pal = nofrendo_buildpalette(n, 16);
     for (int i = 0; i < 256; i++)
     {
-        uint16_t color = (pal[i] >> 8) | ((pal[i]) << 8);
-        updates[0].palette[i] = color;
-        updates[1].palette[i] = color;
+        // Acquired frames inherit the palette once this frame is presented
+        currentUpdate->palette[i] = (pal[i] >> 8) | ((pal[i]) << 8);
     }
     free(pal);
-    previousUpdate = NULL;
 }
 
 static rg_gui_event_t sprite_limit_cb(rg_gui_option_t *option, rg_gui_event_t event)
@@ -196,8 +199,11 @@ static rg_gui_event_t palette_update_cb(rg_gui_option_t *option, rg_gui_event_t
         palette = pal;
         rg_settings_set_number(NS_APP, SETTING_PALETTE, pal);
         build_palette(pal);
-        rg_display_queue_update(currentUpdate, NULL);
-        rg_display_queue_update(currentUpdate, NULL);
+        // Redraw the frame on screen with the new palette
+        rg_video_update_t *lastUpdate = rg_display_last_frame();
+        if (lastUpdate && lastUpdate != currentUpdate)
+            memcpy(currentUpdate->buffer, lastUpdate->buffer, NES_SCREEN_PITCH * NES_SCREEN_HEIGHT);
+        blit_screen(currentUpdate->buffer);
         rg_task_delay(50);
     }
 
@@ -212,15 +218,6 @@ static rg_gui_event_t palette_update_cb(rg_gui_option_t *option, rg_gui_event_t
 }
 
 
-static void blit_screen(uint8 *bmp)
-{
-    // A rolling average should be used for autocrop == 1, it causes jitter in some games...
-    // int crop_h = (autocrop == 2) || (autocrop == 1 && nes->ppu->left_bg_counter > 210) ? 8 : 0;
-    currentUpdate->buffer = NES_SCREEN_GETPTR(bmp, crop_h, crop_v);
-    fullFrame = rg_display_queue_update(currentUpdate, previousUpdate) == RG_UPDATE_FULL;
-    previousUpdate = currentUpdate;
-    currentUpdate = &updates[currentUpdate == &updates[0]];
-}
 
 static void nsf_draw_overlay(void)
 {
@@ -262,11 +259,15 @@ void app_main(void)
     autocrop = rg_settings_get_number(NS_APP, SETTING_AUTOCROP, 0);
     palette = rg_settings_get_number(NS_APP, SETTING_PALETTE, 0);
 
+    rg_display_swapchain_init(2, NES_SCREEN_PITCH * NES_SCREEN_HEIGHT, MEM_FAST, RG_DISPLAY_DROP_NONE);
+    currentUpdate = rg_display_acquire_frame();
+
     nes = nes_init(SYS_DETECT, AUDIO_SAMPLE_RATE, true);
     if (!nes)
     {
         RG_PANIC("Init failed.");
     }
+    nes->vidbuf = currentUpdate->buffer;
 
     int ret = nes_insertcart(app->romPath, RG_BASE_PATH_SYSTEM "/fds_bios.bin");
     if (ret == -1)
@@ -296,7 +297,7 @@ void app_main(void)
         rg_emu_load_state(app->saveSlot);
     }
 
-    int skipFrames = 0;
+    int nsfFrames = 0;
     int nsfPlayer = nes->cart->mapper_number == 31;
 
     while (true)
@@ -315,7 +316,7 @@ void app_main(void)
         }
 
         int64_t startTime = rg_system_timer();
-        bool drawFrame = !skipFrames && !nsfPlayer;
+        bool drawFrame = rg_system_should_draw() && !nsfPlayer;
         int buttons = 0;
 
         if (joystick1 & RG_KEY_START)  buttons |= NES_PAD_START;
@@ -349,23 +350,8 @@ void app_main(void)
 
         int elapsed = rg_system_timer() - startTime;
 
-        if (skipFrames == 0)
-        {
-            int frameTime = 1000000 / (nes->refresh_rate * app->speed);
-            if (elapsed > frameTime - 2000) // It takes about 2ms to copy the audio buffer
-                skipFrames = (elapsed + frameTime / 2) / frameTime;
-            else if (drawFrame && fullFrame) // This could be avoided when scaling != full
-                skipFrames = 1;
-            else if (nsfPlayer)
-                skipFrames = 10, nsf_draw_overlay();
-
-            if (app->speed > 1.f) // This is a hack until we account for audio speed...
-                skipFrames += (int)app->speed;
-        }
-        else if (skipFrames > 0)
-        {
-            skipFrames--;
-        }
+        if (nsfPlayer && nsfFrames++ % 10 == 0)
+            nsf_draw_overlay();
 
         // Tick before submitting audio/syncing
         rg_system_tick(elapsed);
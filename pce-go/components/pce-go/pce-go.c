@@ -103,37 +103,31 @@ LoadCard(const char *name)
 
 	MESSAGE_INFO("Opening %s...\n", name);
 
-	FILE *fp = fopen(name, "rb");
+	if (PCE.ROM_VIEW != NULL) {
+		rg_storage_view_close(PCE.ROM_VIEW);
+		PCE.ROM_VIEW = NULL;
+	}
 
-	if (fp == NULL)
+	PCE.ROM_VIEW = rg_storage_view_open(name);
+
+	if (PCE.ROM_VIEW == NULL)
 	{
 		MESSAGE_ERROR("Failed to open %s!\n", name);
 		return -1;
 	}
 
-	if (PCE.ROM != NULL) {
-		free(PCE.ROM);
-	}
-
-	// find file size
-	fseek(fp, 0, SEEK_END);
-	fsize = ftell(fp);
+	fsize = PCE.ROM_VIEW->size;
 	offset = fsize & 0x1fff;
 
-	// read ROM
-	PCE.ROM = malloc(fsize);
+	// read ROM (mapped directly when the platform allows it)
+	PCE.ROM = rg_storage_view_data(PCE.ROM_VIEW, MEM_ANY);
 
 	if (PCE.ROM == NULL)
 	{
-		MESSAGE_ERROR("Failed to allocate ROM buffer!\n");
+		MESSAGE_ERROR("Failed to load ROM!\n");
 		return -1;
 	}
 
-	fseek(fp, 0, SEEK_SET);
-	fread(PCE.ROM, 1, fsize, fp);
-
-	fclose(fp);
-
 	PCE.ROM_SIZE = (fsize - offset) / 0x2000;
 	PCE.ROM_DATA = PCE.ROM + offset;
 	PCE.ROM_CRC = crc32_le(0, PCE.ROM, fsize);
@@ -330,7 +324,7 @@ LoadState(const char *name)
 	block_hdr_t block;
 	int ret = -1;
 
-	FILE *fp = fopen(name, "rb");
+	FILE *fp = rg_savestate_fopen(name, "rb");
 	if (fp == NULL)
 		return -1;
 
@@ -389,7 +383,7 @@ SaveState(const char *name)
 
 	int ret = -1;
 
-	FILE *fp = fopen(name, "wb");
+	FILE *fp = rg_savestate_fopen(name, "wb");
 	if (fp == NULL)
 		return -1;
 
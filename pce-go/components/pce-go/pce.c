@@ -94,7 +94,8 @@ pce_term(void)
 {
 	free(PCE.ExRAM);
 	PCE.ExRAM = NULL;
-	free(PCE.ROM);
+	rg_storage_view_close(PCE.ROM_VIEW);
+	PCE.ROM_VIEW = NULL;
 	PCE.ROM = NULL;
 	free(PCE.NULLRAM);
 	PCE.NULLRAM = NULL;
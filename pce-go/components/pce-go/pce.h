@@ -132,6 +132,7 @@ typedef struct {
 
 	// ROM memory
 	uint8_t *ROM, *ROM_DATA;
+	rg_file_view_t *ROM_VIEW;
 
 	// ROM size in 0x2000 blocks
 	uint16_t ROM_SIZE;
@@ -24,12 +24,11 @@ static int current_height = 0;
 static int current_width = 0;
 static int overscan = false;
 static int downsample = false;
-static int skipFrames = 0;
-static uint8_t *framebuffers[2];
+static int current_offset = 0;
+static bool drawFrame = true;
 
 static bool emulationPaused = false; // This should probably be a mutex
-static rg_video_update_t updates[2];
-static rg_video_update_t *currentUpdate = &updates[0];
+static rg_video_update_t *currentUpdate;
 static rg_app_t *app;
 
 static const char *SETTING_AUDIOTYPE = "audiotype";
@@ -70,45 +69,31 @@ uint8_t *osd_gfx_framebuffer(int width, int height)
         RG_LOGI("Resolution changed to: %dx%d\n", width, height);
 
         // PCE-GO needs 16 columns of scratch space + horizontally center
-        int offset_center = 16 + ((XBUF_WIDTH - width) / 2);
-        updates[0].buffer = framebuffers[0] + offset_center;
-        updates[1].buffer = framebuffers[1] + offset_center;
+        current_offset = 16 + ((XBUF_WIDTH - width) / 2);
 
-        rg_display_set_source_format(width, height, 0, 0, XBUF_WIDTH, RG_PIXEL_PAL565_BE);
+        // The swapchain owns the buffers, so the offset is expressed as a crop
+        rg_display_set_source_format(width + current_offset * 2, height, current_offset, 0, XBUF_WIDTH,
+                                     RG_PIXEL_PAL565_BE);
 
         current_width = width;
         current_height = height;
     }
-    return skipFrames ? NULL : currentUpdate->buffer;
+    return drawFrame ? (uint8_t *)currentUpdate->buffer + current_offset : NULL;
 }
 
 void osd_vsync(void)
 {
     static int64_t lasttime, prevtime;
 
-    if (skipFrames == 0)
+    if (drawFrame)
     {
-        rg_video_update_t *previousUpdate = &updates[currentUpdate == &updates[0]];
-        rg_display_queue_update(currentUpdate, NULL);
-        currentUpdate = previousUpdate;
-    }
-
-    // See if we need to skip a frame to keep up
-    if (skipFrames == 0)
-    {
-        if (app->speed > 1.f)
-            skipFrames = app->speed * 2.5f;
-        else
-            skipFrames = 1;
-    }
-    else if (skipFrames > 0)
-    {
-        skipFrames--;
+        rg_display_present_frame(currentUpdate);
+        currentUpdate = rg_display_acquire_frame();
     }
 
     int32_t frameTime = 1000000 / 60 / app->speed;
     int64_t curtime = rg_system_timer();
-    int32_t sleep = frameTime - (curtime - lasttime);
+    int32_t sleep = app->benchmark ? 0 : frameTime - (curtime - lasttime);
 
     if (sleep > frameTime)
     {
@@ -118,12 +103,9 @@ void osd_vsync(void)
     {
         usleep(sleep);
     }
-    else if (sleep < -(frameTime / 2))
-    {
-        skipFrames++;
-    }
 
     rg_system_tick(curtime - prevtime);
+    drawFrame = rg_system_should_draw();
 
     prevtime = rg_system_timer();
     lasttime += frameTime;
@@ -179,9 +161,7 @@ static void audioTask(void *arg)
 
 static bool screenshot_handler(const char *filename, int width, int height)
 {
-    // We must use previous update because at this point current has been wiped.
-    rg_video_update_t *previousUpdate = &updates[currentUpdate == &updates[0]];
-    return rg_display_save_frame(filename, previousUpdate, width, height);
+    return rg_display_save_frame(filename, rg_display_last_frame(), width, height);
 }
 
 static bool save_state_handler(const char *filename)
@@ -221,8 +201,8 @@ void app_main(void)
 
     app = rg_system_init(AUDIO_SAMPLE_RATE, &handlers, options);
 
-    framebuffers[0] = rg_alloc(XBUF_WIDTH * XBUF_HEIGHT, MEM_FAST);
-    framebuffers[1] = rg_alloc(XBUF_WIDTH * XBUF_HEIGHT, MEM_FAST);
+    rg_display_swapchain_init(2, XBUF_WIDTH * XBUF_HEIGHT, MEM_FAST, RG_DISPLAY_DROP_NONE);
+    currentUpdate = rg_display_acquire_frame();
 
     overscan = rg_settings_get_number(NS_APP, SETTING_OVERSCAN, 1);
     downsample = rg_settings_get_number(NS_APP, SETTING_AUDIOTYPE, 0);
@@ -230,9 +210,8 @@ void app_main(void)
     uint16_t *palette = PalettePCE(16);
     for (int i = 0; i < 256; i++)
     {
-        uint16_t color = (palette[i] << 8) | (palette[i] >> 8);
-        updates[0].palette[i] = color;
-        updates[1].palette[i] = color;
+        // Acquired frames inherit the palette once this frame is presented
+        currentUpdate->palette[i] = (palette[i] << 8) | (palette[i] >> 8);
     }
     free(palette);
 
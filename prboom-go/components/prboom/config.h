@@ -28,6 +28,9 @@
 /* Set to the attribute to apply to struct definitions to make them packed */
 #define PACKEDATTR __attribute__((packed))
 
+/* Set to the storage class of renderer state owned by each render worker */
+#define RENDERTLS __thread
+
 /* Define to enable internal range checking */
 /* #undef RANGECHECK */
 
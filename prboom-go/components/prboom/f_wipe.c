@@ -186,10 +186,10 @@ int wipe_EndScreen(void)
 int wipe_ScreenWipe(int ticks)
 {
   static boolean go;                               // when zero, stop the wipe
+  wipe_scr = screens[0];                           // may be a different buffer every frame
   if (!go)                                         // initial stuff
     {
       go = 1;
-      wipe_scr = screens[0];
       wipe_initMelt(ticks);
     }
   // do a piece of wipe-in
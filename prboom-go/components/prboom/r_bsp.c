@@ -41,19 +41,19 @@
 #include "v_video.h"
 #include "lprintf.h"
 
-seg_t     *curline;
-side_t    *sidedef;
-line_t    *linedef;
-sector_t  *frontsector;
-sector_t  *backsector;
-drawseg_t *ds_p;
+RENDERTLS seg_t     *curline;
+RENDERTLS side_t    *sidedef;
+RENDERTLS line_t    *linedef;
+RENDERTLS sector_t  *frontsector;
+RENDERTLS sector_t  *backsector;
+RENDERTLS drawseg_t *ds_p;
 
 // killough 4/7/98: indicates doors closed wrt automap bugfix:
 // cph - replaced by linedef rendering flags - int      doorclosed;
 
 // killough: New code which removes 2s linedef limit
-drawseg_t *drawsegs;
-unsigned  maxdrawsegs;
+RENDERTLS drawseg_t *drawsegs;
+RENDERTLS unsigned  maxdrawsegs;
 // drawseg_t drawsegs[MAXDRAWSEGS];       // old code -- killough
 
 //
@@ -69,7 +69,25 @@ void R_ClearDrawSegs(void)
 // Instead of clipsegs, let's try using an array with one entry for each column,
 // indicating whether it's blocked by a solid wall yet or not.
 
-byte solidcol[MAX_SCREENWIDTH];
+static byte solidcol_main[MAX_SCREENWIDTH];
+RENDERTLS byte *solidcol = solidcol_main;
+
+// RG: Called once by the render thread, the main task keeps the static arrays.
+// The real malloc is used, Z_Malloc isn't thread safe and never returns NULL.
+boolean R_InitBSPWorker(void)
+{
+  solidcol = (malloc)(MAX_SCREENWIDTH);
+  return solidcol != NULL;
+}
+
+void R_FreeBSPWorker(void)
+{
+  (free)(solidcol);
+  (free)(drawsegs);
+  solidcol = NULL;
+  drawsegs = ds_p = NULL;
+  maxdrawsegs = 0;
+}
 
 // CPhipps -
 // R_ClipWallSegment
@@ -103,7 +121,9 @@ static void R_ClipWallSegment(int first, int last, boolean solid)
 
 void R_ClearClipSegs (void)
 {
-  memset(solidcol, 0, SCREENWIDTH);
+  // RG: Columns owned by the other render worker count as already solid
+  memset(solidcol, 1, SCREENWIDTH);
+  memset(solidcol + r_colstart, 0, r_colstop - r_colstart);
 }
 
 // killough 1/18/98 -- This function is used to fix the automap bug which
@@ -114,7 +134,9 @@ void R_ClearClipSegs (void)
 
 static void R_RecalcLineFlags(void)
 {
-  linedef->r_validcount = gametic;
+  // RG: Both render workers may get here for the same line, so flags are
+  // built locally and published before r_validcount
+  int r_flags;
 
   /* First decide if the line is closed, normal, or invisible */
   if (!(linedef->flags & ML_TWOSIDED)
@@ -136,7 +158,7 @@ static void R_RecalcLineFlags(void)
         frontsector->ceilingpic!=skyflatnum)
     )
       )
-    linedef->r_flags = RF_CLOSED;
+    r_flags = RF_CLOSED;
   else {
     // Reject empty lines used for triggers
     //  and special events.
@@ -153,13 +175,13 @@ static void R_RecalcLineFlags(void)
       sizeof(frontsector->ceilingpic) + sizeof(frontsector->floorpic) +
       sizeof(frontsector->lightlevel) + sizeof(frontsector->floorlightsec) +
       sizeof(frontsector->ceilinglightsec))) {
-      linedef->r_flags = 0; return;
+      r_flags = 0; goto done;
     } else
-      linedef->r_flags = RF_IGNORE;
+      r_flags = RF_IGNORE;
   }
 
   /* cph - I'm too lazy to try and work with offsets in this */
-  if (curline->sidedef->rowoffset) return;
+  if (curline->sidedef->rowoffset) goto done;
 
   /* Now decide on texture tiling */
   if (linedef->flags & ML_TWOSIDED) {
@@ -168,19 +190,23 @@ static void R_RecalcLineFlags(void)
     /* Does top texture need tiling */
     if ((c = frontsector->ceilingheight - backsector->ceilingheight) > 0 &&
    (textureheight[texturetranslation[curline->sidedef->toptexture]] > c))
-      linedef->r_flags |= RF_TOP_TILE;
+      r_flags |= RF_TOP_TILE;
 
     /* Does bottom texture need tiling */
     if ((c = frontsector->floorheight - backsector->floorheight) > 0 &&
    (textureheight[texturetranslation[curline->sidedef->bottomtexture]] > c))
-      linedef->r_flags |= RF_BOT_TILE;
+      r_flags |= RF_BOT_TILE;
   } else {
     int c;
     /* Does middle texture need tiling */
     if ((c = frontsector->ceilingheight - frontsector->floorheight) > 0 &&
    (textureheight[texturetranslation[curline->sidedef->midtexture]] > c))
-      linedef->r_flags |= RF_MID_TILE;
+      r_flags |= RF_MID_TILE;
   }
+
+done:
+  linedef->r_flags = r_flags;
+  linedef->r_validcount = gametic;
 }
 
 //
@@ -300,7 +326,7 @@ static void R_AddLine (seg_t *line)
   angle_t  angle2;
   angle_t  span;
   angle_t  tspan;
-  static sector_t tempsec;     // killough 3/8/98: ceiling/water hack
+  sector_t tempsec;     // killough 3/8/98: ceiling/water hack (RG: only used until we return)
 
   curline = line;
 
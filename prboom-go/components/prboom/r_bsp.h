@@ -38,22 +38,24 @@
 #pragma interface
 #endif
 
-extern seg_t    *curline;
-extern side_t   *sidedef;
-extern line_t   *linedef;
-extern sector_t *frontsector;
-extern sector_t *backsector;
+extern RENDERTLS seg_t    *curline;
+extern RENDERTLS side_t   *sidedef;
+extern RENDERTLS line_t   *linedef;
+extern RENDERTLS sector_t *frontsector;
+extern RENDERTLS sector_t *backsector;
 
 /* old code -- killough:
  * extern drawseg_t drawsegs[MAXDRAWSEGS];
  * new code -- killough: */
-extern drawseg_t *drawsegs;
-extern unsigned maxdrawsegs;
+extern RENDERTLS drawseg_t *drawsegs;
+extern RENDERTLS unsigned maxdrawsegs;
 
-extern byte solidcol[MAX_SCREENWIDTH];
+extern RENDERTLS byte *solidcol;
 
-extern drawseg_t *ds_p;
+extern RENDERTLS drawseg_t *ds_p;
 
+boolean R_InitBSPWorker(void);
+void R_FreeBSPWorker(void);
 void R_ClearClipSegs(void);
 void R_ClearDrawSegs(void);
 void R_RenderBSPNode(int bspnum);
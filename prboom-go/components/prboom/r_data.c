@@ -602,10 +602,15 @@ int PUREFUNC R_SafeTextureNumForName(const char *name, int snum)
 // Totally rewritten by Lee Killough to use less memory,
 // to avoid using alloca(), and to improve performance.
 // cph - new wad lump handling, calls cache functions but acquires no locks
+// The lumps are collected first so that the WAD layer can read them in file order.
 
-static inline void precache_lump(int l)
+static inline void precache_lump(int l, int *lumps, size_t *count, byte *queued)
 {
-  W_CacheLumpNum(l); W_UnlockLumpNum(l);
+  if (!queued[l])
+  {
+    queued[l] = 1;
+    lumps[(*count)++] = l;
+  }
 }
 
 void R_PrecacheLevel(void)
@@ -615,7 +620,16 @@ void R_PrecacheLevel(void)
 
   size_t maxitems = MAX(numtextures, MAX(numflats, numsprites));
   byte hitlist[maxitems];
-  size_t count = 0;
+  size_t count = 0, total = 0;
+  int *lumps = malloc(numlumps * sizeof(int));
+  byte *queued = calloc(numlumps, 1);
+
+  if (!lumps || !queued)
+  {
+    free(lumps);
+    free(queued);
+    return;
+  }
 
   // Precache flats.
   memset(hitlist, 0, maxitems);
@@ -631,7 +645,7 @@ void R_PrecacheLevel(void)
   {
     if (hitlist[i])
     {
-      precache_lump(firstflat + i);
+      precache_lump(firstflat + i, lumps, &total, queued);
       count++;
     }
   }
@@ -657,7 +671,7 @@ void R_PrecacheLevel(void)
         texture_t *texture = textures[i];
         for (int j = texture->patchcount; --j >= 0; )
         {
-          precache_lump(texture->patches[j].patch);
+          precache_lump(texture->patches[j].patch, lumps, &total, queued);
           count++;
         }
       }
@@ -682,13 +696,24 @@ void R_PrecacheLevel(void)
             short *sflump = sprites[i].spriteframes[j].lump;
             for (int k = 7; --k >= 0; )
             {
-              precache_lump(firstspritelump + sflump[k]);
+              precache_lump(firstspritelump + sflump[k], lumps, &total, queued);
               count++;
             }
           }
       }
 
   lprintf(LO_INFO, "R_PrecacheLevel: pre-cached %d sprites\n", count);
+
+  unsigned reads = wadcache_stats.reads;
+  size_t bytes_read = wadcache_stats.bytes_read;
+
+  W_PrecacheLumps(lumps, total);
+
+  lprintf(LO_INFO, "R_PrecacheLevel: %d lumps, %u reads, %u KB\n", (int)total,
+          wadcache_stats.reads - reads, (unsigned)((wadcache_stats.bytes_read - bytes_read) / 1024));
+
+  free(lumps);
+  free(queued);
 }
 
 // Proff - Added for OpenGL
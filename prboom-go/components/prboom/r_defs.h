@@ -98,6 +98,7 @@ typedef struct
   int blockbox[4];       // mapblock bounding box for height changes
   degenmobj_t soundorg;  // origin for any sounds played by the sector
   int validcount;        // if == validcount, already checked
+  int sprvalidcount[2];  // RG: same thing for R_AddSprites, one per render worker
   mobj_t *thinglist;     // list of mobjs in sector
 
   /* killough 8/28/98: friction is a sector property, not an mobj property.
@@ -69,7 +69,7 @@ int  viewwindowy;
 //
 
 // CPhipps - made const*'s
-const byte *tranmap;          // translucency filter maps 256x256   // phares
+RENDERTLS const byte *tranmap; // translucency filter maps 256x256   // phares
 const byte *main_tranmap;     // killough 4/11/98
 
 //
@@ -88,19 +88,20 @@ typedef enum
    COL_FLEXADD
 } columntype_e;
 
-static int    temp_x = 0;
-static int    tempyl[4], tempyh[4];
-static byte           byte_tempbuf[MAX_SCREENHEIGHT * 4];
+static RENDERTLS int    temp_x = 0;
+static RENDERTLS int    tempyl[4], tempyh[4];
+static byte           byte_tempbuf_main[MAX_SCREENHEIGHT * 4];
+static RENDERTLS byte *byte_tempbuf = byte_tempbuf_main;
 #ifndef NOTRUECOLOR
 static unsigned short short_tempbuf[MAX_SCREENHEIGHT * 4];
 static unsigned int   int_tempbuf[MAX_SCREENHEIGHT * 4];
 #endif
-static int    startx = 0;
-static int    temptype = COL_NONE;
-static int    commontop, commonbot;
-static const byte *temptranmap = NULL;
+static RENDERTLS int    startx = 0;
+static RENDERTLS int    temptype = COL_NONE;
+static RENDERTLS int    commontop, commonbot;
+static RENDERTLS const byte *temptranmap = NULL;
 // SoM 7-28-04: Fix the fuzz problem.
-static const byte   *tempfuzzmap;
+static RENDERTLS const byte   *tempfuzzmap;
 
 //
 // Spectre/Invisibility.
@@ -123,7 +124,7 @@ static const int fuzzoffset_org[FUZZTABLE] = {
 
 static int fuzzoffset[FUZZTABLE];
 
-static int fuzzpos = 0;
+static RENDERTLS int fuzzpos = 0;
 
 // render pipelines
 #define RDC_STANDARD      1
@@ -178,9 +179,9 @@ static void R_QuadFlushError(void)
    I_Error("R_FlushQuadColumn called without being initialized.\n");
 }
 
-static void (*R_FlushWholeColumns)(void) = R_FlushWholeError;
-static void (*R_FlushHTColumns)(void)    = R_FlushHTError;
-static void (*R_FlushQuadColumn)(void) = R_QuadFlushError;
+static RENDERTLS void (*R_FlushWholeColumns)(void) = R_FlushWholeError;
+static RENDERTLS void (*R_FlushHTColumns)(void)    = R_FlushHTError;
+static RENDERTLS void (*R_FlushQuadColumn)(void) = R_QuadFlushError;
 
 static void R_FlushColumns(void)
 {
@@ -212,6 +213,23 @@ void R_ResetColumnBuffer(void)
    R_FlushQuadColumn   = R_QuadFlushError;
 }
 
+//
+// R_InitColumnBufferWorker
+//
+// RG: Called once by the render thread, the main task keeps the static buffer
+//
+boolean R_InitColumnBufferWorker(void)
+{
+   byte_tempbuf = (malloc)(MAX_SCREENHEIGHT * 4);
+   return byte_tempbuf != NULL;
+}
+
+void R_FreeColumnBufferWorker(void)
+{
+   (free)(byte_tempbuf);
+   byte_tempbuf = NULL;
+}
+
 #define R_DRAWCOLUMN_PIPELINE RDC_STANDARD
 #define R_DRAWCOLUMN_PIPELINE_BITS 8
 #define R_FLUSHWHOLE_FUNCNAME R_FlushWhole8
@@ -995,8 +1013,8 @@ R_DrawSpan_f R_GetDrawSpanFunc(enum draw_filter_type_e filter,
   return result;
 }
 
-void R_DrawSpan(draw_span_vars_t *dsvars) {
-  R_GetDrawSpanFunc(drawvars.filterfloor, drawvars.filterz)(dsvars);
+void R_DrawSpan(draw_span_vars_t *dsvars, int numspans) {
+  R_GetDrawSpanFunc(drawvars.filterfloor, drawvars.filterz)(dsvars, numspans);
 }
 
 //
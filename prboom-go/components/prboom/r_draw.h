@@ -139,10 +139,11 @@ R_DrawColumn_f R_GetDrawColumnFunc(enum column_pipeline_e type,
                                    enum draw_filter_type_e filterz);
 
 // Span blitting for rows, floor/ceiling. No Spectre effect needed.
-typedef void (*R_DrawSpan_f)(draw_span_vars_t *dsvars);
+// RG: Takes an array of numspans spans, see R_MapPlane
+typedef void (*R_DrawSpan_f)(draw_span_vars_t *dsvars, int numspans);
 R_DrawSpan_f R_GetDrawSpanFunc(enum draw_filter_type_e filter,
                                enum draw_filter_type_e filterz);
-void R_DrawSpan(draw_span_vars_t *dsvars);
+void R_DrawSpan(draw_span_vars_t *dsvars, int numspans);
 
 void R_InitBuffer(int width, int height);
 
@@ -159,5 +160,7 @@ void R_DrawViewBorder(void);
 // which gets rid of the unnecessary reset of various variables during
 // column drawing.
 void R_ResetColumnBuffer(void);
+boolean R_InitColumnBufferWorker(void);
+void R_FreeColumnBufferWorker(void);
 
 #endif
@@ -76,8 +76,12 @@
  #define GETCOL(col) GETCOL_POINT(col)
 #endif
 
-static void R_DRAWSPAN_FUNCNAME(draw_span_vars_t *dsvars)
+// RG: Draws numspans consecutive spans per call, so the filter selection and
+// the function pointer dispatch are paid once per batch instead of per row.
+static void R_DRAWSPAN_FUNCNAME(draw_span_vars_t *dsvars, int numspans)
 {
+  for (; numspans > 0; numspans--, dsvars++)
+  {
 #if (R_DRAWSPAN_PIPELINE & (RDC_ROUNDED|RDC_BILINEAR))
   // drop back to point filtering if we're minifying
   // 49152 = FRACUNIT * 0.75
@@ -85,8 +89,8 @@ static void R_DRAWSPAN_FUNCNAME(draw_span_vars_t *dsvars)
       || (D_abs(dsvars->ystep) > drawvars.mag_threshold))
   {
     R_GetDrawSpanFunc(RDRAW_FILTER_POINT,
-                      drawvars.filterz)(dsvars);
-    return;
+                      drawvars.filterz)(dsvars, 1);
+    continue;
   }
 #endif
   {
@@ -145,6 +149,7 @@ static void R_DRAWSPAN_FUNCNAME(draw_span_vars_t *dsvars)
 #endif
   }
   }
+  }
 }
 
 #undef GETDEPTHMAP
@@ -55,6 +55,11 @@
 #include "g_game.h"
 #include "r_demo.h"
 #include "r_fps.h"
+#include <pthread.h>
+#if defined(RETRO_GO) && !defined(RG_TARGET_SDL2)
+#include <freertos/FreeRTOS.h>
+#include <esp_pthread.h>
+#endif
 
 // Fineangles in the SCREENWIDTH wide window.
 #define FIELDOFVIEW 2048
@@ -546,7 +551,7 @@ int autodetect_hom = 0;       // killough 2/7/98: HOM autodetection flag
 //
 // R_ShowStats
 //
-int rendered_visplanes, rendered_segs, rendered_vissprites;
+RENDERTLS int rendered_visplanes, rendered_segs, rendered_vissprites;
 boolean rendering_stats=0;
 
 static void R_ShowStats(void)
@@ -566,11 +571,53 @@ static void R_ShowStats(void)
 }
 
 //
-// R_RenderView
+// Parallel rendering
 //
-void R_RenderPlayerView (player_t* player)
+// RG: The main task draws the left part of the view and a render thread the
+// right part. Each does its own BSP traversal with the other part marked solid,
+// so segs, visplanes, drawsegs and vissprites never cross the split.
+//
+
+#define RENDER_THREAD_STACK (16 * 1024)
+
+boolean r_parallel;
+RENDERTLS int r_worker;
+RENDERTLS int r_colstart, r_colstop;
+
+static struct
 {
-  R_SetupFrame (player);
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  boolean started, failed, quit;
+  unsigned frame;       // Last frame requested by the main task
+  unsigned done;        // Last frame completed by the render thread
+  int split;            // First column drawn by the render thread
+  int segs, visplanes, vissprites;
+} renderer = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static boolean cache_shared; // Both workers are running
+
+void R_LockCache(void)
+{
+  if (cache_shared)
+    pthread_mutex_lock(&cache_lock);
+}
+
+void R_UnlockCache(void)
+{
+  if (cache_shared)
+    pthread_mutex_unlock(&cache_lock);
+}
+
+static void R_RenderColumns(int start, int stop)
+{
+  r_colstart = start;
+  r_colstop = stop;
 
   // Clear buffers.
   R_ClearClipSegs ();
@@ -579,6 +626,129 @@ void R_RenderPlayerView (player_t* player)
   R_ClearSprites ();
 
   rendered_segs = rendered_visplanes = 0;
+
+  // The head node is the last node output.
+  R_RenderBSPNode (numnodes-1);
+  R_ResetColumnBuffer();
+
+  R_DrawPlanes ();
+
+  R_DrawMasked ();
+  R_ResetColumnBuffer();
+}
+
+static void *R_RenderThread(void *arg)
+{
+  boolean ok;
+
+  r_worker = 1;
+  // All of them are called so that each buffer is either allocated or NULL
+  ok = R_InitBSPWorker();
+  ok &= R_InitPlanesWorker();
+  ok &= R_InitColumnBufferWorker();
+
+  pthread_mutex_lock(&renderer.lock);
+  renderer.started = ok;
+  renderer.failed = !ok;
+  pthread_cond_broadcast(&renderer.cond);
+  while (ok && !renderer.quit)
+  {
+    if (renderer.done == renderer.frame)
+    {
+      pthread_cond_wait(&renderer.cond, &renderer.lock);
+      continue;
+    }
+    pthread_mutex_unlock(&renderer.lock);
+
+    R_RenderColumns(renderer.split, viewwidth);
+
+    pthread_mutex_lock(&renderer.lock);
+    renderer.segs = rendered_segs;
+    renderer.visplanes = rendered_visplanes;
+    renderer.vissprites = rendered_vissprites;
+    renderer.done = renderer.frame;
+    pthread_cond_broadcast(&renderer.cond);
+  }
+  pthread_mutex_unlock(&renderer.lock);
+
+  R_FreeBSPWorker();
+  R_FreePlanesWorker();
+  R_FreeColumnBufferWorker();
+  R_FreeThingsWorker();
+
+  return NULL;
+}
+
+static boolean R_StartRenderThread(void)
+{
+  pthread_attr_t attr;
+
+  if (renderer.started || renderer.failed)
+    return renderer.started;
+
+#if defined(RETRO_GO) && !defined(RG_TARGET_SDL2)
+  // The thread goes on the core the main task isn't running on
+  esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+  cfg.stack_size = RENDER_THREAD_STACK;
+  cfg.pin_to_core = !xPortGetCoreID();
+  esp_pthread_set_cfg(&cfg);
+#endif
+
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, RENDER_THREAD_STACK);
+  if (pthread_create(&renderer.thread, &attr, R_RenderThread, NULL) == 0)
+  {
+    // Wait for the thread to allocate its buffers, it exits if it couldn't
+    pthread_mutex_lock(&renderer.lock);
+    while (!renderer.started && !renderer.failed)
+      pthread_cond_wait(&renderer.cond, &renderer.lock);
+    pthread_mutex_unlock(&renderer.lock);
+
+    if (renderer.failed)
+      pthread_join(renderer.thread, NULL);
+  }
+  else
+  {
+    renderer.failed = true;
+  }
+  pthread_attr_destroy(&attr);
+
+#if defined(RETRO_GO) && !defined(RG_TARGET_SDL2)
+  cfg = esp_pthread_get_default_config();
+  esp_pthread_set_cfg(&cfg);
+#endif
+
+  if (renderer.failed)
+    lprintf(LO_WARN, "R_StartRenderThread: Thread creation failed, rendering on a single core\n");
+
+  return renderer.started;
+}
+
+//
+// R_StopRenderThread
+// RG: Must be called between frames, the thread frees its buffers before exiting
+//
+void R_StopRenderThread(void)
+{
+  if (!renderer.started)
+    return;
+
+  pthread_mutex_lock(&renderer.lock);
+  renderer.quit = true;
+  pthread_cond_broadcast(&renderer.cond);
+  pthread_mutex_unlock(&renderer.lock);
+
+  pthread_join(renderer.thread, NULL);
+  renderer.started = renderer.quit = false;
+}
+
+//
+// R_RenderView
+//
+void R_RenderPlayerView (player_t* player)
+{
+  R_SetupFrame (player);
+
   if (autodetect_hom)
   { // killough 2/10/98: add flashing red HOM indicators
     unsigned char color=(gametic % 20) < 9 ? 0xb0 : 0;
@@ -591,24 +761,44 @@ void R_RenderPlayerView (player_t* player)
   NetUpdate ();
 #endif
 
-  // The head node is the last node output.
-  R_RenderBSPNode (numnodes-1);
-  R_ResetColumnBuffer();
-
-  // Check for new console commands.
-#ifdef HAVE_NET
-  NetUpdate ();
-#endif
-
-  R_DrawPlanes ();
-
-  // Check for new console commands.
-#ifdef HAVE_NET
-  NetUpdate ();
-#endif
+  if (!r_parallel)
+    R_StopRenderThread();
 
-  R_DrawMasked ();
-  R_ResetColumnBuffer();
+  if (r_parallel && R_StartRenderThread())
+  {
+    int step;
+
+    // Keep the split on a multiple of 4 so that quad column flushes stay aligned
+    if (!renderer.split)
+      renderer.split = viewwidth / 2;
+    renderer.split = MAX(viewwidth / 4, MIN(viewwidth * 3 / 4, renderer.split)) & ~3;
+    cache_shared = true;
+
+    pthread_mutex_lock(&renderer.lock);
+    renderer.frame++;
+    pthread_cond_broadcast(&renderer.cond);
+    pthread_mutex_unlock(&renderer.lock);
+
+    R_RenderColumns(0, renderer.split);
+
+    pthread_mutex_lock(&renderer.lock);
+    // Whoever finishes first gets a few more columns next frame
+    step = renderer.done == renderer.frame ? -4 : 4;
+    while (renderer.done != renderer.frame)
+      pthread_cond_wait(&renderer.cond, &renderer.lock);
+    pthread_mutex_unlock(&renderer.lock);
+
+    cache_shared = false;
+    renderer.split += step;
+
+    rendered_segs += renderer.segs;
+    rendered_visplanes += renderer.visplanes;
+    rendered_vissprites += renderer.vissprites;
+  }
+  else
+  {
+    R_RenderColumns(0, viewwidth);
+  }
 
   // Check for new console commands.
 #ifdef HAVE_NET
@@ -65,9 +65,23 @@ extern int      validcount;
 // Rendering stats
 //
 
-extern int rendered_visplanes, rendered_segs, rendered_vissprites;
+extern RENDERTLS int rendered_visplanes, rendered_segs, rendered_vissprites;
 extern boolean rendering_stats;
 
+//
+// Parallel rendering: the view is split in two column ranges, each drawn
+// by its own worker with its own clip arrays, visplanes and drawsegs.
+//
+
+extern boolean r_parallel;                // Set by the frontend
+extern RENDERTLS int r_worker;            // 0 = main task, 1 = render thread
+extern RENDERTLS int r_colstart, r_colstop; // Columns owned by this worker
+
+// Cache and zone calls made from the workers must be bracketed by these
+void R_LockCache(void);
+void R_UnlockCache(void);
+void R_StopRenderThread(void);
+
 //
 // Lighting LUT.
 // Used for z-depth cuing per column/row,
@@ -636,6 +636,8 @@ const rpatch_t *R_CachePatchNum(int id) {
     I_Error("createPatch: %i >= numlumps", id);
 #endif
 
+  R_LockCache();
+
   if (!patches[id].data)
     createPatch(id);
 
@@ -654,12 +656,15 @@ const rpatch_t *R_CachePatchNum(int id) {
 	    lumpinfo[id].name, patches[id].locks);
 #endif
 
+  R_UnlockCache();
+
   return &patches[id];
 }
 
 void R_UnlockPatchNum(int id)
 {
   const int unlocks = 1;
+  R_LockCache();
 #ifdef SIMPLECHECKS
   if ((signed short)patches[id].locks < unlocks)
     lprintf(LO_DEBUG, "R_UnlockPatchNum: Excess unlocks on %8s (%d-%d)\n",
@@ -671,6 +676,7 @@ void R_UnlockPatchNum(int id)
    */
   if (unlocks && !patches[id].locks)
     Z_ChangeTag(patches[id].data, PU_CACHE);
+  R_UnlockCache();
 }
 
 //---------------------------------------------------------------------------
@@ -685,6 +691,8 @@ const rpatch_t *R_CacheTextureCompositePatchNum(int id) {
     I_Error("createTextureCompositePatch: %i >= numtextures", id);
 #endif
 
+  R_LockCache();
+
   if (!texture_composites[id].data)
     createTextureCompositePatch(id);
 
@@ -703,6 +711,8 @@ const rpatch_t *R_CacheTextureCompositePatchNum(int id) {
 	    textures[id]->name, texture_composites[id].locks);
 #endif
 
+  R_UnlockCache();
+
   return &texture_composites[id];
 
 }
@@ -710,6 +720,7 @@ const rpatch_t *R_CacheTextureCompositePatchNum(int id) {
 void R_UnlockTextureCompositePatchNum(int id)
 {
   const int unlocks = 1;
+  R_LockCache();
 #ifdef SIMPLECHECKS
   if ((signed short)texture_composites[id].locks < unlocks)
     lprintf(LO_DEBUG, "R_UnlockTextureCompositePatchNum: Excess unlocks on %8s (%d-%d)\n",
@@ -721,6 +732,7 @@ void R_UnlockTextureCompositePatchNum(int id)
    */
   if (unlocks && !texture_composites[id].locks)
     Z_ChangeTag(texture_composites[id].data, PU_CACHE);
+  R_UnlockCache();
 }
 
 //---------------------------------------------------------------------------
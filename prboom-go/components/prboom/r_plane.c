@@ -62,11 +62,13 @@
 
 
 #define MAXVISPLANES 128    /* must be a power of 2 */
+#define MAXSPANBATCH 32     // RG: spans queued before calling the span drawer
 
-static visplane_t *visplanes[MAXVISPLANES];   // killough
-static visplane_t *freetail;                  // killough
-static visplane_t **freehead = &freetail;     // killough
-visplane_t *floorplane, *ceilingplane;
+static visplane_t *visplanes_main[MAXVISPLANES];
+static RENDERTLS visplane_t **visplanes = visplanes_main; // killough
+static RENDERTLS visplane_t *freetail;                  // killough
+static RENDERTLS visplane_t **freehead;                 // killough
+RENDERTLS visplane_t *floorplane, *ceilingplane;
 
 // killough -- hash function for visplanes
 // Empirically verified to be fairly uniform:
@@ -74,43 +76,74 @@ visplane_t *floorplane, *ceilingplane;
 #define visplane_hash(picnum,lightlevel,height) \
   ((unsigned)((picnum)*3+(lightlevel)+(height)*7) & (MAXVISPLANES-1))
 
-size_t maxopenings;
-int *openings,*lastopening; // dropoff overflow
+RENDERTLS size_t maxopenings;
+RENDERTLS int *openings,*lastopening; // dropoff overflow
 
 // Clip values are the solid pixel bounding the range.
 //  floorclip starts out SCREENHEIGHT
 //  ceilingclip starts out -1
 
-int floorclip[MAX_SCREENWIDTH], ceilingclip[MAX_SCREENWIDTH]; // dropoff overflow
+static int floorclip_main[MAX_SCREENWIDTH], ceilingclip_main[MAX_SCREENWIDTH];
+RENDERTLS int *floorclip = floorclip_main, *ceilingclip = ceilingclip_main; // dropoff overflow
 
 // spanstart holds the start of a plane span; initialized to 0 at start
 
-static int spanstart[MAX_SCREENHEIGHT];                // killough 2/8/98
+static int spanstart_main[MAX_SCREENHEIGHT];
+static RENDERTLS int *spanstart = spanstart_main;     // killough 2/8/98
 
 //
 // texture mapping
 //
 
-static const lighttable_t **planezlight;
-static fixed_t planeheight;
+static RENDERTLS const lighttable_t **planezlight;
+static RENDERTLS fixed_t planeheight;
+static RENDERTLS const byte *planesource;
 
 // killough 2/8/98: make variables static
 
-static fixed_t basexscale, baseyscale;
-static fixed_t cachedheight[MAX_SCREENHEIGHT];
-static fixed_t cacheddistance[MAX_SCREENHEIGHT];
-static fixed_t cachedxstep[MAX_SCREENHEIGHT];
-static fixed_t cachedystep[MAX_SCREENHEIGHT];
-static fixed_t xoffs,yoffs;    // killough 2/28/98: flat offsets
+static RENDERTLS fixed_t basexscale, baseyscale;
+static fixed_t cachedheight_main[MAX_SCREENHEIGHT];
+static fixed_t cacheddistance_main[MAX_SCREENHEIGHT];
+static fixed_t cachedxstep_main[MAX_SCREENHEIGHT];
+static fixed_t cachedystep_main[MAX_SCREENHEIGHT];
+static RENDERTLS fixed_t *cachedheight = cachedheight_main;
+static RENDERTLS fixed_t *cacheddistance = cacheddistance_main;
+static RENDERTLS fixed_t *cachedxstep = cachedxstep_main;
+static RENDERTLS fixed_t *cachedystep = cachedystep_main;
+// RG: Row light, valid while cachedzlight[y] matches planezlight
+static const lighttable_t **cachedzlight_main[MAX_SCREENHEIGHT];
+static const lighttable_t *cachedcolormap_main[MAX_SCREENHEIGHT];
+static const lighttable_t *cachednextcolormap_main[MAX_SCREENHEIGHT];
+static RENDERTLS const lighttable_t ***cachedzlight = cachedzlight_main;
+static RENDERTLS const lighttable_t **cachedcolormap = cachedcolormap_main;
+static RENDERTLS const lighttable_t **cachednextcolormap = cachednextcolormap_main;
+static RENDERTLS fixed_t xoffs,yoffs;    // killough 2/28/98: flat offsets
 
 fixed_t yslope[MAX_SCREENHEIGHT], distscale[MAX_SCREENWIDTH];
 
+static draw_span_vars_t spanbatch_main[MAXSPANBATCH];
+static RENDERTLS draw_span_vars_t *spanbatch = spanbatch_main;
+static RENDERTLS int numspans;
+
+//
+// R_FlushSpans
+// RG: Hands the queued spans to the span drawer in one call
+//
+
+static void R_FlushSpans(void)
+{
+  if (numspans)
+    R_DrawSpan(spanbatch, numspans);
+  numspans = 0;
+}
+
 //
 // R_MapPlane
 //
 // Uses global vars:
 //  planeheight
-//  dsvars.source
+//  planezlight
+//  planesource
 //  basexscale
 //  baseyscale
 //  viewx
@@ -120,12 +153,17 @@ fixed_t yslope[MAX_SCREENHEIGHT], distscale[MAX_SCREENWIDTH];
 //
 // BASIC PRIMITIVE
 //
+// RG: The span is queued, R_FlushSpans draws it. Steps and light only depend
+// on the row, the plane height and the light level, so they are kept per row
+// and shared by every plane that has the same height and light.
+//
 
-static void R_MapPlane(int y, int x1, int x2, draw_span_vars_t *dsvars)
+static void R_MapPlane(int y, int x1, int x2)
 {
   angle_t angle;
   fixed_t distance, length;
   unsigned index;
+  draw_span_vars_t *dsvars;
 
 #ifdef RANGECHECK
   if (x2 < x1 || x1<0 || x2>=viewwidth || (unsigned)y>(unsigned)viewheight)
@@ -136,16 +174,19 @@ static void R_MapPlane(int y, int x1, int x2, draw_span_vars_t *dsvars)
     {
       cachedheight[y] = planeheight;
       distance = cacheddistance[y] = FixedMul (planeheight, yslope[y]);
-      dsvars->xstep = cachedxstep[y] = FixedMul (distance,basexscale);
-      dsvars->ystep = cachedystep[y] = FixedMul (distance,baseyscale);
+      cachedxstep[y] = FixedMul (distance,basexscale);
+      cachedystep[y] = FixedMul (distance,baseyscale);
+      cachedzlight[y] = NULL;
     }
   else
     {
       distance = cacheddistance[y];
-      dsvars->xstep = cachedxstep[y];
-      dsvars->ystep = cachedystep[y];
     }
 
+  dsvars = &spanbatch[numspans];
+  dsvars->xstep = cachedxstep[y];
+  dsvars->ystep = cachedystep[y];
+
   length = FixedMul (distance,distscale[x1]);
   angle = (viewangle + xtoviewangle[x1])>>ANGLETOFINESHIFT;
 
@@ -153,30 +194,102 @@ static void R_MapPlane(int y, int x1, int x2, draw_span_vars_t *dsvars)
   dsvars->xfrac =  viewx + FixedMul(finecosine[angle], length) + xoffs;
   dsvars->yfrac = -viewy - FixedMul(finesine[angle],   length) + yoffs;
 
-  if (drawvars.filterfloor == RDRAW_FILTER_LINEAR) {
-    dsvars->xfrac -= (FRACUNIT>>1);
-    dsvars->yfrac -= (FRACUNIT>>1);
-  }
-
   if (!(dsvars->colormap = fixedcolormap))
     {
+      if (cachedzlight[y] != planezlight)
+        {
+          index = distance >> LIGHTZSHIFT;
+          if (index >= MAXLIGHTZ )
+            index = MAXLIGHTZ-1;
+          cachedzlight[y] = planezlight;
+          cachedcolormap[y] = planezlight[index];
+          cachednextcolormap[y] = planezlight[index+1 >= MAXLIGHTZ ? MAXLIGHTZ-1 : index+1];
+        }
       dsvars->z = distance;
-      index = distance >> LIGHTZSHIFT;
-      if (index >= MAXLIGHTZ )
-        index = MAXLIGHTZ-1;
-      dsvars->colormap = planezlight[index];
-      dsvars->nextcolormap = planezlight[index+1 >= MAXLIGHTZ ? MAXLIGHTZ-1 : index+1];
+      dsvars->colormap = cachedcolormap[y];
+      dsvars->nextcolormap = cachednextcolormap[y];
     }
   else
    {
       dsvars->z = 0;
+      dsvars->nextcolormap = fixedcolormap;
    }
 
+  dsvars->source = planesource;
   dsvars->y = y;
   dsvars->x1 = x1;
   dsvars->x2 = x2;
 
-  R_DrawSpan(dsvars);
+  if (++numspans == MAXSPANBATCH)
+    R_FlushSpans();
+}
+
+//
+// R_InitPlanesWorker
+// RG: Called once by the render thread, the main task keeps the static arrays.
+// Returns false if any allocation failed, R_FreePlanesWorker must be called either way.
+//
+
+boolean R_InitPlanesWorker(void)
+{
+  visplanes = (calloc)(MAXVISPLANES, sizeof(*visplanes));
+  floorclip = (malloc)(MAX_SCREENWIDTH * sizeof(*floorclip));
+  ceilingclip = (malloc)(MAX_SCREENWIDTH * sizeof(*ceilingclip));
+  spanstart = (malloc)(MAX_SCREENHEIGHT * sizeof(*spanstart));
+  cachedheight = (malloc)(MAX_SCREENHEIGHT * sizeof(*cachedheight));
+  cacheddistance = (malloc)(MAX_SCREENHEIGHT * sizeof(*cacheddistance));
+  cachedxstep = (malloc)(MAX_SCREENHEIGHT * sizeof(*cachedxstep));
+  cachedystep = (malloc)(MAX_SCREENHEIGHT * sizeof(*cachedystep));
+  cachedzlight = (malloc)(MAX_SCREENHEIGHT * sizeof(*cachedzlight));
+  cachedcolormap = (malloc)(MAX_SCREENHEIGHT * sizeof(*cachedcolormap));
+  cachednextcolormap = (malloc)(MAX_SCREENHEIGHT * sizeof(*cachednextcolormap));
+  spanbatch = (malloc)(MAXSPANBATCH * sizeof(*spanbatch));
+
+  return visplanes && floorclip && ceilingclip && spanstart
+    && cachedheight && cacheddistance && cachedxstep && cachedystep
+    && cachedzlight && cachedcolormap && cachednextcolormap && spanbatch;
+}
+
+void R_FreePlanesWorker(void)
+{
+  // Visplanes come from the zone, the main task is waiting so no lock is needed
+  for (int i = 0; visplanes && i < MAXVISPLANES; i++)
+    while (visplanes[i])
+    {
+      visplane_t *next = visplanes[i]->next;
+      Z_Free(visplanes[i]);
+      visplanes[i] = next;
+    }
+  while (freetail)
+  {
+    visplane_t *next = freetail->next;
+    Z_Free(freetail);
+    freetail = next;
+  }
+  freehead = NULL;
+
+  (free)(openings);
+  openings = lastopening = NULL;
+  maxopenings = 0;
+
+  (free)(visplanes);
+  (free)(floorclip);
+  (free)(ceilingclip);
+  (free)(spanstart);
+  (free)(cachedheight);
+  (free)(cacheddistance);
+  (free)(cachedxstep);
+  (free)(cachedystep);
+  (free)(cachedzlight);
+  (free)(cachedcolormap);
+  (free)(cachednextcolormap);
+  (free)(spanbatch);
+  visplanes = NULL;
+  floorclip = ceilingclip = spanstart = NULL;
+  cachedheight = cacheddistance = cachedxstep = cachedystep = NULL;
+  cachedzlight = NULL;
+  cachedcolormap = cachednextcolormap = NULL;
+  spanbatch = NULL;
 }
 
 //
@@ -192,6 +305,9 @@ void R_ClearPlanes(void)
   for (i=0 ; i<viewwidth ; i++)
     floorclip[i] = viewheight, ceilingclip[i] = -1;
 
+  if (!freehead)
+    freehead = &freetail;
+
   for (i=0;i<MAXVISPLANES;i++)    // new code -- killough
     for (*freehead = visplanes[i], visplanes[i] = NULL; *freehead; )
       freehead = &(*freehead)->next;
@@ -199,7 +315,7 @@ void R_ClearPlanes(void)
   lastopening = openings;
 
   // texture calculation
-  memset(cachedheight, 0, sizeof(cachedheight));
+  memset(cachedheight, 0, MAX_SCREENHEIGHT * sizeof(*cachedheight));
 
   // scale will be unit scale at SCREENWIDTH/2 distance
   basexscale = FixedDiv (viewsin,projection);
@@ -212,7 +328,11 @@ static visplane_t *new_visplane(unsigned hash)
 {
   visplane_t *check = freetail;
   if (!check)
-    check = Z_Calloc(1, sizeof(*check), PU_STATIC, 0);
+    {
+      R_LockCache();
+      check = Z_Calloc(1, sizeof(*check), PU_STATIC, 0);
+      R_UnlockCache();
+    }
   else if (!(freetail = freetail->next))
     freehead = &freetail;
   check->next = visplanes[hash];
@@ -312,13 +432,12 @@ visplane_t *R_CheckPlane(visplane_t *pl, int start, int stop)
 //
 
 static void R_MakeSpans(int x, unsigned int t1, unsigned int b1,
-                        unsigned int t2, unsigned int b2,
-                        draw_span_vars_t *dsvars)
+                        unsigned int t2, unsigned int b2)
 {
   for (; t1 < t2 && t1 <= b1; t1++)
-    R_MapPlane(t1, spanstart[t1], x-1, dsvars);
+    R_MapPlane(t1, spanstart[t1], x-1);
   for (; b1 > b2 && b1 >= t1; b1--)
-    R_MapPlane(b1, spanstart[b1] ,x-1, dsvars);
+    R_MapPlane(b1, spanstart[b1] ,x-1);
   while (t2 < t1 && t2 <= b2)
     spanstart[t2++] = x;
   while (b2 > b1 && b2 >= t2)
@@ -416,12 +535,18 @@ static void R_DoDrawPlane(visplane_t *pl)
     } else {     // regular flat
 
       int stop, light;
-      draw_span_vars_t dsvars;
 
-      dsvars.source = W_CacheLumpNum(firstflat + flattranslation[pl->picnum]);
+      R_LockCache();
+      planesource = W_CacheLumpNum(firstflat + flattranslation[pl->picnum]);
+      R_UnlockCache();
 
       xoffs = pl->xoffs;  // killough 2/28/98: Add offsets
       yoffs = pl->yoffs;
+
+      if (drawvars.filterfloor == RDRAW_FILTER_LINEAR) {
+        xoffs -= (FRACUNIT>>1);
+        yoffs -= (FRACUNIT>>1);
+      }
       planeheight = D_abs(pl->height-viewz);
       light = (pl->lightlevel >> LIGHTSEGSHIFT) + extralight;
 
@@ -437,9 +562,13 @@ static void R_DoDrawPlane(visplane_t *pl)
 
       for (x = pl->minx ; x <= stop ; x++)
          R_MakeSpans(x,pl->top[x-1],pl->bottom[x-1],
-                     pl->top[x],pl->bottom[x], &dsvars);
+                     pl->top[x],pl->bottom[x]);
+
+      R_FlushSpans();
 
+      R_LockCache();
       W_UnlockLumpNum(firstflat + flattranslation[pl->picnum]);
+      R_UnlockCache();
     }
   }
 }
@@ -44,11 +44,13 @@
 #define PL_SKYFLAT (0x80000000)
 
 /* Visplane related. */
-extern int *lastopening; // dropoff overflow
+extern RENDERTLS int *lastopening; // dropoff overflow
 
-extern int floorclip[], ceilingclip[]; // dropoff overflow
+extern RENDERTLS int *floorclip, *ceilingclip; // dropoff overflow
 extern fixed_t yslope[], distscale[];
 
+boolean R_InitPlanesWorker(void);
+void R_FreePlanesWorker(void);
 void R_ClearPlanes(void);
 void R_DrawPlanes(void);
 
@@ -50,46 +50,46 @@
 // killough 1/6/98: replaced globals with statics where appropriate
 
 // True if any of the segs textures might be visible.
-static boolean  segtextured;
-static boolean  markfloor;      // False if the back side is the same plane.
-static boolean  markceiling;
-static boolean  maskedtexture;
-static int      toptexture;
-static int      bottomtexture;
-static int      midtexture;
+static RENDERTLS boolean  segtextured;
+static RENDERTLS boolean  markfloor;      // False if the back side is the same plane.
+static RENDERTLS boolean  markceiling;
+static RENDERTLS boolean  maskedtexture;
+static RENDERTLS int      toptexture;
+static RENDERTLS int      bottomtexture;
+static RENDERTLS int      midtexture;
 
-static fixed_t  toptexheight, midtexheight, bottomtexheight; // cph
+static RENDERTLS fixed_t  toptexheight, midtexheight, bottomtexheight; // cph
 
-angle_t         rw_normalangle; // angle to line origin
-int             rw_angle1;
-fixed_t         rw_distance;
+RENDERTLS angle_t rw_normalangle; // angle to line origin
+RENDERTLS int     rw_angle1;
+RENDERTLS fixed_t rw_distance;
 
 //
 // regular wall
 //
-static int      rw_x;
-static int      rw_stopx;
-static angle_t  rw_centerangle;
-static fixed_t  rw_offset;
-static fixed_t  rw_scale;
-static fixed_t  rw_scalestep;
-static fixed_t  rw_midtexturemid;
-static fixed_t  rw_toptexturemid;
-static fixed_t  rw_bottomtexturemid;
-static int      rw_lightlevel;
-static int      worldtop;
-static int      worldbottom;
-static int      worldhigh;
-static int      worldlow;
-static fixed_t  pixhigh;
-static fixed_t  pixlow;
-static fixed_t  pixhighstep;
-static fixed_t  pixlowstep;
-static fixed_t  topfrac;
-static fixed_t  topstep;
-static fixed_t  bottomfrac;
-static fixed_t  bottomstep;
-static int      *maskedtexturecol; // dropoff overflow
+static RENDERTLS int      rw_x;
+static RENDERTLS int      rw_stopx;
+static RENDERTLS angle_t  rw_centerangle;
+static RENDERTLS fixed_t  rw_offset;
+static RENDERTLS fixed_t  rw_scale;
+static RENDERTLS fixed_t  rw_scalestep;
+static RENDERTLS fixed_t  rw_midtexturemid;
+static RENDERTLS fixed_t  rw_toptexturemid;
+static RENDERTLS fixed_t  rw_bottomtexturemid;
+static RENDERTLS int      rw_lightlevel;
+static RENDERTLS int      worldtop;
+static RENDERTLS int      worldbottom;
+static RENDERTLS int      worldhigh;
+static RENDERTLS int      worldlow;
+static RENDERTLS fixed_t  pixhigh;
+static RENDERTLS fixed_t  pixlow;
+static RENDERTLS fixed_t  pixhighstep;
+static RENDERTLS fixed_t  pixlowstep;
+static RENDERTLS fixed_t  topfrac;
+static RENDERTLS fixed_t  topstep;
+static RENDERTLS fixed_t  bottomfrac;
+static RENDERTLS fixed_t  bottomstep;
+static RENDERTLS int      *maskedtexturecol; // dropoff overflow
 
 //
 // R_ScaleFromGlobalAngle
@@ -141,7 +141,11 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
       colfunc = R_GetDrawColumnFunc(RDC_PIPELINE_TRANSLUCENT, drawvars.filterwall, drawvars.filterz);
       tranmap = main_tranmap;
       if (curline->linedef->tranlump > 0)
-        tranmap = W_CacheLumpNum(curline->linedef->tranlump-1);
+        {
+          R_LockCache();
+          tranmap = W_CacheLumpNum(curline->linedef->tranlump-1);
+          R_UnlockCache();
+        }
     }
   // killough 4/11/98: end translucent 2s normal code
 
@@ -245,7 +249,11 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
 
   // Except for main_tranmap, mark others purgable at this point
   if (curline->linedef->tranlump > 0 && general_translucency)
-    W_UnlockLumpNum(curline->linedef->tranlump-1); // cph - unlock it
+    {
+      R_LockCache();
+      W_UnlockLumpNum(curline->linedef->tranlump-1); // cph - unlock it
+      R_UnlockCache();
+    }
 
   R_UnlockTextureCompositePatchNum(texnum);
 
@@ -261,7 +269,7 @@ void R_RenderMaskedSegRange(drawseg_t *ds, int x1, int x2)
 
 #define HEIGHTBITS 12
 #define HEIGHTUNIT (1<<HEIGHTBITS)
-static int didsolidcol; /* True if at least one column was marked solid */
+static RENDERTLS int didsolidcol; /* True if at least one column was marked solid */
 
 static void R_RenderSegLoop (void)
 {
@@ -270,6 +278,11 @@ static void R_RenderSegLoop (void)
   draw_column_vars_t dcvars;
   fixed_t  texturecolumn = 0;   // shut up compiler warning
 
+  // RG: The textures are locked once for the whole seg rather than once per column
+  const rpatch_t *mid_patch = midtexture ? R_CacheTextureCompositePatchNum(midtexture) : NULL;
+  const rpatch_t *top_patch = toptexture ? R_CacheTextureCompositePatchNum(toptexture) : NULL;
+  const rpatch_t *bottom_patch = bottomtexture ? R_CacheTextureCompositePatchNum(bottomtexture) : NULL;
+
   R_SetDefaultDrawColumnVars(&dcvars);
 
   rendered_segs++;
@@ -350,14 +363,12 @@ static void R_RenderSegLoop (void)
           dcvars.yl = yl;     // single sided line
           dcvars.yh = yh;
           dcvars.texturemid = rw_midtexturemid;
-          tex_patch = R_CacheTextureCompositePatchNum(midtexture);
+          tex_patch = mid_patch;
           dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
           dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
           dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
           dcvars.texheight = midtexheight;
           colfunc (&dcvars);
-          R_UnlockTextureCompositePatchNum(midtexture);
-          tex_patch = NULL;
           ceilingclip[rw_x] = viewheight;
           floorclip[rw_x] = -1;
         }
@@ -379,14 +390,12 @@ static void R_RenderSegLoop (void)
                   dcvars.yl = yl;
                   dcvars.yh = mid;
                   dcvars.texturemid = rw_toptexturemid;
-                  tex_patch = R_CacheTextureCompositePatchNum(toptexture);
+                  tex_patch = top_patch;
                   dcvars.source = R_GetTextureColumn(tex_patch,texturecolumn);
                   dcvars.prevsource = R_GetTextureColumn(tex_patch,texturecolumn-1);
                   dcvars.nextsource = R_GetTextureColumn(tex_patch,texturecolumn+1);
                   dcvars.texheight = toptexheight;
                   colfunc (&dcvars);
-                  R_UnlockTextureCompositePatchNum(toptexture);
-                  tex_patch = NULL;
                   ceilingclip[rw_x] = mid;
                 }
               else
@@ -413,14 +422,12 @@ static void R_RenderSegLoop (void)
                   dcvars.yl = mid;
                   dcvars.yh = yh;
                   dcvars.texturemid = rw_bottomtexturemid;
-                  tex_patch = R_CacheTextureCompositePatchNum(bottomtexture);
+                  tex_patch = bottom_patch;
                   dcvars.source = R_GetTextureColumn(tex_patch, texturecolumn);
                   dcvars.prevsource = R_GetTextureColumn(tex_patch, texturecolumn-1);
                   dcvars.nextsource = R_GetTextureColumn(tex_patch, texturecolumn+1);
                   dcvars.texheight = bottomtexheight;
                   colfunc (&dcvars);
-                  R_UnlockTextureCompositePatchNum(bottomtexture);
-                  tex_patch = NULL;
                   floorclip[rw_x] = mid;
                 }
               else
@@ -448,6 +455,13 @@ static void R_RenderSegLoop (void)
       topfrac += topstep;
       bottomfrac += bottomstep;
     }
+
+  if (mid_patch)
+    R_UnlockTextureCompositePatchNum(midtexture);
+  if (top_patch)
+    R_UnlockTextureCompositePatchNum(toptexture);
+  if (bottom_patch)
+    R_UnlockTextureCompositePatchNum(bottomtexture);
 }
 
 // killough 5/2/98: move from r_main.c, made static, simplified
@@ -482,7 +496,10 @@ void R_StoreWallRange(const int start, const int stop)
     {
       unsigned pos = ds_p - drawsegs; // jff 8/9/98 fix from ZDOOM1.14a
       unsigned newmax = maxdrawsegs ? maxdrawsegs*2 : 128; // killough
-      drawsegs = realloc(drawsegs,newmax*sizeof(*drawsegs));
+      // RG: The real realloc, both render workers can get here at the same time
+      drawsegs = (realloc)(drawsegs,newmax*sizeof(*drawsegs));
+      if (!drawsegs)
+        I_Error("R_StoreWallRange: Out of memory for drawsegs");
       ds_p = drawsegs + pos;          // jff 8/9/98 fix from ZDOOM1.14a
       maxdrawsegs = newmax;
     }
@@ -519,8 +536,8 @@ void R_StoreWallRange(const int start, const int stop)
   rw_stopx = stop+1;
 
   {     // killough 1/6/98, 2/1/98: remove limit on openings
-    extern int *openings; // dropoff overflow
-    extern size_t maxopenings;
+    extern RENDERTLS int *openings; // dropoff overflow
+    extern RENDERTLS size_t maxopenings;
     size_t pos = lastopening - openings;
     size_t need = (rw_stopx - start)*4 + pos;
     if (need > maxopenings)
@@ -532,7 +549,9 @@ void R_StoreWallRange(const int start, const int stop)
         do
           maxopenings = maxopenings ? maxopenings*2 : 16384;
         while (need > maxopenings);
-        openings = realloc(openings, maxopenings * sizeof(*openings));
+        openings = (realloc)(openings, maxopenings * sizeof(*openings));
+        if (!openings)
+          I_Error("R_StoreWallRange: Out of memory for openings");
         lastopening = openings + pos;
 
       // jff 8/9/98 borrowed fix for openings from ZDOOM1.14
@@ -104,13 +104,13 @@ extern player_t         *viewplayer;
 extern angle_t          clipangle;
 extern int              *viewangletox;
 extern angle_t          xtoviewangle[MAX_SCREENWIDTH+1];  // killough 2/8/98
-extern fixed_t          rw_distance;
-extern angle_t          rw_normalangle;
+extern RENDERTLS fixed_t rw_distance;
+extern RENDERTLS angle_t rw_normalangle;
 
 // angle to line origin
-extern int              rw_angle1;
+extern RENDERTLS int     rw_angle1;
 
-extern visplane_t       *floorplane;
-extern visplane_t       *ceilingplane;
+extern RENDERTLS visplane_t *floorplane;
+extern RENDERTLS visplane_t *ceilingplane;
 
 #endif
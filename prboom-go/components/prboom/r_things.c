@@ -258,8 +258,18 @@ static void R_InitSpriteDefs(const char * const * namelist)
 // GAME FUNCTIONS
 //
 
-static vissprite_t *vissprites, **vissprite_ptrs;  // killough
-static size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
+static RENDERTLS vissprite_t *vissprites, **vissprite_ptrs;  // killough
+static RENDERTLS size_t num_vissprite, num_vissprite_alloc, num_vissprite_ptrs;
+
+// RG: Called by the render thread before it exits
+void R_FreeThingsWorker(void)
+{
+  (free)(vissprites);
+  (free)(vissprite_ptrs);
+  vissprites = NULL;
+  vissprite_ptrs = NULL;
+  num_vissprite = num_vissprite_alloc = num_vissprite_ptrs = 0;
+}
 
 //
 // R_InitSprites
@@ -295,7 +305,10 @@ static vissprite_t *R_NewVisSprite(void)
       size_t num_vissprite_alloc_prev = num_vissprite_alloc;
 
       num_vissprite_alloc = num_vissprite_alloc ? num_vissprite_alloc*2 : 128;
-      vissprites = realloc(vissprites,num_vissprite_alloc*sizeof(*vissprites));
+      // RG: The real realloc, both render workers can get here at the same time
+      vissprites = (realloc)(vissprites,num_vissprite_alloc*sizeof(*vissprites));
+      if (!vissprites)
+        I_Error("R_NewVisSprite: Out of memory");
 
       //e6y: set all fields to zero
       memset(vissprites + num_vissprite_alloc_prev, 0,
@@ -311,10 +324,10 @@ static vissprite_t *R_NewVisSprite(void)
 //  in posts/runs of opaque pixels.
 //
 
-int   *mfloorclip;   // dropoff overflow
-int   *mceilingclip; // dropoff overflow
-fixed_t spryscale;
-fixed_t sprtopscreen;
+RENDERTLS int   *mfloorclip;   // dropoff overflow
+RENDERTLS int   *mceilingclip; // dropoff overflow
+RENDERTLS fixed_t spryscale;
+RENDERTLS fixed_t sprtopscreen;
 
 void R_DrawMaskedColumn(
   const rpatch_t *patch,
@@ -560,8 +573,8 @@ static void R_ProjectSprite (mobj_t* thing, int lightlevel)
     R_UnlockPatchNum(lump+firstspritelump);
   }
 
-  // off the side?
-  if (x1 > viewwidth || x2 < 0)
+  // off the side? (RG: or the other render worker's side)
+  if (x1 >= r_colstop || x2 < r_colstart)
     return;
 
   // killough 4/9/98: clip things which are out of view due to height
@@ -605,8 +618,8 @@ static void R_ProjectSprite (mobj_t* thing, int lightlevel)
   vis->gz = fz;
   vis->gzt = gzt;                          // killough 3/27/98
   vis->texturemid = vis->gzt - viewz;
-  vis->x1 = x1 < 0 ? 0 : x1;
-  vis->x2 = x2 >= viewwidth ? viewwidth-1 : x2;
+  vis->x1 = x1 < r_colstart ? r_colstart : x1;
+  vis->x2 = x2 >= r_colstop ? r_colstop-1 : x2;
   iscale = FixedDiv (FRACUNIT, xscale);
 
   if (flip)
@@ -652,11 +665,11 @@ void R_AddSprites(subsector_t* subsec, int lightlevel)
   //  subsectors during BSP building.
   // Thus we check whether its already added.
 
-  if (sec->validcount == validcount)
+  if (sec->sprvalidcount[r_worker] == validcount)
     return;
 
   // Well, now it will be done.
-  sec->validcount = validcount;
+  sec->sprvalidcount[r_worker] = validcount;
 
   // Handle all things in sector.
 
@@ -720,7 +733,7 @@ static void R_DrawPSprite (pspdef_t *psp, int lightlevel)
   }
 
   // off the side
-  if (x2 < 0 || x1 > viewwidth)
+  if (x2 < r_colstart || x1 >= r_colstop)
     return;
 
   // store information in a vissprite
@@ -729,8 +742,8 @@ static void R_DrawPSprite (pspdef_t *psp, int lightlevel)
    // killough 12/98: fix psprite positioning problem
   vis->texturemid = (BASEYCENTER<<FRACBITS) /* +  FRACUNIT/2 */ -
                     (psp->sy-topoffset);
-  vis->x1 = x1 < 0 ? 0 : x1;
-  vis->x2 = x2 >= viewwidth ? viewwidth-1 : x2;
+  vis->x1 = x1 < r_colstart ? r_colstart : x1;
+  vis->x2 = x2 >= r_colstop ? r_colstop-1 : x2;
 // proff 11/06/98: Added for high-res
   vis->scale = pspriteyscale;
 
@@ -853,9 +866,11 @@ void R_SortVisSprites (void)
 
       if (num_vissprite_ptrs < num_vissprite*2)
         {
-          free(vissprite_ptrs);  // better than realloc -- no preserving needed
-          vissprite_ptrs = malloc((num_vissprite_ptrs = num_vissprite_alloc*2)
+          (free)(vissprite_ptrs);  // better than realloc -- no preserving needed
+          vissprite_ptrs = (malloc)((num_vissprite_ptrs = num_vissprite_alloc*2)
                                   * sizeof *vissprite_ptrs);
+          if (!vissprite_ptrs)
+            I_Error("R_SortVisSprites: Out of memory");
         }
 
       while (--i>=0)
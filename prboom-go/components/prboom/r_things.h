@@ -47,10 +47,10 @@ extern int screenheightarray[MAX_SCREENWIDTH]; /* change to MAX_*  */ // dropoff
 
 /* Vars for R_DrawMaskedColumn */
 
-extern int     *mfloorclip;    // dropoff overflow
-extern int     *mceilingclip;  // dropoff overflow
-extern fixed_t spryscale;
-extern fixed_t sprtopscreen;
+extern RENDERTLS int     *mfloorclip;    // dropoff overflow
+extern RENDERTLS int     *mceilingclip;  // dropoff overflow
+extern RENDERTLS fixed_t spryscale;
+extern RENDERTLS fixed_t sprtopscreen;
 extern fixed_t pspritescale;
 extern fixed_t pspriteiscale;
 /* proff 11/06/98: Added for high-res */
@@ -67,6 +67,7 @@ void R_AddSprites(subsector_t* subsec, int lightlevel);
 void R_DrawPlayerSprites(void);
 void R_InitSprites(const char * const * namelist);
 void R_ClearSprites(void);
+void R_FreeThingsWorker(void);
 void R_DrawMasked(void);
 
 #endif
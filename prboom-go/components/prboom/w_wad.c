@@ -56,6 +56,17 @@ size_t numwadfiles = 0;
 lumpinfo_t *lumpinfo;
 size_t      numlumps;
 
+// Unlocked lumps stay in memory until this many bytes are held (about half of a 4MB PSRAM)
+// or until the zone needs the memory back
+#define LUMP_CACHE_BUDGET (2 * 1024 * 1024)
+
+// Precache reads merge lumps separated by less than this, up to the read size
+#define PRECACHE_MAX_GAP  0x1000
+#define PRECACHE_MAX_READ 0x10000
+
+wadcache_stats_t wadcache_stats;
+static int lru_head = -1, lru_tail = -1;
+
 void ExtractFileBase (const char *path, char *dest)
 {
   const char *src = path + strlen(path) - 1;
@@ -126,15 +137,17 @@ static void W_AddFile(wadfile_info_t *wadfile)
   // If we do not have the whole thing in memory then we open it from disk
   if (!wadfile->data)
   {
-    wadfile->handle = fopen(wadfile->name, "rb");
+    rg_file_view_t *view = rg_storage_view_open(wadfile->name);
 #ifdef HAVE_NET
-    if (!wadfile->handle && D_NetGetWad(wadfile->name)) // CPhipps
-      wadfile->handle = fopen(wadfile->name, "rb");
+    if (!view && D_NetGetWad(wadfile->name)) // CPhipps
+      view = rg_storage_view_open(wadfile->name);
 #endif
-    if (wadfile->handle)
+    if (view)
     {
-      fseek(wadfile->handle, 0, SEEK_END);
-      wadfile->size = ftell(wadfile->handle);
+      // When the platform can map the file, lumps are used in place and never cached
+      wadfile->handle = view;
+      wadfile->data = view->data;
+      wadfile->size = view->size;
     }
   }
 
@@ -385,6 +398,7 @@ void W_Init(void)
   W_CoalesceMarkedResource("C_START", "C_END", ns_colormaps);
 
   W_HashLumps();
+  W_InitCache();
 }
 
 //
@@ -404,9 +418,9 @@ int W_Read(void *dest, size_t size, size_t offset, wadfile_info_t *wad)
   }
   else if (wad->handle)
   {
-    fseek(wad->handle, offset, SEEK_SET);
-    fread(dest, size, 1, wad->handle);
-    return size;
+    wadcache_stats.reads++;
+    wadcache_stats.bytes_read += size;
+    return rg_storage_view_read(wad->handle, offset, dest, size);
   }
   return -1;
 }
@@ -440,6 +454,105 @@ void W_ReadLump(void *dest, int lump)
   }
 }
 
+//
+// Lump cache
+// Locked lumps are PU_STATIC. Unlocked ones become PU_CACHE, so the zone can still take them
+// back when an allocation fails, and are kept in an LRU list that is trimmed to the budget.
+// A lump purged by the zone stays linked with a NULL ptr until it is cached again or trimmed,
+// so a lump must always be unlinked before it is (re)loaded or appended.
+//
+
+static inline boolean W_InLRU(int lump)
+{
+  return lumpinfo[lump].lru_prev >= 0 || lru_head == lump;
+}
+
+static void W_LRURemove(int lump)
+{
+  lumpinfo_t *l = &lumpinfo[lump];
+
+  if (l->lru_prev >= 0)
+    lumpinfo[l->lru_prev].lru_next = l->lru_next;
+  else
+    lru_head = l->lru_next;
+
+  if (l->lru_next >= 0)
+    lumpinfo[l->lru_next].lru_prev = l->lru_prev;
+  else
+    lru_tail = l->lru_prev;
+
+  l->lru_prev = l->lru_next = -1;
+  wadcache_stats.cached -= l->size;
+}
+
+static void W_LRUAppend(int lump)
+{
+  lumpinfo_t *l = &lumpinfo[lump];
+
+  if (W_InLRU(lump))
+    W_LRURemove(lump);
+
+  l->lru_prev = lru_tail;
+  l->lru_next = -1;
+
+  if (lru_tail >= 0)
+    lumpinfo[lru_tail].lru_next = lump;
+  else
+    lru_head = lump;
+  lru_tail = lump;
+
+  wadcache_stats.cached += l->size;
+
+  // Entries whose memory was already purged by the zone are simply dropped on the way
+  while (wadcache_stats.cached > wadcache_stats.budget && lru_head != lump)
+  {
+    int oldest = lru_head;
+    W_LRURemove(oldest);
+    Z_Free(lumpinfo[oldest].ptr);
+  }
+}
+
+#ifdef RANGECHECK
+// Walks the list both ways and checks the links and the size accounting
+static void W_CheckLRU(void)
+{
+  size_t cached = 0, count = 0;
+  int prev = -1;
+
+  for (int lump = lru_head; lump >= 0; prev = lump, lump = lumpinfo[lump].lru_next)
+  {
+    if (lumpinfo[lump].lru_prev != prev || ++count > numlumps)
+      I_Error("W_CheckLRU: broken link at lump %d", lump);
+    if (lumpinfo[lump].locks)
+      I_Error("W_CheckLRU: locked lump %d in the LRU", lump);
+    cached += lumpinfo[lump].size;
+  }
+
+  if (prev != lru_tail || cached != wadcache_stats.cached)
+    I_Error("W_CheckLRU: tail or size mismatch (%u != %u)", (unsigned)cached, (unsigned)wadcache_stats.cached);
+}
+#endif
+
+void W_InitCache(void)
+{
+  for (size_t i = 0; i < numlumps; i++)
+    lumpinfo[i].lru_prev = lumpinfo[i].lru_next = -1;
+
+  lru_head = lru_tail = -1;
+  memset(&wadcache_stats, 0, sizeof(wadcache_stats));
+  wadcache_stats.budget = LUMP_CACHE_BUDGET;
+}
+
+void W_DoneCache(void)
+{
+  while (lru_head >= 0)
+  {
+    int oldest = lru_head;
+    W_LRURemove(oldest);
+    Z_Free(lumpinfo[oldest].ptr);
+  }
+}
+
 //
 // W_CacheLumpNum
 //
@@ -450,14 +563,22 @@ const void *W_CacheLumpNum(int lump)
 
   lumpinfo_t *l = &lumpinfo[lump];
 
+  if (l->locks == 0 && W_InLRU(lump))
+    W_LRURemove(lump);
+
   if (!l->ptr)
   {
     // Bypass caching if we have the WAD mapped in memory
     if (l->wadfile && l->wadfile->data)
       return l->wadfile->data + l->position;
     W_ReadLump(Z_Malloc(W_LumpLength(lump), PU_STATIC, &l->ptr), lump);
+    wadcache_stats.misses++;
     l->locks = 0;
   }
+  else
+  {
+    wadcache_stats.hits++;
+  }
 
   if (++l->locks == 1)
   {
@@ -478,5 +599,93 @@ void W_UnlockLumpNum(int lump)
 
   lumpinfo_t *l = &lumpinfo[lump];
   if (l->ptr && l->locks && --l->locks == 0)
+  {
     Z_ChangeTag(l->ptr, PU_CACHE);
+    W_LRUAppend(lump);
+  }
+}
+
+static int W_ComparePosition(const void *a, const void *b)
+{
+  const lumpinfo_t *la = &lumpinfo[*(const int *)a];
+  const lumpinfo_t *lb = &lumpinfo[*(const int *)b];
+
+  if (la->wadfile != lb->wadfile)
+    return la->wadfile < lb->wadfile ? -1 : 1;
+  if (la->position != lb->position)
+    return la->position < lb->position ? -1 : 1;
+  return 0;
+}
+
+//
+// W_PrecacheLumps
+// Loads the given lumps unlocked, in file order, merging neighbours into large reads.
+// The list is reordered.
+//
+void W_PrecacheLumps(int *lumps, size_t count)
+{
+  size_t n = 0;
+
+  // Only lumps that would actually be read from a file are of interest
+  for (size_t i = 0; i < count; i++)
+  {
+    lumpinfo_t *l = &lumpinfo[lumps[i]];
+    if (!l->ptr && l->size && l->wadfile && !l->wadfile->data)
+      lumps[n++] = lumps[i];
+  }
+
+  qsort(lumps, n, sizeof(int), W_ComparePosition);
+
+  for (size_t first = 0, last; first < n; first = last + 1)
+  {
+    lumpinfo_t *l = &lumpinfo[lumps[first]];
+    size_t start = l->position, end = l->position + l->size;
+
+    // Extend the run while the next lump is close enough
+    for (last = first; last + 1 < n; last++)
+    {
+      lumpinfo_t *next = &lumpinfo[lumps[last + 1]];
+      size_t next_end = MAX(end, next->position + next->size);
+      if (next->wadfile != l->wadfile || next->position > end + PRECACHE_MAX_GAP
+          || next_end - start > PRECACHE_MAX_READ)
+        break;
+      end = next_end;
+    }
+
+    byte *buffer = (last > first) ? malloc(end - start) : NULL;
+
+    if (buffer && W_Read(buffer, end - start, start, l->wadfile) != (int)(end - start))
+    {
+      free(buffer);
+      continue;
+    }
+
+    for (size_t i = first; i <= last; i++)
+    {
+      int lump = lumps[i];
+      lumpinfo_t *li = &lumpinfo[lump];
+
+      if (li->ptr) // Duplicate entry
+        continue;
+
+      // A lump purged by the zone is still linked
+      if (W_InLRU(lump))
+        W_LRURemove(lump);
+
+      Z_Malloc(li->size, PU_CACHE, &li->ptr);
+      if (buffer)
+        memcpy(li->ptr, buffer + (li->position - start), li->size);
+      else
+        W_ReadLump(li->ptr, lump);
+      wadcache_stats.misses++;
+      li->locks = 0;
+      W_LRUAppend(lump);
+    }
+
+    free(buffer);
+  }
+
+#ifdef RANGECHECK
+  W_CheckLRU();
+#endif
 }
@@ -75,18 +75,30 @@ typedef struct
   short  li_namespace:5;  // lump namespace
   short  locks:11;        // ptr locks
   short  index, next;     // Index in lumpinfo[]
+  short  lru_prev, lru_next; // Unlocked cached lumps, least recently used first
   size_t size;            // lump size
   size_t position;        // position in wadfile
   wadfile_info_t *wadfile;// source file
   void *ptr;              // data/cache pointer
 } lumpinfo_t;
 
+typedef struct
+{
+  unsigned hits;          // W_CacheLumpNum served from memory
+  unsigned misses;        // lumps loaded from a WAD file
+  unsigned reads;         // read requests issued to WAD files
+  size_t   bytes_read;
+  size_t   cached;        // bytes held by unlocked lumps
+  size_t   budget;        // unlocked lumps are released past this
+} wadcache_stats_t;
+
 #define MAX_WAD_FILES 8
 
 extern wadfile_info_t wadfiles[MAX_WAD_FILES];
 extern size_t numwadfiles;
 extern lumpinfo_t *lumpinfo;
 extern size_t      numlumps;
+extern wadcache_stats_t wadcache_stats;
 
 void    W_Init(void);
 int     W_CheckNumForNameNs(const char* name, int);
@@ -101,6 +113,7 @@ void    W_InitCache(void);
 void    W_DoneCache(void);
 const void* W_CacheLumpNum(int lump);
 void    W_UnlockLumpNum(int lump);
+void    W_PrecacheLumps(int *lumps, size_t count);
 
 // CPhipps - convenience macros
 #define W_CheckNumForName(name) W_CheckNumForNameNs(name, ns_global)
@@ -35,6 +35,7 @@
 #include <m_misc.h>
 #include <r_draw.h>
 #include <r_fps.h>
+#include <r_main.h>
 #include <s_sound.h>
 #include <st_stuff.h>
 #include <mus2mid.h>
@@ -52,7 +53,7 @@
 #define AUDIO_BUFFER_LENGTH (AUDIO_SAMPLE_RATE / TICRATE + 1)
 #define NUM_MIX_CHANNELS 8
 
-static rg_video_update_t update;
+static rg_video_update_t *currentUpdate;
 static rg_app_t *app;
 
 // Expected variables by doom
@@ -68,16 +69,25 @@ typedef struct {
     byte samples[];
 } doom_sfx_t;
 
+// The game thread only posts requests in start, sfx/pos/step belong to the sound task. A restart
+// (even of the same sfx) is thus seen as a new request and can't be clobbered by the mixer's write back.
 typedef struct {
     const doom_sfx_t *sfx;
-    size_t pos;
-    float factor;
+    uint32_t pos;  // 16.16 fixed point position in samples
+    uint32_t step; // 16.16 fixed point resampling step
+    const doom_sfx_t *start; // Pending request: sfx to (re)start or SFX_STOP
     int starttic;
 } channel_t;
 
+static const doom_sfx_t stop_marker;
+#define SFX_STOP (&stop_marker)
+
 static channel_t channels[NUM_MIX_CHANNELS];
 static const doom_sfx_t *sfx[NUMSFX];
 static rg_audio_sample_t mixbuffer[AUDIO_BUFFER_LENGTH];
+static int16_t musicbuffer[AUDIO_BUFFER_LENGTH * 2];
+static int32_t mixsum[AUDIO_BUFFER_LENGTH];
+static uint8_t mixcount[AUDIO_BUFFER_LENGTH];
 static const music_player_t *music_player = &opl_synth_player;
 static bool musicPlaying = false;
 
@@ -100,6 +110,7 @@ static const struct {int mask; int *key;} keymap[] = {
 };
 
 static const char *SETTING_GAMMA = "Gamma";
+static const char *SETTING_PARALLEL = "ParallelRender";
 
 
 static rg_gui_event_t gamma_update_cb(rg_gui_option_t *option, rg_gui_event_t event)
@@ -117,7 +128,7 @@ static rg_gui_event_t gamma_update_cb(rg_gui_option_t *option, rg_gui_event_t ev
     {
         usegamma = gamma;
         I_SetPalette(current_palette);
-        rg_display_queue_update(&update, NULL);
+        I_FinishUpdate();
         rg_settings_set_number(NS_APP, SETTING_GAMMA, gamma);
         usleep(50000);
     }
@@ -127,6 +138,18 @@ static rg_gui_event_t gamma_update_cb(rg_gui_option_t *option, rg_gui_event_t ev
     return RG_DIALOG_VOID;
 }
 
+static rg_gui_event_t parallel_update_cb(rg_gui_option_t *option, rg_gui_event_t event)
+{
+    if (event == RG_DIALOG_PREV || event == RG_DIALOG_NEXT)
+    {
+        r_parallel = !r_parallel;
+        rg_settings_set_number(NS_APP, SETTING_PARALLEL, r_parallel);
+    }
+    strcpy(option->value, r_parallel ? "On " : "Off");
+
+    return RG_DIALOG_VOID;
+}
+
 
 void I_StartFrame(void)
 {
@@ -140,8 +163,22 @@ void I_UpdateNoBlit(void)
 
 void I_FinishUpdate(void)
 {
-    rg_display_queue_update(&update, NULL);
-    rg_display_sync(); // Wait for update->buffer to be released
+    rg_video_update_t *previousUpdate = currentUpdate;
+
+    // The display works from previousUpdate while we draw the next frame into a different buffer
+    rg_display_present_frame(previousUpdate);
+    currentUpdate = rg_display_acquire_frame();
+
+    // Doom only redraws what changed (status bar, border, HUD erase, wipe melt), so the new
+    // frame has to start from the one we just presented. It is only read by the display task.
+    memcpy(currentUpdate->buffer, previousUpdate->buffer, SCREENWIDTH * SCREENHEIGHT);
+
+    // The renderer caches the view window's address, it moves with the buffer
+    ptrdiff_t delta = (byte *)currentUpdate->buffer - screens[0].data;
+    drawvars.byte_topleft += delta;
+    drawvars.short_topleft = (unsigned short *)((byte *)drawvars.short_topleft + delta);
+    drawvars.int_topleft = (unsigned int *)((byte *)drawvars.int_topleft + delta);
+    screens[0].data = currentUpdate->buffer;
 }
 
 bool I_StartDisplay(void)
@@ -158,7 +195,7 @@ void I_SetPalette(int pal)
 {
     uint16_t *palette = V_BuildPalette(pal, 16);
     for (int i = 0; i < 256; i++)
-        update.palette[i] = palette[i] << 8 | palette[i] >> 8;
+        currentUpdate->palette[i] = palette[i] << 8 | palette[i] >> 8;
     Z_Free(palette);
     current_palette = pal;
 }
@@ -173,8 +210,8 @@ void I_InitGraphics(void)
         screens[i].byte_pitch = SCREENWIDTH;
     }
 
-    // Main screen uses internal ram for speed
-    screens[0].data = update.buffer;
+    // Main screen uses internal ram for speed, it is swapped with the other frame on every update
+    screens[0].data = currentUpdate->buffer;
     screens[0].not_on_heap = true;
 
     // statusbar
@@ -209,6 +246,15 @@ void I_UpdateSoundParams(int handle, int volume, int seperation, int pitch)
 {
 }
 
+// What a channel is (or is about to be) playing, as seen from the game thread
+static const doom_sfx_t *channelPlaying(channel_t *chan)
+{
+    const doom_sfx_t *start = __atomic_load_n(&chan->start, __ATOMIC_ACQUIRE);
+    if (start)
+        return start == SFX_STOP ? NULL : start;
+    return __atomic_load_n(&chan->sfx, __ATOMIC_RELAXED);
+}
+
 int I_StartSound(int sfxid, int channel, int vol, int sep, int pitch, int priority)
 {
     int oldest = gametic;
@@ -224,15 +270,15 @@ int I_StartSound(int sfxid, int channel, int vol, int sep, int pitch, int priori
     {
         for (int i = 0; i < NUM_MIX_CHANNELS; i++)
         {
-            if (channels[i].sfx == sfx[sfxid])
-                channels[i].sfx = NULL;
+            if (channelPlaying(&channels[i]) == sfx[sfxid])
+                __atomic_store_n(&channels[i].start, SFX_STOP, __ATOMIC_RELEASE);
         }
     }
 
     // Find available channel or steal the oldest
     for (int i = 0; i < NUM_MIX_CHANNELS; i++)
     {
-        if (channels[i].sfx == NULL)
+        if (channelPlaying(&channels[i]) == NULL)
         {
             slot = i;
             break;
@@ -244,10 +290,8 @@ int I_StartSound(int sfxid, int channel, int vol, int sep, int pitch, int priori
         }
     }
 
-    channel_t *chan = &channels[slot];
-    chan->sfx = sfx[sfxid];
-    chan->factor = (float)chan->sfx->samplerate / AUDIO_SAMPLE_RATE;
-    chan->pos = 0;
+    // The sound task resets the position when it takes the request
+    __atomic_store_n(&channels[slot].start, sfx[sfxid], __ATOMIC_RELEASE);
 
     return slot;
 }
@@ -255,7 +299,7 @@ int I_StartSound(int sfxid, int channel, int vol, int sep, int pitch, int priori
 void I_StopSound(int handle)
 {
     if (handle < NUM_MIX_CHANNELS)
-        channels[handle].sfx = NULL;
+        __atomic_store_n(&channels[handle].start, SFX_STOP, __ATOMIC_RELEASE);
 }
 
 bool I_SoundIsPlaying(int handle)
@@ -267,75 +311,115 @@ bool I_SoundIsPlaying(int handle)
 bool I_AnySoundStillPlaying(void)
 {
     for (int i = 0; i < NUM_MIX_CHANNELS; i++)
-        if (channels[i].sfx)
+        if (channelPlaying(&channels[i]))
             return true;
     return false;
 }
 
+static void takeChannelRequest(channel_t *chan)
+{
+    const doom_sfx_t *start = __atomic_exchange_n(&chan->start, NULL, __ATOMIC_ACQUIRE);
+
+    if (start == SFX_STOP)
+    {
+        __atomic_store_n(&chan->sfx, NULL, __ATOMIC_RELAXED);
+    }
+    else if (start)
+    {
+        chan->step = ((uint32_t)start->samplerate << 16) / AUDIO_SAMPLE_RATE;
+        chan->pos = 0;
+        __atomic_store_n(&chan->sfx, start, __ATOMIC_RELAXED);
+    }
+}
+
+static void mixChannel(channel_t *chan, int length)
+{
+    const doom_sfx_t *sfx = chan->sfx;
+    const uint32_t end = (uint32_t)sfx->length << 16;
+    const uint32_t step = chan->step;
+    uint32_t pos = chan->pos;
+    int n = 0;
+
+    for (; n < length && pos < end; n++, pos += step)
+    {
+        int sample = sfx->samples[pos >> 16];
+        // Zero samples were never mixed (nor counted as a source), keep it that way
+        if (sample)
+        {
+            mixsum[n] += sample - 127;
+            mixcount[n]++;
+        }
+    }
+
+    // A (re)start posted meanwhile is taken before the next mix, it will reset the position
+    if (pos >= end)
+        __atomic_store_n(&chan->sfx, NULL, __ATOMIC_RELAXED);
+    else
+        chan->pos = pos;
+}
+
 static void soundTask(void *arg)
 {
+    // 1/n in 4.12 fixed point, to average the sources without dividing every sample
+    int32_t inverse[NUM_MIX_CHANNELS + 1];
+    for (int i = 1; i <= NUM_MIX_CHANNELS; i++)
+        inverse[i] = (1 << 12) / i;
+
     while (1)
     {
-        int16_t *audioBuffer = (int16_t *)mixbuffer;
-        int16_t *audioBufferEnd = audioBuffer + AUDIO_BUFFER_LENGTH * 2;
-        int16_t stream[2];
+        const int length = AUDIO_BUFFER_LENGTH;
+        bool music = musicPlaying && snd_MusicVolume > 0;
+        int32_t sfx_scale = 0, music_scale = 0;
 
-        while (audioBuffer < audioBufferEnd)
-        {
-            int totalSample = 0;
-            int totalSources = 0;
-            int sample;
+        memset(mixsum, 0, sizeof(mixsum));
+        memset(mixcount, 0, sizeof(mixcount));
+
+        for (int i = 0; i < NUM_MIX_CHANNELS; i++)
+            takeChannelRequest(&channels[i]);
 
-            if (snd_SfxVolume > 0)
+        if (snd_SfxVolume > 0)
+        {
+            for (int i = 0; i < NUM_MIX_CHANNELS; i++)
             {
-                for (int i = 0; i < NUM_MIX_CHANNELS; i++)
-                {
-                    channel_t *chan = &channels[i];
-                    if (!chan->sfx)
-                        continue;
-
-                    size_t pos = (size_t)(chan->pos++ * chan->factor);
-
-                    if (pos >= chan->sfx->length)
-                    {
-                        chan->sfx = NULL;
-                    }
-                    else if ((sample = chan->sfx->samples[pos]))
-                    {
-                        totalSample += sample - 127;
-                        totalSources++;
-                    }
-                }
-
-                totalSample <<= 7;
-                totalSample /= (16 - snd_SfxVolume);
+                if (channels[i].sfx)
+                    mixChannel(&channels[i], length);
             }
+            // (sum << 7) / (16 - volume) as 24.8 fixed point
+            sfx_scale = (128 << 8) / (16 - snd_SfxVolume);
+        }
 
-            if (musicPlaying && snd_MusicVolume > 0)
+        if (music)
+        {
+            // It returns 2 (stereo) 16bits values per sample, [0] and [1] are the same value
+            music_player->render(musicbuffer, length);
+            music_scale = (1 << 15) / (16 - snd_MusicVolume);
+        }
+
+        for (int n = 0; n < length; n++)
+        {
+            int32_t totalSample = (mixsum[n] * sfx_scale) >> 8;
+            int32_t totalSources = mixcount[n];
+            int32_t sample = music ? musicbuffer[n * 2] : 0;
+
+            if (sample > 0)
             {
-                music_player->render(&stream, 1); // It returns 2 (stereo) 16bits values per sample
-                sample = stream[0]; // [0] and [1] are the same value
-                if (sample > 0)
-                {
-                    totalSample += sample / (16 - snd_MusicVolume);
-                    if (totalSources == 0)
-                        totalSources = 1;
-                }
+                totalSample += (sample * music_scale) >> 15;
+                totalSources += (totalSources == 0);
             }
 
-            if (totalSources > 0)
-                totalSample /= totalSources;
+            if (totalSources > 1)
+                totalSample = (totalSample * inverse[totalSources]) >> 12;
 
             if (totalSample > 32767)
                 totalSample = 32767;
             else if (totalSample < -32768)
                 totalSample = -32768;
 
-            *audioBuffer++ = totalSample;
-            *audioBuffer++ = totalSample;
+            mixbuffer[n].left = totalSample;
+            mixbuffer[n].right = totalSample;
         }
 
-        rg_audio_submit(mixbuffer, AUDIO_BUFFER_LENGTH);
+        rg_audio_submit(mixbuffer, length);
     }
 }
 
@@ -463,12 +547,13 @@ void I_Init(void)
     snd_MusicVolume = 15;
     snd_SfxVolume = 15;
     usegamma = rg_settings_get_number(NS_APP, SETTING_GAMMA, 0);
+    r_parallel = rg_settings_get_number(NS_APP, SETTING_PARALLEL, 0);
 }
 
 static bool screenshot_handler(const char *filename, int width, int height)
 {
     Z_FreeTags(PU_CACHE, PU_CACHE); // At this point the heap is usually full. Let's reclaim some!
-	return rg_display_save_frame(filename, &update, width, height);
+	return rg_display_save_frame(filename, rg_display_last_frame(), width, height);
 }
 
 static bool save_state_handler(const char *filename)
@@ -494,6 +579,7 @@ static void event_handler(int event, void *arg)
     {
         // DOOM fully fills the internal heap and this causes some shutdown
         // steps to fail so we try to free everything!
+        R_StopRenderThread();
         Z_FreeTags(0, PU_MAX);
         rg_audio_set_mute(true);
     }
@@ -519,13 +605,15 @@ void app_main()
     };
     const rg_gui_option_t options[] = {
         {0, "Gamma Boost", "0/5", 1, &gamma_update_cb},
+        {0, "Dual-core render", "Off", 1, &parallel_update_cb},
         RG_DIALOG_CHOICE_LAST
     };
 
     app = rg_system_init(AUDIO_SAMPLE_RATE, &handlers, options);
     app->refreshRate = TICRATE;
 
-    update.buffer = rg_alloc(SCREENHEIGHT*SCREENWIDTH, MEM_FAST);
+    rg_display_swapchain_init(2, SCREENHEIGHT * SCREENWIDTH, MEM_FAST, RG_DISPLAY_DROP_NONE);
+    currentUpdate = rg_display_acquire_frame();
 
     const char *save = RG_BASE_PATH_SAVES "/doom";
     const char *iwad = NULL;
@@ -546,15 +634,19 @@ void app_main()
 
     if (pwad)
     {
-        myargv = (const char *[]){"doom", "-save", save, "-iwad", iwad, "-file", pwad};
+        myargv = (const char *[]){"doom", "-save", save, "-iwad", iwad, "-file", pwad, "-fastdemo", "demo1"};
         myargc = 7;
     }
     else
     {
-        myargv = (const char *[]){"doom", "-save", save, "-iwad", iwad};
+        myargv = (const char *[]){"doom", "-save", save, "-iwad", iwad, "-fastdemo", "demo1"};
         myargc = 5;
     }
 
+    // In benchmark mode we play the first demo as fast as possible, tics are our frames
+    if (app->benchmark)
+        myargc += 2;
+
     rg_display_clear(C_BLACK);
 
     Z_Init();
@@ -271,6 +271,10 @@ def monitor_app(app, port, baudrate=115200):
                         profile_frames.clear()
                     if rg_debug_cmd == "END":
                         analyze_profile(profile_frames)
+                    if rg_debug_cmd == "NAME":
+                        m = re.match(r"([x0-9a-f]+)\s(.+)", rg_debug_arg)
+                        if m: # Named sections (rg_profiler_push) have no symbol in the elf
+                            symbols_cache[m.group(1)] = Symbol(m.group(1), m.group(2), "section")
                     if rg_debug_cmd == "DATA":
                         m = re.match(r"([x0-9a-f]+)\s([x0-9a-f]+)\s(\d+)\s(\d+)", rg_debug_arg)
                         if m:
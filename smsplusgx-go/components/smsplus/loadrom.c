@@ -366,23 +366,30 @@ void set_rom_config(void)
 
 int load_rom(const char *filename)
 {
-  size_t actual_size = 0, count = 0;
+  size_t actual_size = 0, count = 0, header = 0;
 
-  FILE *fd = fopen(filename, "rb");
-  if (fd)
+  rg_file_view_t *view = rg_storage_view_open(filename);
+  if (view)
   {
-    fseek(fd, 0, SEEK_END);
-    actual_size = ftell(fd);
-    fseek(fd, 0, SEEK_SET);
+    actual_size = view->size;
 
     cart.size = actual_size < 0x4000 ? 0x4000 : actual_size;
+
+    /* Take care of image header, if present, by reading past it */
+    if ((cart.size / 512) & 1)
+    {
+      header = 512;
+      cart.size -= 512;
+    }
+
     cart.rom = calloc(1, cart.size);
     cart.sram = calloc(1, 0x8000);
 
     if (!cart.rom || !cart.sram) abort();
 
-    count = fread(cart.rom, actual_size, 1, fd);
-    fclose(fd);
+    if (actual_size > header && rg_storage_view_read(view, header, cart.rom, actual_size - header) == actual_size - header)
+      count = actual_size - header;
+    rg_storage_view_close(view);
   }
 
   if (count == 0)
@@ -395,14 +402,8 @@ int load_rom(const char *filename)
     option.console = 6;
   }
 
-  /* Take care of image header, if present */
-  if ((cart.size / 512) & 1)
-  {
-    cart.size -= 512;
-    memmove(cart.rom, cart.rom + 512, cart.size);
-  }
-
-  cart.crc = crc32_le(0, cart.rom, option.console == 6 ? actual_size : cart.size);
+  /* Coleco CRCs are of the image without padding (count excludes the header) */
+  cart.crc = crc32_le(0, cart.rom, option.console == 6 ? count : cart.size);
 
   set_rom_config();
 
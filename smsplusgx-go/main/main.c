@@ -4,8 +4,7 @@
 
 #define AUDIO_SAMPLE_RATE   (32000)
 
-static rg_video_update_t updates[2];
-static rg_video_update_t *currentUpdate = &updates[0];
+static rg_video_update_t *currentUpdate;
 
 static rg_app_t *app;
 
@@ -60,14 +59,24 @@ static void event_handler(int event, void *arg)
 #endif
 }
 
+static void update_viewport(void)
+{
+    // The swapchain owns the buffers, so the viewport is expressed as a crop rather than an offset.
+    // Lines are rendered w + 2x wide and, with overscan, the viewport starts y lines down.
+    int width = bitmap.viewport.w + bitmap.viewport.x * 2;
+    int height = bitmap.viewport.h + bitmap.viewport.y * 2;
+    rg_display_set_source_format(width, height, bitmap.viewport.x, bitmap.viewport.y, bitmap.pitch, RG_PIXEL_PAL565_BE);
+    bitmap.viewport.changed = 0;
+}
+
 static bool screenshot_handler(const char *filename, int width, int height)
 {
-	return rg_display_save_frame(filename, currentUpdate, width, height);
+	return rg_display_save_frame(filename, rg_display_last_frame(), width, height);
 }
 
 static bool save_state_handler(const char *filename)
 {
-    FILE* f = fopen(filename, "w");
+    FILE* f = rg_savestate_fopen(filename, "wb");
     if (f)
     {
         system_save_state(f);
@@ -79,7 +88,7 @@ static bool save_state_handler(const char *filename)
 
 static bool load_state_handler(const char *filename)
 {
-    FILE* f = fopen(filename, "r");
+    FILE* f = rg_savestate_fopen(filename, "rb");
     if (f)
     {
         system_load_state(f);
@@ -108,8 +117,8 @@ void app_main(void)
 
     app = rg_system_init(AUDIO_SAMPLE_RATE, &handlers, NULL);
 
-    updates[0].buffer = rg_alloc(SMS_WIDTH * SMS_HEIGHT, MEM_FAST);
-    updates[1].buffer = rg_alloc(SMS_WIDTH * SMS_HEIGHT, MEM_FAST);
+    rg_display_swapchain_init(2, SMS_WIDTH * SMS_HEIGHT, MEM_FAST, RG_DISPLAY_DROP_NONE);
+    currentUpdate = rg_display_acquire_frame();
 
     system_reset_config();
 
@@ -131,19 +140,13 @@ void app_main(void)
 
     app->refreshRate = (sms.display == DISPLAY_NTSC) ? FPS_NTSC : FPS_PAL;
 
-    updates[0].buffer += bitmap.viewport.x;
-    updates[1].buffer += bitmap.viewport.x;
-
-    rg_display_set_source_format(bitmap.viewport.w, bitmap.viewport.h, 0, 0, bitmap.pitch, RG_PIXEL_PAL565_BE);
+    update_viewport();
 
     if (app->bootFlags & RG_BOOT_RESUME)
     {
         rg_emu_load_state(app->saveSlot);
     }
 
-    int skipFrames = 0;
-    int copyPalette = 0;
-
     while (true)
     {
         *localJoystick = rg_input_read_gamepad();
@@ -158,8 +161,7 @@ void app_main(void)
         }
 
         int64_t startTime = rg_system_timer();
-        bool drawFrame = !skipFrames;
-        bool fullFrame = true;
+        bool drawFrame = rg_system_should_draw();
 
         input.pad[0] = 0x00;
         input.pad[1] = 0x00;
@@ -270,42 +272,22 @@ void app_main(void)
 
         system_frame(!drawFrame);
 
-        if (drawFrame)
+        if (bitmap.viewport.changed)
         {
-            rg_video_update_t *previousUpdate = &updates[currentUpdate == &updates[0]];
-            if (render_copy_palette(currentUpdate->palette))
-            {
-                previousUpdate = NULL;
-                copyPalette = true;
-            }
-            else if (copyPalette)
-            {
-                memcpy(currentUpdate->palette, previousUpdate->palette, 512);
-                copyPalette = false;
-            }
-            fullFrame = rg_display_queue_update(currentUpdate, previousUpdate) == RG_UPDATE_FULL;
-            currentUpdate = &updates[currentUpdate == &updates[0]]; // Swap
-            bitmap.data = currentUpdate->buffer - bitmap.viewport.x;
+            update_viewport();
         }
 
-        int elapsed = rg_system_timer() - startTime;
-
-        // See if we need to skip a frame to keep up
-        if (skipFrames == 0)
-        {
-            int frameTime = 1000000 / (app->refreshRate * app->speed);
-            if (elapsed > frameTime - 2000) // It takes about 2ms to copy the audio buffer
-                skipFrames = (elapsed + frameTime / 2) / frameTime;
-            else if (drawFrame && fullFrame) // This could be avoided when scaling != full
-                skipFrames = 1;
-            if (app->speed > 1.f) // This is a hack until we account for audio speed...
-                skipFrames += (int)app->speed;
-        }
-        else if (skipFrames > 0)
+        if (drawFrame)
         {
-            skipFrames--;
+            // Acquired frames inherit the last palette, we only need to copy it when it changes
+            render_copy_palette(currentUpdate->palette);
+            rg_display_present_frame(currentUpdate);
+            currentUpdate = rg_display_acquire_frame();
+            bitmap.data = currentUpdate->buffer;
         }
 
+        int elapsed = rg_system_timer() - startTime;
+
         // Tick before submitting audio/syncing
         rg_system_tick(elapsed);
 
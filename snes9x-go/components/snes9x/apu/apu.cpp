@@ -9,9 +9,15 @@
 #include "apu.h"
 #include "../snapshot.h"
 
+#ifdef RETRO_GO
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
 namespace SNES
 {
 	#include "smp.hpp"
+	#include "dsp.hpp"
 } // namespace SNES
 
 static const int APU_NUMERATOR_NTSC = 15664;
@@ -38,23 +44,184 @@ namespace spc
 	static uint32 ratio_denominator = APU_DENOMINATOR_NTSC;
 
 	static double dynamic_rate_multiplier = 1.0;
+
+	static uint32 timestamp; // SMP clock the S-CPU has reached
+
+	static int16 buffer[APU_BUFFER_SIZE];
 } // namespace spc
 
+// The SMP and DSP run in their own task (on the second core), fed by a lock-free ring of
+// timestamped events. The S-CPU queues port writes and line ends and only waits for the APU when
+// it reads a port. The APU task is woken every few lines and catches up in one go.
+enum
+{
+	APU_EVENT_RUN,
+	APU_EVENT_WRITE,
+};
+
+struct apu_event_t
+{
+	uint32 time;
+	uint8 type;
+	uint8 port;
+	uint8 data;
+};
+
+static struct
+{
+	apu_event_t events[APU_RING_SIZE];
+	uint32 head; // Only written by the S-CPU
+	uint32 tail; // Only written by the APU task, once the event has been processed
+	uint32 lines;
+#ifdef RETRO_GO
+	TaskHandle_t task;
+	TaskHandle_t waiter; // S-CPU task blocked in apu_wait, notified when the ring runs dry
+#endif
+} apu_ring;
+
+static void apu_process_events(void)
+{
+	uint32 tail = apu_ring.tail;
+
+	while (tail != __atomic_load_n(&apu_ring.head, __ATOMIC_ACQUIRE))
+	{
+		const apu_event_t *event = &apu_ring.events[tail & (APU_RING_SIZE - 1)];
+		int32 cycles = event->time - SNES::smp.time;
+
+		if (cycles > 0)
+			SNES::smp.execute(cycles);
+		SNES::dsp.synchronize(SNES::smp.time + SNES::smp.clock);
+
+		if (event->type == APU_EVENT_WRITE)
+			SNES::smp.registers[event->port] = event->data;
+
+		// Submitting may block on the audio device, which in turn paces the S-CPU's port reads
+		if (SNES::dsp.sample_count() >= APU_BATCH_SAMPLES)
+		{
+			if (spc::callback && !Settings.Mute)
+				spc::callback(spc::callback_data);
+			SNES::dsp.clear_output();
+		}
+
+		__atomic_store_n(&apu_ring.tail, ++tail, __ATOMIC_RELEASE);
+	}
+}
+
+static inline void apu_kick(void)
+{
+#ifdef RETRO_GO
+	if (apu_ring.task)
+		xTaskNotifyGive(apu_ring.task);
+#else
+	apu_process_events();
+#endif
+}
+
+// Waits until the APU has processed every event below ring index "until"
+static void apu_wait(uint32 until)
+{
+	if ((int32)(__atomic_load_n(&apu_ring.tail, __ATOMIC_ACQUIRE) - until) >= 0)
+		return;
+
+#ifdef RETRO_GO
+	// Most waits are short, spin a little before paying for a context switch
+	apu_kick();
+	for (int i = 0; i < APU_WAIT_SPINS; i++)
+	{
+		if ((int32)(__atomic_load_n(&apu_ring.tail, __ATOMIC_ACQUIRE) - until) >= 0)
+			return;
+	}
+
+	// Then sleep, the APU task notifies us every time it runs out of events. Kick it again in case
+	// it ran dry before it could see us.
+	__atomic_store_n(&apu_ring.waiter, xTaskGetCurrentTaskHandle(), __ATOMIC_RELEASE);
+	apu_kick();
+	while ((int32)(__atomic_load_n(&apu_ring.tail, __ATOMIC_ACQUIRE) - until) < 0)
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	__atomic_store_n(&apu_ring.waiter, (TaskHandle_t)NULL, __ATOMIC_RELEASE);
+#else
+	apu_kick();
+#endif
+}
+
+static void apu_push(uint8 type, uint8 port, uint8 data)
+{
+	uint32 head = apu_ring.head;
+
+	// The ring is full, the APU must catch up before we can go on
+	if (head - __atomic_load_n(&apu_ring.tail, __ATOMIC_ACQUIRE) >= APU_RING_SIZE)
+		apu_wait(head - APU_RING_SIZE + 1);
+
+	apu_ring.events[head & (APU_RING_SIZE - 1)] = {spc::timestamp, type, port, data};
+	__atomic_store_n(&apu_ring.head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Waits until the APU has processed everything, after which it is safe to access its state
+static void apu_sync(void)
+{
+	apu_wait(apu_ring.head);
+}
+
+#ifdef RETRO_GO
+static void apu_task(void *arg)
+{
+	apu_ring.task = xTaskGetCurrentTaskHandle();
+
+	// Anything queued before our handle was published would otherwise never be noticed
+	while (true)
+	{
+		apu_process_events();
+
+		// A stale wake up is harmless, the waiter checks the ring again
+		TaskHandle_t waiter = __atomic_load_n(&apu_ring.waiter, __ATOMIC_ACQUIRE);
+		if (waiter)
+			xTaskNotifyGive(waiter);
+
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	}
+}
+#endif
+
+// Restarts the S-CPU -> APU timestamps after a reset or state load
+static void apu_reset_time(void)
+{
+	spc::timestamp = 0;
+	SNES::smp.time = 0;
+	SNES::dsp.time = SNES::smp.clock;
+}
+
 extern "C" {
 
 bool8 S9xMixSamples(uint8 *dest, int sample_count)
 {
-	return true;
+	int16 *out = (int16 *)dest;
+	int available = SNES::dsp.sample_count();
+	int count = (sample_count < available) ? sample_count : available;
+
+	if (Settings.Stereo)
+	{
+		memcpy(out, spc::buffer, count * 2);
+	}
+	else
+	{
+		for (int i = 0; i < count; i += 2)
+			out[i] = out[i + 1] = (spc::buffer[i] + spc::buffer[i + 1]) >> 1;
+	}
+
+	if (count < sample_count)
+		memset(out + count, 0, (sample_count - count) * 2);
+
+	return (count == sample_count);
 }
 
 int S9xGetSampleCount(void)
 {
-	return -1;
+	return SNES::dsp.sample_count();
 }
 
 void S9xClearSamples(void)
 {
-
+	SNES::dsp.clear_output();
 }
 
 void S9xLandSamples(void)
@@ -125,6 +292,15 @@ void S9xToggleSoundChannel(int c)
 
 bool8 S9xInitAPU(void)
 {
+	SNES::dsp.set_output(spc::buffer, APU_BUFFER_SIZE);
+	SNES::dsp.power();
+
+#ifdef RETRO_GO
+	// The SMP, the DSP and the samples callback (which ends in rg_audio_submit) all run on this stack
+	if (!apu_ring.task && !rg_task_create("snes_apu", &apu_task, NULL, 8 * 1024, 7, 1))
+		return (FALSE);
+#endif
+
 	return (TRUE);
 }
 
@@ -136,21 +312,24 @@ void S9xDeinitAPU(void)
 void S9xAPUExecute(void)
 {
 	int cycles = (spc::ratio_numerator * (CPU.Cycles - spc::reference_time) + spc::remainder);
-	SNES::smp.execute(cycles / spc::ratio_denominator);
+	spc::timestamp += cycles / spc::ratio_denominator;
 	spc::remainder = (cycles % spc::ratio_denominator);
 	spc::reference_time = CPU.Cycles;
 }
 
 uint8 S9xAPUReadPort(uint32 port)
 {
+	// This is the only point where the S-CPU truly depends on the APU
 	S9xAPUExecute();
+	apu_push(APU_EVENT_RUN, 0, 0);
+	apu_sync();
 	return ((uint8)SNES::smp.apuram[0xf4 + (port & 3)]);
 }
 
 void S9xAPUWritePort(uint32 port, uint8 byte)
 {
 	S9xAPUExecute();
-	SNES::smp.registers[port & 3] = byte;
+	apu_push(APU_EVENT_WRITE, port & 3, byte);
 }
 
 void S9xAPUSetReferenceTime(int32 cpucycles)
@@ -161,6 +340,10 @@ void S9xAPUSetReferenceTime(int32 cpucycles)
 void S9xAPUEndScanline(void)
 {
 	S9xAPUExecute();
+	apu_push(APU_EVENT_RUN, 0, 0);
+
+	if (++apu_ring.lines % APU_BATCH_LINES == 0)
+		apu_kick();
 }
 
 void S9xAPUTimingSetSpeedup(int ticks)
@@ -179,20 +362,28 @@ void S9xAPUTimingSetSpeedup(int ticks)
 
 void S9xResetAPU(void)
 {
+	apu_sync();
+
 	spc::reference_time = 0;
 	spc::remainder = 0;
 
 	SNES::smp.power();
+	SNES::dsp.power();
+	apu_reset_time();
 
 	S9xClearSamples();
 }
 
 void S9xSoftResetAPU(void)
 {
+	apu_sync();
+
 	spc::reference_time = 0;
 	spc::remainder = 0;
 
 	SNES::smp.reset();
+	SNES::dsp.reset();
+	apu_reset_time();
 
 	S9xClearSamples();
 }
@@ -201,6 +392,8 @@ void S9xAPUSaveState(uint8 *block)
 {
 	uint8 *ptr = block;
 
+	apu_sync();
+
 	SNES::smp.save_state(&ptr);
 	// SNES::dsp.save_state(&ptr);
 
@@ -212,6 +405,7 @@ void S9xAPUSaveState(uint8 *block)
 	ptr += sizeof(int32);
 	memcpy(ptr, SNES::smp.registers, 4);
 	ptr += sizeof(int32);
+	SNES::dsp.save_state(&ptr);
 
 	memset(ptr, 0, SPC_SAVE_STATE_BLOCK_SIZE - (ptr - block));
 }
@@ -220,6 +414,8 @@ void S9xAPULoadState(uint8 *block)
 {
 	uint8 *ptr = block;
 
+	apu_sync();
+
 	SNES::smp.load_state(&ptr);
 	// SNES::dsp.load_state(&ptr);
 
@@ -230,6 +426,11 @@ void S9xAPULoadState(uint8 *block)
 	// SNES::dsp.clock = GET_LE32(ptr);
 	ptr += sizeof(int32);
 	memcpy(SNES::smp.registers, ptr, 4);
+	ptr += sizeof(int32);
+	SNES::dsp.load_state(&ptr);
+
+	apu_reset_time();
+	S9xClearSamples();
 }
 
 }
@@ -13,6 +13,12 @@ typedef void (*apu_callback) (void *);
 
 #define SPC_SAVE_STATE_BLOCK_SIZE (1024 * 65)
 
+#define APU_RING_SIZE     1024 // Must be a power of two
+#define APU_BATCH_LINES   16   // Wake up the APU task every N scanlines
+#define APU_BATCH_SAMPLES 512  // Samples (not frames) handed to the callback at once
+#define APU_BUFFER_SIZE   (APU_BATCH_SAMPLES * 2)
+#define APU_WAIT_SPINS    256  // Polls of the ring before the S-CPU sleeps on a notification
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -0,0 +1,511 @@
+#include "../snes9x.h"
+
+namespace SNES
+{
+#include "smp.hpp"
+#include "dsp.hpp"
+
+DSP dsp;
+
+#define CLAMP16(io) { if ((int16)(io) != (io)) (io) = ((io) >> 31) ^ 0x7fff; }
+
+// Envelope and noise rates are derived from a single counter, same as the hardware
+#define SIMPLE_COUNTER_RANGE (2048 * 5 * 3)
+
+static const uint16 counter_rates[32] = {
+	SIMPLE_COUNTER_RANGE + 1, // never fires
+	      2048, 1536,
+	1280, 1024,  768,
+	 640,  512,  384,
+	 320,  256,  192,
+	 160,  128,   96,
+	  80,   64,   48,
+	  40,   32,   24,
+	  20,   16,   12,
+	  10,    8,    6,
+	   5,    4,    3,
+	         2,
+	         1
+};
+
+static const uint16 counter_offsets[32] = {
+	   1,    0, 1040,
+	 536,    0, 1040,
+	 536,    0, 1040,
+	 536,    0, 1040,
+	 536,    0, 1040,
+	 536,    0, 1040,
+	 536,    0, 1040,
+	 536,    0, 1040,
+	 536,    0, 1040,
+	 536,    0, 1040,
+	         0,
+	         0
+};
+
+bool DSP::check_counter(int rate)
+{
+	return (((unsigned)counter + counter_offsets[rate]) % counter_rates[rate]) == 0;
+}
+
+void DSP::decode_brr(Voice *v)
+{
+	int header = ram[v->brr_addr];
+	int shift = header >> 4;
+	int filter = header & 0x0c;
+	int p1 = v->buf[16];
+	int p2 = v->buf[15] >> 1;
+
+	v->brr_header = header;
+	v->buf[0] = p1;
+
+	for (int i = 0; i < 16; i++)
+	{
+		int byte = ram[(v->brr_addr + 1 + (i >> 1)) & 0xffff];
+		int s = (int8)((i & 1) ? (byte << 4) : byte) >> 4;
+
+		s = (s << shift) >> 1;
+		if (shift >= 0xd)
+			s = (s < 0) ? -2048 : 0;
+
+		if (filter >= 8)
+		{
+			s += p1;
+			s -= p2;
+			if (filter == 8)
+			{
+				s += p2 >> 4;
+				s += (p1 * -3) >> 6;
+			}
+			else
+			{
+				s += (p1 * -13) >> 7;
+				s += (p2 * 3) >> 4;
+			}
+		}
+		else if (filter)
+		{
+			s += p1 >> 1;
+			s += (-p1) >> 5;
+		}
+
+		CLAMP16(s);
+		s = (int16)(s * 2);
+
+		v->buf[i + 1] = s;
+		p2 = p1 >> 1;
+		p1 = s;
+	}
+}
+
+void DSP::run_envelope(Voice *v, const uint8 *vregs)
+{
+	int env = v->env;
+	int env_data;
+	int rate;
+
+	if (v->env_mode == env_release)
+	{
+		if ((env -= 0x8) < 0)
+			env = 0;
+		v->env = env;
+		return;
+	}
+
+	if (vregs[v_adsr0] & 0x80) // ADSR
+	{
+		env_data = vregs[v_adsr1];
+		if (v->env_mode >= env_decay)
+		{
+			env--;
+			env -= env >> 8;
+			rate = env_data & 0x1f;
+			if (v->env_mode == env_decay)
+				rate = (vregs[v_adsr0] >> 3 & 0x0e) + 0x10;
+		}
+		else // env_attack
+		{
+			rate = (vregs[v_adsr0] & 0x0f) * 2 + 1;
+			env += rate < 31 ? 0x20 : 0x400;
+		}
+	}
+	else // GAIN
+	{
+		env_data = vregs[v_gain];
+		int mode = env_data >> 5;
+		if (mode < 4) // direct
+		{
+			env = env_data * 0x10;
+			rate = 31;
+		}
+		else
+		{
+			rate = env_data & 0x1f;
+			if (mode == 4) // linear decrease
+			{
+				env -= 0x20;
+			}
+			else if (mode < 6) // exponential decrease
+			{
+				env--;
+				env -= env >> 8;
+			}
+			else // linear increase
+			{
+				env += 0x20;
+				if (mode > 6 && (unsigned)v->hidden_env >= 0x600)
+					env += 0x8 - 0x20; // two-slope linear increase
+			}
+		}
+	}
+
+	// Sustain level
+	if ((env >> 8) == (env_data >> 5) && v->env_mode == env_decay)
+		v->env_mode = env_sustain;
+
+	v->hidden_env = env;
+
+	if ((unsigned)env > 0x7ff)
+	{
+		env = (env < 0 ? 0 : 0x7ff);
+		if (v->env_mode == env_attack)
+			v->env_mode = env_decay;
+	}
+
+	if (check_counter(rate))
+		v->env = env;
+}
+
+void DSP::key_on(Voice *v, const uint8 *vregs)
+{
+	int entry = (regs[r_dir] << 8) + vregs[v_srcn] * 4;
+
+	v->brr_addr = ram[entry & 0xffff] | (ram[(entry + 1) & 0xffff] << 8);
+	v->pos = 0;
+	v->env = 0;
+	v->hidden_env = 0;
+	v->env_mode = env_attack;
+	v->kon_delay = 5;
+	memset(v->buf, 0, sizeof(v->buf));
+
+	decode_brr(v);
+}
+
+IRAM_ATTR void DSP::sample()
+{
+	int flg = regs[r_flg];
+	int kon = 0;
+	int koff = 0;
+
+	if (--counter < 0)
+		counter = SIMPLE_COUNTER_RANGE - 1;
+
+	// Key on/off are only polled every other sample
+	if ((every_other_sample ^= 1))
+	{
+		kon = new_kon;
+		koff = regs[r_koff];
+		new_kon = 0;
+		regs[r_endx] &= ~kon;
+	}
+
+	if (check_counter(flg & 0x1f))
+	{
+		int feedback = (noise << 13) ^ (noise << 14);
+		noise = (feedback & 0x4000) ^ (noise >> 1);
+	}
+
+	int main_l = 0, main_r = 0;
+	int echo_l = 0, echo_r = 0;
+	int prev_output = 0;
+
+	for (int i = 0, bit = 1; i < 8; i++, bit <<= 1)
+	{
+		Voice *v = &voices[i];
+		uint8 *vregs = &regs[i * 0x10];
+
+		if (kon & bit)
+			key_on(v, vregs);
+
+		if (flg & 0x80)
+		{
+			v->env_mode = env_release;
+			v->env = 0;
+		}
+		else if (koff & bit)
+		{
+			v->env_mode = env_release;
+		}
+
+		// Released voices that went silent are skipped entirely, they don't advance either
+		if (v->kon_delay || (v->env_mode == env_release && v->env == 0))
+		{
+			if (v->kon_delay)
+				v->kon_delay--;
+			vregs[v_envx] = 0;
+			vregs[v_outx] = 0;
+			prev_output = 0;
+			continue;
+		}
+
+		int pitch = (vregs[v_pitchl] | (vregs[v_pitchh] << 8)) & 0x3fff;
+		if (regs[r_pmon] & bit & ~1)
+		{
+			pitch += ((prev_output >> 5) * pitch) >> 10;
+			pitch = pitch < 0 ? 0 : (pitch > 0x7fff ? 0x7fff : pitch);
+		}
+
+		int output;
+		if (regs[r_non] & bit)
+		{
+			output = (int16)(noise * 2);
+		}
+		else
+		{
+			const int16 *s = &v->buf[v->pos >> 12];
+			output = s[0] + (((s[1] - s[0]) * (v->pos & 0xfff)) >> 12);
+		}
+
+		output = ((output * v->env) >> 11) & ~1;
+
+		run_envelope(v, vregs);
+		vregs[v_envx] = v->env >> 4;
+		vregs[v_outx] = output >> 8;
+
+		int l = (output * (int8)vregs[v_voll]) >> 7;
+		int r = (output * (int8)vregs[v_volr]) >> 7;
+		main_l += l;
+		main_r += r;
+		if (regs[r_eon] & bit)
+		{
+			echo_l += l;
+			echo_r += r;
+		}
+		prev_output = output;
+
+		// Pitch is at most 0x7fff so we can't skip more than one block per sample
+		if ((v->pos += pitch) >= 0x10000)
+		{
+			v->pos -= 0x10000;
+			if (v->brr_header & 1)
+			{
+				int entry = (regs[r_dir] << 8) + vregs[v_srcn] * 4 + 2;
+				v->brr_addr = ram[entry & 0xffff] | (ram[(entry + 1) & 0xffff] << 8);
+				regs[r_endx] |= bit;
+				if (!(v->brr_header & 2))
+				{
+					v->env_mode = env_release;
+					v->env = 0;
+				}
+			}
+			else
+			{
+				v->brr_addr = (v->brr_addr + 9) & 0xffff;
+			}
+			decode_brr(v);
+		}
+	}
+
+	// Echo buffer is always read, even when writes are disabled
+	if (echo_offset == 0)
+		echo_length = (regs[r_edl] & 0x0f) ? (regs[r_edl] & 0x0f) * 0x800 : 4;
+
+	uint8 *echo_ptr = &ram[((regs[r_esa] << 8) + echo_offset) & 0xffff];
+
+	echo_hist_pos = (echo_hist_pos + 1) & 7;
+	echo_hist[echo_hist_pos][0] = (int16)READ_WORD(echo_ptr) >> 1;
+	echo_hist[echo_hist_pos][1] = (int16)READ_WORD(echo_ptr + 2) >> 1;
+
+	int fir_l = 0, fir_r = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		const int32 *hist = echo_hist[(echo_hist_pos + 1 + i) & 7];
+		int coef = (int8)regs[r_fir + i * 0x10];
+		fir_l += (hist[0] * coef) >> 6;
+		fir_r += (hist[1] * coef) >> 6;
+	}
+	CLAMP16(fir_l);
+	CLAMP16(fir_r);
+
+	if (!(flg & 0x20))
+	{
+		int in_l = echo_l + ((fir_l * (int8)regs[r_efb]) >> 7);
+		int in_r = echo_r + ((fir_r * (int8)regs[r_efb]) >> 7);
+		CLAMP16(in_l);
+		CLAMP16(in_r);
+		WRITE_WORD(echo_ptr, in_l & ~1);
+		WRITE_WORD(echo_ptr + 2, in_r & ~1);
+	}
+
+	if ((echo_offset += 4) >= echo_length)
+		echo_offset = 0;
+
+	int out_l = ((main_l * (int8)regs[r_mvoll]) >> 7) + ((fir_l * (int8)regs[r_evoll]) >> 7);
+	int out_r = ((main_r * (int8)regs[r_mvolr]) >> 7) + ((fir_r * (int8)regs[r_evolr]) >> 7);
+	CLAMP16(out_l);
+	CLAMP16(out_r);
+
+	if (flg & 0x40)
+		out_l = out_r = 0;
+
+	if (out_pos < out_end)
+	{
+		out_pos[0] = out_l;
+		out_pos[1] = out_r;
+		out_pos += 2;
+	}
+}
+
+uint8 DSP::read(unsigned addr)
+{
+	return regs[addr & 0x7f];
+}
+
+void DSP::write(unsigned addr, uint8 data)
+{
+	regs[addr] = data;
+
+	if (addr == r_kon)
+		new_kon |= data;
+	else if (addr == r_endx)
+		regs[r_endx] = 0;
+}
+
+void DSP::set_output(int16 *begin, int size)
+{
+	out_begin = out_pos = begin;
+	out_end = begin + size;
+}
+
+void DSP::power()
+{
+	ram = smp.apuram;
+	memset(regs, 0, sizeof(regs));
+	memset(voices, 0, sizeof(voices));
+	reset();
+}
+
+void DSP::reset()
+{
+	regs[r_flg] = 0xe0;
+
+	for (int i = 0; i < 8; i++)
+	{
+		voices[i].env_mode = env_release;
+		voices[i].env = 0;
+		voices[i].kon_delay = 0;
+	}
+
+	new_kon = 0;
+	every_other_sample = 1;
+	counter = 0;
+	noise = 0x4000;
+
+	echo_offset = 0;
+	echo_length = 0;
+	echo_hist_pos = 0;
+	memset(echo_hist, 0, sizeof(echo_hist));
+}
+
+void DSP::save_state(uint8 **block)
+{
+	uint8 *ptr = *block;
+
+#undef INT32
+#define INT32(i)		\
+SET_LE32(ptr, (i)); \
+ptr += sizeof(int32)
+	INT32(DSP_SAVE_STATE_TAG);
+
+	memcpy(ptr, regs, sizeof(regs));
+	ptr += sizeof(regs);
+
+	INT32(new_kon);
+	INT32(every_other_sample);
+	INT32(counter);
+	INT32(noise);
+
+	INT32(echo_offset);
+	INT32(echo_length);
+	INT32(echo_hist_pos);
+	for (int i = 0; i < 8; i++)
+	{
+		INT32(echo_hist[i][0]);
+		INT32(echo_hist[i][1]);
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		INT32(voices[i].pos);
+		INT32(voices[i].brr_addr);
+		INT32(voices[i].brr_header);
+		INT32(voices[i].env);
+		INT32(voices[i].hidden_env);
+		INT32(voices[i].env_mode);
+		INT32(voices[i].kon_delay);
+	}
+
+	// Kept last because they would misalign the fields above
+	for (int i = 0; i < 8; i++)
+	{
+		memcpy(ptr, voices[i].buf, sizeof(voices[i].buf));
+		ptr += sizeof(voices[i].buf);
+	}
+
+	*block = ptr;
+}
+
+void DSP::load_state(uint8 **block)
+{
+	uint8 *ptr = *block;
+
+	// Older save states have no DSP state at all
+	if (GET_LE32(ptr) != DSP_SAVE_STATE_TAG)
+	{
+		power();
+		return;
+	}
+	ptr += sizeof(int32);
+
+	memcpy(regs, ptr, sizeof(regs));
+	ptr += sizeof(regs);
+
+#undef INT32
+#define INT32(i)	   \
+i = GET_LE32(ptr); \
+ptr += sizeof(int32)
+	INT32(new_kon);
+	INT32(every_other_sample);
+	INT32(counter);
+	INT32(noise);
+
+	INT32(echo_offset);
+	INT32(echo_length);
+	INT32(echo_hist_pos);
+	for (int i = 0; i < 8; i++)
+	{
+		INT32(echo_hist[i][0]);
+		INT32(echo_hist[i][1]);
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		INT32(voices[i].pos);
+		INT32(voices[i].brr_addr);
+		INT32(voices[i].brr_header);
+		INT32(voices[i].env);
+		INT32(voices[i].hidden_env);
+		INT32(voices[i].env_mode);
+		INT32(voices[i].kon_delay);
+	}
+
+	for (int i = 0; i < 8; i++)
+	{
+		memcpy(voices[i].buf, ptr, sizeof(voices[i].buf));
+		ptr += sizeof(voices[i].buf);
+	}
+
+	*block = ptr;
+}
+
+} // namespace SNES
@@ -0,0 +1,94 @@
+// Sample-based S-DSP. Unlike the real chip it isn't cycle accurate: every voice is processed in
+// one go once per output sample (every 32 SMP clocks) and interpolation is linear instead of gaussian.
+
+#define DSP_SAVE_STATE_TAG 0x31505344 // "DSP1"
+
+class DSP
+{
+public:
+	enum
+	{
+		r_mvoll = 0x0c, r_mvolr = 0x1c,
+		r_evoll = 0x2c, r_evolr = 0x3c,
+		r_kon   = 0x4c, r_koff  = 0x5c,
+		r_flg   = 0x6c, r_endx  = 0x7c,
+		r_efb   = 0x0d, r_pmon  = 0x2d,
+		r_non   = 0x3d, r_eon   = 0x4d,
+		r_dir   = 0x5d, r_esa   = 0x6d,
+		r_edl   = 0x7d, r_fir   = 0x0f,
+	};
+
+	enum
+	{
+		v_voll  = 0, v_volr  = 1,
+		v_pitchl = 2, v_pitchh = 3,
+		v_srcn  = 4, v_adsr0 = 5,
+		v_adsr1 = 6, v_gain  = 7,
+		v_envx  = 8, v_outx  = 9,
+	};
+
+	enum { env_release, env_attack, env_decay, env_sustain };
+
+	struct Voice
+	{
+		int32 pos;			// Position in the current BRR block, 4.12 fixed point
+		int32 brr_addr;		// Address of the current BRR block
+		int32 brr_header;
+		int32 env;
+		int32 hidden_env;
+		int32 env_mode;
+		int32 kon_delay;
+		int16 buf[17];		// Last sample of the previous block followed by the current block
+	};
+
+	uint32 time;			// SMP clock of the next sample
+	uint8 regs[128];
+	uint8 *ram;
+
+	void power();
+	void reset();
+
+	uint8 read(unsigned addr);
+	void write(unsigned addr, uint8 data);
+
+	void set_output(int16 *begin, int size);
+	int sample_count() const { return out_pos - out_begin; }
+	void clear_output() { out_pos = out_begin; }
+
+	inline void synchronize(uint32 now)
+	{
+		while ((int32)(now - time) >= 32)
+		{
+			time += 32;
+			sample();
+		}
+	}
+
+	void load_state(uint8 **);
+	void save_state(uint8 **);
+
+private:
+	Voice voices[8];
+
+	int32 new_kon;
+	int32 every_other_sample;
+	int32 counter;
+	int32 noise;
+
+	int32 echo_offset;
+	int32 echo_length;
+	int32 echo_hist_pos;
+	int32 echo_hist[8][2];
+
+	int16 *out_begin;
+	int16 *out_pos;
+	int16 *out_end;
+
+	inline bool check_counter(int rate);
+	inline void decode_brr(Voice *v);
+	inline void run_envelope(Voice *v, const uint8 *vregs);
+	inline void key_on(Voice *v, const uint8 *vregs);
+	void sample();
+};
+
+extern DSP dsp;
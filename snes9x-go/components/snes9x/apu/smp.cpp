@@ -3,6 +3,7 @@
 namespace SNES
 {
 #include "smp.hpp"
+#include "dsp.hpp"
 
 SMP smp;
 
@@ -183,7 +184,8 @@ IRAM_ATTR unsigned SMP::op_read(unsigned addr)
 		case 0xf2:
 			return status.dsp_addr;
 		case 0xf3:
-			return 0; // dsp.read(status.dsp_addr & 0x7f);
+			dsp.synchronize(time + clock);
+			return dsp.read(status.dsp_addr & 0x7f);
 		case 0xf4:
 		case 0xf5:
 		case 0xf6:
@@ -277,7 +279,8 @@ IRAM_ATTR void SMP::op_write(unsigned addr, uint8 data)
 		case 0xf3:
 			if (status.dsp_addr & 0x80)
 				break;
-			// dsp.write(status.dsp_addr, data);
+			dsp.synchronize(time + clock);
+			dsp.write(status.dsp_addr, data);
 			break;
 
 		case 0xf4:
@@ -315,6 +318,7 @@ IRAM_ATTR void SMP::op_write(unsigned addr, uint8 data)
 
 IRAM_ATTR void SMP::execute(int cycles)
 {
+	time += cycles;
 	clock -= cycles;
 
 	while (clock < 0)
@@ -2769,6 +2773,7 @@ void SMP::Timer<cycle_frequency>::tick(unsigned clocks)
 void SMP::power()
 {
 	smp.clock = 0;
+	smp.time = 0;
 
 	timer0.target = 0;
 	timer1.target = 0;
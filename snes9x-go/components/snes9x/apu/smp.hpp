@@ -15,6 +15,7 @@ class SMP
 public:
     unsigned frequency;
     int32 clock;
+    uint32 time; // Absolute clock at which the current execute() ends, clock is relative to it
 	static const uint8 iplrom[64];
 	uint32 registers[4];
 	uint8 *apuram;
@@ -651,12 +651,11 @@ void S9xMemoryDeinit (void)
 
 bool8 S9xLoadROM (const char *filename)
 {
-	FILE *stream = fopen(filename, "rb");
-	if (!stream)
+	rg_file_view_t *view = rg_storage_view_open(filename);
+	if (!view)
 		return (FALSE);
 
-	fseek(stream, 0, SEEK_END);
-	Memory.ROM_SIZE = ftell(stream);
+	Memory.ROM_SIZE = view->size;
 
 	// We shrink if possible because we need all the memory we can get for savestates and buffers
 	uint8 *temp = (uint8 *)realloc(Memory.ROM, Memory.ROM_SIZE);
@@ -666,15 +665,15 @@ bool8 S9xLoadROM (const char *filename)
 		Memory.ROM = temp;
 	}
 
-	if (!Memory.ROM || Memory.ROM_MAX_SIZE < Memory.ROM_SIZE)
+	// InitROM rearranges the ROM in place, so it gets a copy rather than the view itself
+	if (!Memory.ROM || Memory.ROM_MAX_SIZE < Memory.ROM_SIZE
+		|| rg_storage_view_read(view, 0, Memory.ROM, Memory.ROM_SIZE) != Memory.ROM_SIZE)
 	{
-		fclose(stream);
+		rg_storage_view_close(view);
 		return (FALSE);
 	}
 
-	fseek(stream, 0, SEEK_SET);
-	fread(Memory.ROM, Memory.ROM_SIZE, 1, stream);
-	fclose(stream);
+	rg_storage_view_close(view);
 
 	return InitROM();
 }
@@ -553,7 +553,7 @@ static void SkipBlockWithName(FILE *, const char *);
 
 bool8 S9xFreezeGame (const char *filename)
 {
-	FILE *stream = fopen(filename, "wb");
+	FILE *stream = rg_savestate_fopen(filename, "wb");
 
 	if (!stream)
 	{
@@ -613,7 +613,7 @@ bool8 S9xFreezeGame (const char *filename)
 
 bool8 S9xUnfreezeGame (const char *filename)
 {
-	FILE *stream = fopen(filename, "rb");
+	FILE *stream = rg_savestate_fopen(filename, "rb");
 
 	if (!stream)
 	{
@@ -15,17 +15,15 @@
 
 #include "keymap.h"
 
-#define AUDIO_SAMPLE_RATE (22050)
+#define AUDIO_SAMPLE_RATE (32000)
 #define AUDIO_BUFFER_LENGTH (AUDIO_SAMPLE_RATE / 50)
 
-// static short audioBuffer[AUDIO_BUFFER_LENGTH * 2];
+static rg_audio_sample_t audioBuffer[AUDIO_BUFFER_LENGTH];
 
-static rg_video_update_t updates[2];
-static rg_video_update_t *currentUpdate = &updates[0];
+static rg_video_update_t *currentUpdate;
 
 static rg_app_t *app;
 
-static uint32_t frames_counter = 0;
 
 static int keymap_id = 0;
 static keymap_t keymap;
@@ -76,6 +74,14 @@ void S9xExit(void)
 	exit(0);
 }
 
+// Called from the APU task whenever the DSP has produced a batch of samples
+static void audio_callback(void *arg)
+{
+	int count = RG_MIN(S9xGetSampleCount(), AUDIO_BUFFER_LENGTH * 2);
+	S9xMixSamples((uint8 *)audioBuffer, count);
+	rg_audio_submit(audioBuffer, count / 2);
+}
+
 static void update_keymap(int id)
 {
 	keymap_id = id % KEYMAPS_COUNT;
@@ -162,7 +168,7 @@ static rg_gui_event_t menu_keymap_cb(rg_gui_option_t *option, rg_gui_event_t eve
 
 static bool screenshot_handler(const char *filename, int width, int height)
 {
-	return rg_display_save_frame(filename, currentUpdate, width, height);
+	return rg_display_save_frame(filename, rg_display_last_frame(), width, height);
 }
 
 static bool save_state_handler(const char *filename)
@@ -214,10 +220,9 @@ extern "C" void app_main(void)
 
 	app = rg_system_init(AUDIO_SAMPLE_RATE, &handlers, options);
 
-	updates[0].buffer = rg_alloc(SNES_WIDTH * SNES_HEIGHT_EXTENDED * 2, MEM_SLOW);
-	updates[1].buffer = rg_alloc(SNES_WIDTH * SNES_HEIGHT_EXTENDED * 2, MEM_SLOW);
-
 	rg_display_set_source_format(SNES_WIDTH, SNES_HEIGHT, 0, 0, SNES_WIDTH * 2, RG_PIXEL_565_LE);
+	rg_display_swapchain_init(3, SNES_WIDTH * SNES_HEIGHT_EXTENDED * 2, MEM_SLOW, RG_DISPLAY_DROP_OLDEST);
+	currentUpdate = rg_display_acquire_frame();
 
 	puts("\nSnes9x " VERSION " for ESP32\n");
 
@@ -226,7 +231,7 @@ extern "C" void app_main(void)
 	Settings.Stereo = FALSE;
 	Settings.SoundPlaybackRate = AUDIO_SAMPLE_RATE;
 	Settings.SoundSync = FALSE;
-	Settings.Mute = TRUE;
+	Settings.Mute = FALSE;
 	Settings.Transparency = TRUE;
 	Settings.SkipFrames = 0;
 	Settings.Paused = FALSE;
@@ -241,6 +246,8 @@ extern "C" void app_main(void)
 	if (!S9xSoundInit(0))
 		RG_PANIC("Sound init failed!");
 
+	S9xSetSamplesAvailableCallback(&audio_callback, NULL);
+
 	if (!S9xGraphicsInit())
 		RG_PANIC("Graphics init failed!");
 
@@ -255,7 +262,7 @@ extern "C" void app_main(void)
 	// Do this last to make sure the user sees it only the first time a game is about to start
 	if (!rg_settings_get_number(NS_APP, SETTING_NOTIFIED, 0))
 	{
-		rg_gui_alert("Important!", "SNES support is experimental.\nIt is slow and has no sound.");
+		rg_gui_alert("Important!", "SNES support is experimental.\nIt is slow.");
 		rg_settings_set_number(NS_APP, SETTING_NOTIFIED, 1);
 		rg_settings_commit();
 	}
@@ -303,14 +310,13 @@ extern "C" void app_main(void)
 
 		if (IPPU.RenderThisFrame)
 		{
-			rg_video_update_t *previousUpdate = &updates[currentUpdate == &updates[0]];
-			rg_display_queue_update(currentUpdate, previousUpdate);
-			currentUpdate = previousUpdate;
+			rg_display_present_frame(currentUpdate);
+			currentUpdate = rg_display_acquire_frame();
 		}
 
 		rg_system_tick(elapsed);
 
-		IPPU.RenderThisFrame = (((++frames_counter) & 3) == 3);
+		IPPU.RenderThisFrame = rg_system_should_draw();
 		GFX.Screen = (uint16*)currentUpdate->buffer;
 	}
 }